@@ -0,0 +1,21 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+
+/* Monotonic time in seconds. */
+double bench_now(void);
+
+/* Cartridge RAM access benchmark. Writes JSON entries to json if not NULL.
+ * Returns 0 on success, -1 on error. */
+int cart_ram_bench(FILE *json);
+
+/* Background and window rendering benchmark. Writes JSON entries to json if
+ * not NULL. Returns 0 on success, -1 on error. */
+int render_bench(FILE *json);
+
+/* Upscaler throughput benchmark, per filter and instruction set. Writes JSON
+ * entries to json if not NULL. Returns 0 on success, -1 on error. */
+int scale_bench(FILE *json);
+
+#endif /* BENCH_H */
@@ -0,0 +1,141 @@
+/* Cartridge RAM access throughput through the MMU page table, compared with
+ * the address decoding and CART.mbc dispatch the MMU used before. Results are
+ * appended to the "cart_ram" array of the JSON report. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench.h"
+#include "cartridge/cart.h"
+#include "clock.h"
+#include "gpu.h"
+#include "mmu.h"
+
+#define ROUNDS 2000
+#define RAM_BANK_SIZE 0x2000
+
+typedef struct {
+    const char *name;
+    uint8_t cart_type;
+    uint8_t ram_size;
+} bench_cart_t;
+
+static const bench_cart_t carts[] = {
+    {"ROM+RAM", CART_ROM_RAM, 2},
+    {"MBC1+RAM", CART_MBC1_RAM, 3},
+    {"MBC5+RAM", CART_MBC5_RAM, 3},
+};
+
+static int write_rom(const char *path, const bench_cart_t *cart)
+{
+    uint8_t *rom = calloc(1, 0x8000);
+    rom[0x147] = cart->cart_type;
+    rom[0x148] = 0;
+    rom[0x149] = cart->ram_size;
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        free(rom);
+        return -1;
+    }
+    size_t rv = fwrite(rom, 1, 0x8000, f);
+    fclose(f);
+    free(rom);
+    return rv == 0x8000 ? 0 : -1;
+}
+
+static double bench_read(uint8_t (*read)(uint16_t), unsigned int *sum)
+{
+    double start = bench_now();
+    for (int i = 0; i < ROUNDS; ++i) {
+        for (uint16_t addr = 0xa000; addr < 0xc000; ++addr) {
+            *sum += read(addr);
+        }
+    }
+    return bench_now() - start;
+}
+
+/* Address decoding of the MMU before the page table, up to cartridge RAM. */
+static uint8_t legacy_read_byte(uint16_t addr)
+{
+    if (addr < 0x4000) {
+        return cart_read_rom0(addr);
+    } else if (addr < 0x8000) {
+        return cart_read_rom1(addr);
+    } else if (addr < 0xa000) {
+        return gpu_read_vram(addr);
+    } else if (addr < 0xc000) {
+        return cart_read_ram(addr);
+    }
+    return mmu_read_byte_dma(addr);
+}
+
+static void legacy_write_byte(uint16_t addr, uint8_t val)
+{
+    clock_step(4);
+    if (addr < 0x8000) {
+        cart_write_mbc(addr, val);
+    } else if (addr < 0xa000) {
+        gpu_write_vram(addr, val);
+    } else if (addr < 0xc000) {
+        cart_write_ram(addr, val);
+    }
+}
+
+static double bench_write(void (*write)(uint16_t, uint8_t))
+{
+    double start = bench_now();
+    for (int i = 0; i < ROUNDS; ++i) {
+        for (uint16_t addr = 0xa000; addr < 0xc000; ++addr) {
+            write(addr, (uint8_t)(addr + i));
+        }
+    }
+    return bench_now() - start;
+}
+
+static void bench_print(FILE *json, const char *name, const char *op,
+                        double before, double after)
+{
+    static unsigned int entries;
+    double accesses = (double)ROUNDS * RAM_BANK_SIZE;
+    before = before * 1e9 / accesses;
+    after = after * 1e9 / accesses;
+    printf("%-10s %-5s before: %6.2f ns/access  after: %6.2f ns/access  "
+           "speedup: %.2fx\n",
+           name, op, before, after, before / after);
+    if (json == NULL)
+        return;
+    fprintf(json,
+            "%s    {\"cart\": \"%s\", \"op\": \"%s\", "
+            "\"before_ns\": %.3f, \"after_ns\": %.3f}",
+            entries++ ? ",\n" : "", name, op, before, after);
+}
+
+int cart_ram_bench(FILE *json)
+{
+    char path[] = "/tmp/gusgb_cart_ram_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return -1;
+    }
+    close(fd);
+    unsigned int sum = 0;
+    for (size_t i = 0; i < sizeof(carts) / sizeof(carts[0]); ++i) {
+        if (write_rom(path, &carts[i]) < 0 || mmu_init(path) < 0) {
+            fprintf(stderr, "ERROR: could not load %s\n", carts[i].name);
+            unlink(path);
+            return -1;
+        }
+        /* Enable RAM. */
+        mmu_write_byte(0x0000, 0x0a);
+        double before = bench_write(legacy_write_byte);
+        double after = bench_write(mmu_write_byte);
+        bench_print(json, carts[i].name, "write", before, after);
+        before = bench_read(legacy_read_byte, &sum);
+        after = bench_read(mmu_read_byte_dma, &sum);
+        bench_print(json, carts[i].name, "read", before, after);
+        mmu_finish();
+    }
+    unlink(path);
+    return sum == 0 ? -1 : 0;
+}
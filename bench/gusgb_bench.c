@@ -0,0 +1,293 @@
+/* Emulator throughput benchmark. Runs each workload ROM headless for a fixed
+ * number of frames and reports emulated cycles per second, frames per second
+ * and ns per instruction.
+ *
+ * Built with PROFILE (gusgb-bench-prof), it also reports how host time splits
+ * between subsystems, sampled with SIGPROF against the subsystem markers of
+ * profile.h. The markers cost time themselves: throughput is measured by the
+ * build without them. */
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include "bench.h"
+#include "clock.h"
+#include "cpu.h"
+#include "game_boy.h"
+#include "gpu.h"
+#include "profile.h"
+#include "trace.h"
+
+#define DEFAULT_FRAMES 600
+#define FRAME_CYCLES 70224
+#define CPU_HZ 4194304.0
+#define SAMPLE_US 1000
+
+#ifndef BENCH_ROM_DIR
+#define BENCH_ROM_DIR "bench_roms"
+#endif
+
+/* Workloads assembled from bench/roms. */
+static const char *default_roms[] = {"alu.gb", "memcpy.gb", "halt.gb",
+                                     "sprites.gb"};
+
+#ifdef PROFILE
+static const char *subsys_names[PROF_MAX] = {"cpu", "gpu", "timer", "serial",
+                                             "frame"};
+#endif
+
+typedef struct {
+    const char *path;
+    unsigned int frames;
+    uint64_t cycles;
+    uint64_t instructions;
+    double seconds;
+#ifdef PROFILE
+    unsigned long samples[PROF_MAX];
+#endif
+} workload_t;
+
+extern cpu_t CPU;
+
+static unsigned int frames;
+#ifdef PROFILE
+static volatile unsigned long samples[PROF_MAX];
+#endif
+
+double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void bench_frame(void)
+{
+    frames++;
+}
+
+#ifdef PROFILE
+static void bench_sample(int sig)
+{
+    (void)sig;
+    samples[prof_subsys]++;
+}
+
+static void set_sampling(long usec)
+{
+    struct itimerval it = {{0, usec}, {0, usec}};
+    setitimer(ITIMER_PROF, &it, NULL);
+}
+#endif
+
+static int run_workload(workload_t *w, unsigned int target)
+{
+    if (cpu_init(w->path) < 0)
+        return -1;
+    gpu_init(NULL, bench_frame);
+    frames = 0;
+#ifdef PROFILE
+    prof_reset();
+    for (int i = 0; i < PROF_MAX; ++i)
+        samples[i] = 0;
+    set_sampling(SAMPLE_US);
+#endif
+    /* Stop a ROM that keeps the LCD off. */
+    uint64_t budget = (uint64_t)target * FRAME_CYCLES * 2;
+    double start = bench_now();
+    while (frames < target && clock_get_cycles() < budget) {
+        w->instructions += !CPU.halt;
+        gb_step();
+    }
+    w->seconds = bench_now() - start;
+    w->frames = frames;
+    w->cycles = clock_get_cycles();
+#ifdef PROFILE
+    set_sampling(0);
+    for (int i = 0; i < PROF_MAX; ++i)
+        w->samples[i] = samples[i];
+#endif
+    cpu_finish();
+    return 0;
+}
+
+static void print_workload(const workload_t *w)
+{
+    printf("%-24s %8.2f Mcycles/s %7.1f fps %6.1fx %6.2f ns/instr",
+           strrchr(w->path, '/') ? strrchr(w->path, '/') + 1 : w->path,
+           (double)w->cycles / w->seconds * 1e-6,
+           (double)w->frames / w->seconds,
+           (double)w->cycles / CPU_HZ / w->seconds,
+           w->seconds * 1e9 / (double)(w->instructions ? w->instructions : 1));
+#ifdef PROFILE
+    unsigned long total = 0;
+    for (int i = 0; i < PROF_MAX; ++i)
+        total += w->samples[i];
+    printf("  ");
+    for (int i = 0; i < PROF_MAX; ++i)
+        printf(" %s %4.1f%%", subsys_names[i],
+               total ? 100.0 * (double)w->samples[i] / (double)total : 0.0);
+#endif
+    printf("\n");
+}
+
+static void write_workload(FILE *json, const workload_t *w, bool first)
+{
+    fprintf(json,
+            "%s    {\"rom\": \"%s\", \"frames\": %u, \"cycles\": %llu, "
+            "\"seconds\": %.6f, \"cycles_per_sec\": %.0f, \"fps\": %.3f, "
+            "\"ns_per_instr\": %.3f",
+            first ? "" : ",\n", w->path, w->frames,
+            (unsigned long long)w->cycles, w->seconds,
+            (double)w->cycles / w->seconds, (double)w->frames / w->seconds,
+            w->seconds * 1e9 /
+                (double)(w->instructions ? w->instructions : 1));
+#ifdef PROFILE
+    unsigned long total = 0;
+    for (int i = 0; i < PROF_MAX; ++i)
+        total += w->samples[i];
+    fprintf(json, ", \"subsystems\": {");
+    for (int i = 0; i < PROF_MAX; ++i)
+        fprintf(json, "%s\"%s\": %.4f", i ? ", " : "", subsys_names[i],
+                total ? (double)w->samples[i] / (double)total : 0.0);
+    fprintf(json, "}");
+#endif
+    fprintf(json, "}");
+}
+
+static void print_help(char **argv)
+{
+    fprintf(stderr,
+            "Usage: %s [options] [ROM...]\n"
+            "Runs the bundled workloads when no ROM is given.\n"
+            "Options:\n"
+            "  -a\t\tRender with the pixel FIFO\n"
+            "  -c\t\tSkip the cartridge RAM, render and scale benchmarks\n"
+            "  -d <dir>\tWorkload directory (default: %s)\n"
+            "  -f <frames>\tFrames to run per ROM (default: %d)\n"
+            "  -h\t\tPrint help and exit\n"
+            "  -o <file>\tWrite results as JSON\n"
+#ifdef PROFILE
+            "  -p\t\tRun with the opcode profiler enabled\n"
+#endif
+            "  -s <frames>\tSkip rendering <frames> frames after each one\n"
+            "  -t\t\tRun with the execution trace enabled\n",
+            argv[0], BENCH_ROM_DIR, DEFAULT_FRAMES);
+}
+
+int main(int argc, char **argv)
+{
+    const char *rom_dir = BENCH_ROM_DIR;
+    const char *json_path = NULL;
+    unsigned int target = DEFAULT_FRAMES;
+    unsigned int skip = 0;
+    bool micro = true;
+    int opt;
+#ifdef PROFILE
+    const char *opts = "acd:f:o:ps:th";
+#else
+    const char *opts = "acd:f:o:s:th";
+#endif
+    while ((opt = getopt(argc, argv, opts)) != -1) {
+        switch (opt) {
+            case 'a':
+                gpu_set_renderer(GPU_RENDERER_FIFO);
+                break;
+            case 'c':
+                micro = false;
+                break;
+            case 'd':
+                rom_dir = optarg;
+                break;
+            case 'f':
+                target = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            case 'o':
+                json_path = optarg;
+                break;
+#ifdef PROFILE
+            case 'p':
+                prof_opcodes = true;
+                break;
+#endif
+            case 's':
+                skip = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                trace_enable(true);
+                break;
+            default:
+                print_help(argv);
+                return EXIT_FAILURE;
+        }
+    }
+    if (target == 0) {
+        print_help(argv);
+        return EXIT_FAILURE;
+    }
+    size_t count = optind < argc ? (size_t)(argc - optind)
+                                 : sizeof(default_roms) / sizeof(char *);
+    workload_t *workloads = calloc(count, sizeof(workload_t));
+    char **paths = calloc(count, sizeof(char *));
+    for (size_t i = 0; i < count; ++i) {
+        if (optind < argc) {
+            workloads[i].path = argv[optind + (int)i];
+        } else if (asprintf(&paths[i], "%s/%s", rom_dir, default_roms[i]) >=
+                   0) {
+            workloads[i].path = paths[i];
+        }
+    }
+    FILE *json = NULL;
+    if (json_path && (json = fopen(json_path, "w")) == NULL) {
+        perror(json_path);
+        return EXIT_FAILURE;
+    }
+#ifdef PROFILE
+    signal(SIGPROF, bench_sample);
+#endif
+    gpu_set_frame_skip(skip);
+    int ret = EXIT_SUCCESS;
+    bool first = true;
+    if (json)
+        fprintf(json,
+                "{\n  \"frames\": %u,\n  \"frame_skip\": %u,\n"
+                "  \"workloads\": [\n",
+                target, skip);
+    for (size_t i = 0; i < count; ++i) {
+        if (run_workload(&workloads[i], target) < 0) {
+            fprintf(stderr, "ERROR: could not load %s\n", workloads[i].path);
+            ret = EXIT_FAILURE;
+            continue;
+        }
+        print_workload(&workloads[i]);
+        if (json)
+            write_workload(json, &workloads[i], first);
+        first = false;
+    }
+    if (json)
+        fprintf(json, "\n  ],\n  \"cart_ram\": [\n");
+    if (micro && cart_ram_bench(json) < 0)
+        ret = EXIT_FAILURE;
+    if (json)
+        fprintf(json, "\n  ],\n  \"render\": [\n");
+    if (micro && render_bench(json) < 0)
+        ret = EXIT_FAILURE;
+    if (json)
+        fprintf(json, "\n  ],\n  \"scale\": [\n");
+    if (micro && scale_bench(json) < 0)
+        ret = EXIT_FAILURE;
+    if (json) {
+        fprintf(json, "\n  ]\n}\n");
+        fclose(json);
+    }
+    for (size_t i = 0; i < count; ++i)
+        free(paths[i]);
+    free(paths);
+    free(workloads);
+    return ret;
+}
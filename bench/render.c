@@ -0,0 +1,138 @@
+/* Background and window rendering throughput: the GPU alone runs whole frames
+ * of a tiled screen, with the window off, covering part of each line and the
+ * whole screen, in DMG and CGB mode. Then the cost of a VRAM viewer update,
+ * snapshot and sheet, on the CGB screen. Results are appended to the
+ * "render" array of the JSON report. */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench.h"
+#include "gpu.h"
+#include "mmu.h"
+#include "viewer.h"
+
+#define RENDER_FRAMES 1000
+#define VIEWER_UPDATES 200
+/* Game Boy frame length. */
+#define FRAME_US (70224 * 1e6 / 4194304)
+
+typedef struct {
+    const char *name;
+    uint8_t lcdc;
+    uint8_t wx;
+    bool cgb;
+} bench_scene_t;
+
+static const bench_scene_t scenes[] = {
+    {"bg", 0x91, 0, false},
+    {"bg+window", 0xb1, 87, false},
+    {"window", 0xb1, 7, false},
+    {"cgb bg", 0x91, 0, true},
+    {"cgb bg+window", 0xb1, 87, true},
+};
+
+static unsigned int frames;
+
+static void render_frame(void)
+{
+    frames++;
+}
+
+static int write_rom(const char *path, bool cgb)
+{
+    uint8_t *rom = calloc(1, 0x8000);
+    rom[0x143] = cgb ? 0x80 : 0;
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        free(rom);
+        return -1;
+    }
+    size_t rv = fwrite(rom, 1, 0x8000, f);
+    fclose(f);
+    free(rom);
+    return rv == 0x8000 ? 0 : -1;
+}
+
+/* Distinct tiles all over both maps. On CGB, tiles in both banks and mixed
+ * attributes: palettes, banks, flips and priority. */
+static void setup_vram(bool cgb)
+{
+    for (uint8_t bank = 0; bank < (cgb ? 2 : 1); ++bank) {
+        gpu_write_vbk(bank);
+        for (uint16_t addr = 0x8000; addr < 0x9800; ++addr)
+            gpu_write_vram(addr, (uint8_t)(addr * 7 + (addr >> 4) + bank));
+        for (uint16_t addr = 0x9800; addr < 0xa000; ++addr)
+            gpu_write_vram(addr, (uint8_t)(addr * (bank ? 29 : 13)));
+    }
+    gpu_write_vbk(0);
+}
+
+static double render_scene(const bench_scene_t *scene)
+{
+    gpu_init(NULL, render_frame);
+    gpu_set_frame_skip(0);
+    setup_vram(scene->cgb);
+    gpu_write_scx(3);
+    gpu_write_scy(5);
+    gpu_write_wy(0);
+    gpu_write_wx(scene->wx);
+    gpu_write_lcdc(scene->lcdc);
+    frames = 0;
+    double start = bench_now();
+    /* Coarse steps, so rendering rather than stepping dominates. */
+    while (frames < RENDER_FRAMES)
+        gpu_step(40);
+    return bench_now() - start;
+}
+
+/* Microseconds per viewer update. */
+static double viewer_update(void)
+{
+    uint32_t *sheet = malloc(sizeof(uint32_t) * VIEWER_WIDTH * VIEWER_HEIGHT);
+    if (sheet == NULL)
+        return 0;
+    double start = bench_now();
+    for (int i = 0; i < VIEWER_UPDATES; ++i)
+        viewer_draw(sheet);
+    double us = (bench_now() - start) * 1e6 / VIEWER_UPDATES;
+    free(sheet);
+    return us;
+}
+
+int render_bench(FILE *json)
+{
+    char path[] = "/tmp/gusgb_render_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return -1;
+    }
+    close(fd);
+    for (size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); ++i) {
+        if (write_rom(path, scenes[i].cgb) < 0 || mmu_init(path) < 0) {
+            fprintf(stderr, "ERROR: could not load the render benchmark ROM\n");
+            unlink(path);
+            return -1;
+        }
+        double ns = render_scene(&scenes[i]) * 1e9 /
+                    ((double)RENDER_FRAMES * GB_SCREEN_HEIGHT);
+        printf("render %-14s %8.1f ns/line\n", scenes[i].name, ns);
+        if (json)
+            fprintf(json, "%s    {\"scene\": \"%s\", \"ns_per_line\": %.3f}",
+                    i ? ",\n" : "", scenes[i].name, ns);
+        /* On the last scene: CGB, both banks in use. */
+        if (i + 1 == sizeof(scenes) / sizeof(scenes[0])) {
+            double us = viewer_update();
+            printf("render %-14s %8.1f us/update (%.1f%% of a frame)\n",
+                   "viewer", us, us * 100 / FRAME_US);
+            if (json)
+                fprintf(json, ",\n    {\"scene\": \"viewer\", "
+                              "\"us_per_update\": %.3f}",
+                        us);
+        }
+        mmu_finish();
+    }
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,20 @@
+; Benchmark: 8-bit ALU loop.
+.fill $00, $8000        ; zero all 32k cartridge memory
+.org $100
+nop
+jp start
+.org $150
+start:
+    ld a,$00
+    ld b,$01
+    ld c,$03
+loop:
+    add a,b
+    xor c
+    inc b
+    dec c
+    and d
+    or e
+    rla
+    sub c
+    jr loop
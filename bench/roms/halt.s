@@ -0,0 +1,16 @@
+; Benchmark: CPU halted between VBlank interrupts.
+.fill $00, $8000        ; zero all 32k cartridge memory
+.org $40
+reti                    ; VBlank handler
+.org $100
+nop
+jp start
+.org $150
+start:
+    ld a,$01
+    ld ($ff00+$ff),a    ; enable VBlank interrupt
+    ei
+wait:
+    halt
+    nop
+    jr wait
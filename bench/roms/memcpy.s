@@ -0,0 +1,19 @@
+; Benchmark: copy 256 bytes from WRAM bank 0 to bank 1 in a loop.
+.fill $00, $8000        ; zero all 32k cartridge memory
+.org $100
+nop
+jp start
+.org $150
+start:
+    ld hl,$c000
+    ld de,$d000
+    ld bc,$0100
+copy:
+    ld a,(hl+)
+    ld (de),a
+    inc de
+    dec bc
+    ld a,b
+    or c
+    jr nz,copy
+    jr start
@@ -0,0 +1,43 @@
+; Benchmark: 40 solid sprites packed over the top of the screen.
+.fill $00, $8000        ; zero all 32k cartridge memory
+.org $100
+nop
+jp start
+.org $150
+start:
+    xor a
+    ld ($ff00+$40),a    ; turn off lcd to write vram and oam
+; solid tiles at $8000-$80ff
+    ld hl,$8000
+    ld b,$00
+tiles:
+    ld a,$ff
+    ld (hl+),a
+    dec b
+    jr nz,tiles
+; sprites: y += 1, x += 4
+    ld hl,$fe00
+    ld c,$28
+    ld d,$10
+    ld e,$08
+sprite:
+    ld a,d
+    ld (hl+),a
+    ld a,e
+    ld (hl+),a
+    ld a,c
+    and $0f
+    ld (hl+),a
+    xor a
+    ld (hl+),a
+    inc d
+    ld a,e
+    add a,$04
+    ld e,a
+    dec c
+    jr nz,sprite
+; lcd on with sprites
+    ld a,$93
+    ld ($ff00+$40),a
+idle:
+    jr idle
@@ -0,0 +1,74 @@
+/* Upscaler throughput: every filter scales a frame of few colors, as the
+ * Game Boy produces, with each instruction set the CPU supports. Results are
+ * appended to the "scale" array of the JSON report. */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "gpu.h"
+#include "scale.h"
+
+#define SCALE_FRAMES 500
+/* Factor of the nearest filter, the default window scale. */
+#define NEAREST_FACTOR 4
+
+static const char *simd_names[] = {"c", "sse2", "avx2"};
+
+static double scale_run(scale_filter_e filter, unsigned int factor,
+                        const uint32_t *src, uint32_t *dst)
+{
+    double start = bench_now();
+    for (int i = 0; i < SCALE_FRAMES; ++i)
+        scale_frame(filter, factor, src, dst);
+    return bench_now() - start;
+}
+
+int scale_bench(FILE *json)
+{
+    static const uint32_t colors[4] = {0xffe0f8d0, 0xff88c070, 0xff346856,
+                                       0xff000000};
+    uint32_t *src = malloc(sizeof(uint32_t) * GB_SCREEN_WIDTH *
+                           GB_SCREEN_HEIGHT);
+    uint32_t *dst = malloc(sizeof(uint32_t) * GB_SCREEN_WIDTH *
+                           GB_SCREEN_HEIGHT * NEAREST_FACTOR * NEAREST_FACTOR);
+    if (src == NULL || dst == NULL) {
+        perror("malloc");
+        free(src);
+        free(dst);
+        return -1;
+    }
+    /* Tiles of 8x8 pixels, with runs and edges like game graphics. */
+    for (unsigned int y = 0; y < GB_SCREEN_HEIGHT; ++y) {
+        for (unsigned int x = 0; x < GB_SCREEN_WIDTH; ++x) {
+            unsigned int tile = (x >> 3) * 7 + (y >> 3) * 13;
+            src[y * GB_SCREEN_WIDTH + x] =
+                colors[((x & 7) * (tile | 1) + (y & 7) * tile) >> 3 & 3];
+        }
+    }
+    bool first = true;
+    for (int filter = 0; filter < SCALE_MAX; ++filter) {
+        unsigned int factor =
+            scale_factor((scale_filter_e)filter, NEAREST_FACTOR);
+        for (int simd = 0; simd <= (int)scale_simd_max(); ++simd) {
+            scale_set_simd((scale_simd_e)simd);
+            double fps =
+                SCALE_FRAMES / scale_run((scale_filter_e)filter, factor, src,
+                                         dst);
+            printf("scale %-8s %ux %-5s %10.1f frames/s\n",
+                   scale_name((scale_filter_e)filter), factor,
+                   simd_names[simd], fps);
+            if (json)
+                fprintf(json,
+                        "%s    {\"filter\": \"%s\", \"factor\": %u, "
+                        "\"simd\": \"%s\", \"fps\": %.1f}",
+                        first ? "" : ",\n",
+                        scale_name((scale_filter_e)filter), factor,
+                        simd_names[simd], fps);
+            first = false;
+        }
+    }
+    scale_set_simd(scale_simd_max());
+    free(src);
+    free(dst);
+    return 0;
+}
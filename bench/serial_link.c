@@ -0,0 +1,92 @@
+/* Link cable latency and throughput: one byte clocked by this side and
+ * answered by a peer thread, for each link backend. */
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "link/pipe.h"
+#include "link/socket.h"
+#include "serial.h"
+
+#define TRANSFERS 100000
+
+typedef struct {
+    serial_link_t *link;
+    atomic_bool running;
+} peer_t;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Answer every clocked byte with its complement. */
+static void *peer_thread(void *arg)
+{
+    peer_t *peer = arg;
+    uint8_t out = 0;
+    while (atomic_load(&peer->running)) {
+        int in = peer->link->poll(peer->link, out);
+        if (in >= 0)
+            out = (uint8_t)~in;
+        else
+            sched_yield();
+    }
+    return NULL;
+}
+
+static int bench_link(const char *name, serial_link_t *link,
+                      serial_link_t *peer_link)
+{
+    peer_t peer = {.link = peer_link, .running = true};
+    pthread_t thread;
+    pthread_create(&thread, NULL, peer_thread, &peer);
+    unsigned int errors = 0;
+    double start = now();
+    for (int i = 0; i < TRANSFERS; ++i) {
+        int in = link->transfer(link, (uint8_t)i);
+        /* The peer answers with the previous byte, complemented. */
+        if (i > 0 && in != (uint8_t)~(i - 1))
+            errors++;
+    }
+    double elapsed = now() - start;
+    atomic_store(&peer.running, false);
+    pthread_join(thread, NULL);
+    printf("%-8s %8.0f ns/transfer %10.0f bytes/s errors=%u\n", name,
+           elapsed * 1e9 / TRANSFERS, TRANSFERS / elapsed, errors);
+    return errors ? -1 : 0;
+}
+
+int main(void)
+{
+    link_pipe_t pipe;
+    link_pipe_init(&pipe);
+    int ret = bench_link("pipe", &pipe.end[0].link, &pipe.end[1].link);
+    char path[] = "/tmp/gusgb_link_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return EXIT_FAILURE;
+    }
+    close(fd);
+    unlink(path);
+    serial_link_t *server = link_socket_open(path);
+    serial_link_t *client = server ? link_socket_open(path) : NULL;
+    if (client == NULL) {
+        fprintf(stderr, "ERROR: could not open link socket %s\n", path);
+        return EXIT_FAILURE;
+    }
+    /* Accept the connection before the peer thread takes the server. */
+    server->poll(server, 0);
+    ret |= bench_link("socket", client, server);
+    client->close(client);
+    server->close(server);
+    /* A real cable moves 1 byte every 4096 clocks: 1024 bytes/s. */
+    printf("Game Boy serial rate: 1024 bytes/s (32768 bytes/s CGB fast)\n");
+    return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,368 @@
+#include "capture.h"
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gpu.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define FRAME_PIXELS (GB_SCREEN_WIDTH * GB_SCREEN_HEIGHT)
+
+typedef struct {
+    bool open;
+    FILE *f;
+    capture_format_e format;
+    scale_filter_e filter;
+    unsigned int factor;
+    unsigned int width;
+    unsigned int height;
+    pthread_t thread;
+    /* Posted once per queued frame, and once to stop. */
+    sem_t ready;
+    atomic_bool stop;
+    /* Pool slot (n % CAPTURE_BUFFERS) holds frame n. The emulation thread
+     * only moves head, the writer only tail. */
+    uint32_t *pool[CAPTURE_BUFFERS];
+    atomic_uint_fast64_t head;
+    atomic_uint_fast64_t tail;
+    atomic_uint_fast64_t written;
+    atomic_uint_fast64_t dropped;
+    bool failed; /* Write error, frames are dropped from then on. */
+    /* Writer buffers. */
+    uint32_t *scaled;
+    uint8_t *out;
+} capture_t;
+
+static capture_t CAP;
+
+capture_format_e capture_format(const char *path)
+{
+    size_t len = strlen(path);
+    if (len >= 4 && strcmp(path + len - 4, ".y4m") == 0)
+        return CAPTURE_Y4M;
+    return CAPTURE_RAW;
+}
+
+static uint8_t avg8(uint8_t a, uint8_t b)
+{
+    return (uint8_t)((a + b + 1) >> 1);
+}
+
+static uint8_t rgb_y(unsigned int r, unsigned int g, unsigned int b)
+{
+    return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+/* Biased by 128 << 8 so the sum stays positive, as in the SSE2 code. */
+static uint8_t rgb_u(unsigned int r, unsigned int g, unsigned int b)
+{
+    return (uint8_t)((112 * b + 32896 - 38 * r - 74 * g) >> 8);
+}
+
+static uint8_t rgb_v(unsigned int r, unsigned int g, unsigned int b)
+{
+    return (uint8_t)((112 * r + 32896 - 94 * g - 18 * b) >> 8);
+}
+
+#define CH(p, shift) ((uint8_t)((p) >> (shift)))
+
+/* One 2x2 block at (x, y) of the luma plane. */
+static void yuv420_block(const uint32_t *src, unsigned int w, unsigned int x,
+                         unsigned int y, uint8_t *py, uint8_t *pu,
+                         uint8_t *pv)
+{
+    const uint32_t *r0 = &src[y * w + x];
+    const uint32_t *r1 = r0 + w;
+    for (unsigned int i = 0; i < 2; ++i) {
+        py[y * w + x + i] = rgb_y(CH(r0[i], 16), CH(r0[i], 8), CH(r0[i], 0));
+        py[(y + 1) * w + x + i] =
+            rgb_y(CH(r1[i], 16), CH(r1[i], 8), CH(r1[i], 0));
+    }
+    /* Vertical then horizontal average, rounded up like pavgb. */
+    uint8_t c[3];
+    for (unsigned int i = 0; i < 3; ++i) {
+        unsigned int shift = 16 - i * 8;
+        uint8_t left = avg8(CH(r0[0], shift), CH(r1[0], shift));
+        uint8_t right = avg8(CH(r0[1], shift), CH(r1[1], shift));
+        c[i] = avg8(left, right);
+    }
+    unsigned int ci = (y / 2) * (w / 2) + x / 2;
+    pu[ci] = rgb_u(c[0], c[1], c[2]);
+    pv[ci] = rgb_v(c[0], c[1], c[2]);
+}
+
+#ifdef __SSE2__
+/* 16 bit products and sums of channels in 32 bit lanes: every term fits in
+ * the low half, the high half stays zero. */
+static __m128i sse2_mad(__m128i r, __m128i g, __m128i b, int cr, int cg,
+                        int cb)
+{
+    return _mm_add_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi32(cr)),
+                      _mm_mullo_epi16(g, _mm_set1_epi32(cg))),
+        _mm_mullo_epi16(b, _mm_set1_epi32(cb)));
+}
+
+static void sse2_split(__m128i p, __m128i *r, __m128i *g, __m128i *b)
+{
+    __m128i m = _mm_set1_epi32(0xff);
+    *r = _mm_and_si128(_mm_srli_epi32(p, 16), m);
+    *g = _mm_and_si128(_mm_srli_epi32(p, 8), m);
+    *b = _mm_and_si128(p, m);
+}
+
+static __m128i sse2_y(__m128i p)
+{
+    __m128i r, g, b;
+    sse2_split(p, &r, &g, &b);
+    __m128i s = _mm_add_epi16(sse2_mad(r, g, b, 66, 129, 25),
+                              _mm_set1_epi32(128));
+    return _mm_add_epi32(_mm_srli_epi32(s, 8), _mm_set1_epi32(16));
+}
+
+/* Luma of 8 pixels. */
+static void sse2_y8(const uint32_t *src, uint8_t *dst)
+{
+    __m128i y0 = sse2_y(_mm_loadu_si128((const __m128i *)src));
+    __m128i y1 = sse2_y(_mm_loadu_si128((const __m128i *)(src + 4)));
+    __m128i y = _mm_packs_epi32(y0, y1);
+    _mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(y, y));
+}
+
+/* Average of the 2x2 blocks of 4 columns, in lanes 0 and 1. */
+static __m128i sse2_avg2x2(const uint32_t *r0, const uint32_t *r1)
+{
+    __m128i v = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)r0),
+                             _mm_loadu_si128((const __m128i *)r1));
+    __m128i h = _mm_avg_epu8(v, _mm_srli_epi64(v, 32));
+    return _mm_shuffle_epi32(h, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+/* Chroma of the 4 blocks of 8 columns over two rows. */
+static void sse2_uv4(const uint32_t *r0, const uint32_t *r1, uint8_t *pu,
+                     uint8_t *pv)
+{
+    __m128i c = _mm_unpacklo_epi64(sse2_avg2x2(r0, r1),
+                                   sse2_avg2x2(r0 + 4, r1 + 4));
+    __m128i r, g, b;
+    sse2_split(c, &r, &g, &b);
+    __m128i bias = _mm_set1_epi32(32896);
+    __m128i u = _mm_sub_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi32(112)), bias),
+        sse2_mad(r, g, b, 38, 74, 0));
+    __m128i v = _mm_sub_epi16(
+        _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi32(112)), bias),
+        sse2_mad(r, g, b, 0, 94, 18));
+    u = _mm_and_si128(_mm_srli_epi32(u, 8), _mm_set1_epi32(0xff));
+    v = _mm_and_si128(_mm_srli_epi32(v, 8), _mm_set1_epi32(0xff));
+    __m128i uv = _mm_packs_epi32(u, v);
+    uv = _mm_packus_epi16(uv, uv);
+    int32_t out = _mm_cvtsi128_si32(uv);
+    memcpy(pu, &out, 4);
+    out = _mm_cvtsi128_si32(_mm_srli_si128(uv, 4));
+    memcpy(pv, &out, 4);
+}
+#endif /* __SSE2__ */
+
+void capture_yuv420(const uint32_t *src, unsigned int w, unsigned int h,
+                    uint8_t *y, uint8_t *u, uint8_t *v)
+{
+    for (unsigned int row = 0; row < h; row += 2) {
+        unsigned int x = 0;
+#ifdef __SSE2__
+        for (; x + 8 <= w; x += 8) {
+            const uint32_t *r0 = &src[row * w + x];
+            sse2_y8(r0, &y[row * w + x]);
+            sse2_y8(r0 + w, &y[(row + 1) * w + x]);
+            unsigned int ci = (row / 2) * (w / 2) + x / 2;
+            sse2_uv4(r0, r0 + w, &u[ci], &v[ci]);
+        }
+#endif
+        for (; x < w; x += 2)
+            yuv420_block(src, w, x, row, y, u, v);
+    }
+}
+
+static void capture_rgb24(const uint32_t *src, size_t n, uint8_t *dst)
+{
+    for (size_t i = 0; i < n; ++i) {
+        dst[i * 3] = CH(src[i], 16);
+        dst[i * 3 + 1] = CH(src[i], 8);
+        dst[i * 3 + 2] = CH(src[i], 0);
+    }
+}
+
+static int capture_write(const uint32_t *frame)
+{
+    const uint32_t *px = frame;
+    size_t n = (size_t)CAP.width * CAP.height;
+    if (CAP.scaled) {
+        scale_frame(CAP.filter, CAP.factor, frame, CAP.scaled);
+        px = CAP.scaled;
+    }
+    if (CAP.format == CAPTURE_RAW) {
+        capture_rgb24(px, n, CAP.out);
+        return fwrite(CAP.out, 3, n, CAP.f) == n ? 0 : -1;
+    }
+    uint8_t *u = CAP.out + n;
+    uint8_t *v = u + n / 4;
+    capture_yuv420(px, CAP.width, CAP.height, CAP.out, u, v);
+    if (fputs("FRAME\n", CAP.f) == EOF)
+        return -1;
+    return fwrite(CAP.out, 1, n * 3 / 2, CAP.f) == n * 3 / 2 ? 0 : -1;
+}
+
+static void *capture_thread(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        while (sem_wait(&CAP.ready) < 0 && errno == EINTR)
+            ;
+        uint64_t tail = atomic_load_explicit(&CAP.tail, memory_order_relaxed);
+        if (tail == atomic_load_explicit(&CAP.head, memory_order_acquire)) {
+            if (atomic_load(&CAP.stop))
+                break;
+            continue;
+        }
+        if (!CAP.failed &&
+            capture_write(CAP.pool[tail % CAPTURE_BUFFERS]) < 0) {
+            perror("capture write");
+            CAP.failed = true;
+        }
+        if (CAP.failed)
+            atomic_fetch_add(&CAP.dropped, 1);
+        else
+            atomic_fetch_add(&CAP.written, 1);
+        atomic_store_explicit(&CAP.tail, tail + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+static void capture_free(void)
+{
+    for (unsigned int i = 0; i < CAPTURE_BUFFERS; ++i) {
+        free(CAP.pool[i]);
+        CAP.pool[i] = NULL;
+    }
+    free(CAP.scaled);
+    free(CAP.out);
+    CAP.scaled = NULL;
+    CAP.out = NULL;
+    if (CAP.f)
+        fclose(CAP.f);
+    CAP.f = NULL;
+}
+
+static int capture_alloc(void)
+{
+    for (unsigned int i = 0; i < CAPTURE_BUFFERS; ++i) {
+        CAP.pool[i] = malloc(FRAME_PIXELS * sizeof(uint32_t));
+        if (CAP.pool[i] == NULL)
+            return -1;
+    }
+    size_t n = (size_t)CAP.width * CAP.height;
+    if (CAP.factor > 1 || CAP.filter != SCALE_NEAREST) {
+        CAP.scaled = malloc(n * sizeof(uint32_t));
+        if (CAP.scaled == NULL)
+            return -1;
+    }
+    CAP.out = malloc(n * 3);
+    return CAP.out ? 0 : -1;
+}
+
+int capture_open(const char *path, capture_format_e format,
+                 scale_filter_e filter, unsigned int factor)
+{
+    if (CAP.open)
+        capture_close();
+    CAP.format = format;
+    CAP.filter = filter;
+    CAP.factor = scale_factor(filter, factor);
+    CAP.width = GB_SCREEN_WIDTH * CAP.factor;
+    CAP.height = GB_SCREEN_HEIGHT * CAP.factor;
+    CAP.failed = false;
+    atomic_store(&CAP.stop, false);
+    atomic_store(&CAP.head, 0);
+    atomic_store(&CAP.tail, 0);
+    atomic_store(&CAP.written, 0);
+    atomic_store(&CAP.dropped, 0);
+    CAP.f = fopen(path, "wb");
+    if (CAP.f == NULL) {
+        perror("open capture");
+        return -1;
+    }
+    if (capture_alloc() < 0) {
+        perror("malloc");
+        capture_free();
+        return -1;
+    }
+    /* The Game Boy runs 4194304 / 70224 frames per second. */
+    if (format == CAPTURE_Y4M &&
+        fprintf(CAP.f, "YUV4MPEG2 W%u H%u F4194304:70224 Ip A1:1 C420jpeg\n",
+                CAP.width, CAP.height) < 0) {
+        perror("write capture");
+        capture_free();
+        return -1;
+    }
+    if (sem_init(&CAP.ready, 0, 0) < 0) {
+        perror("sem_init");
+        capture_free();
+        return -1;
+    }
+    if (pthread_create(&CAP.thread, NULL, capture_thread, NULL) != 0) {
+        fprintf(stderr, "ERROR: could not start the capture thread\n");
+        sem_destroy(&CAP.ready);
+        capture_free();
+        return -1;
+    }
+    CAP.open = true;
+    return 0;
+}
+
+void capture_frame(const uint32_t *frame)
+{
+    if (!CAP.open)
+        return;
+    uint64_t head = atomic_load_explicit(&CAP.head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&CAP.tail, memory_order_acquire);
+    if (head - tail == CAPTURE_BUFFERS) {
+        atomic_fetch_add_explicit(&CAP.dropped, 1, memory_order_relaxed);
+        return;
+    }
+    memcpy(CAP.pool[head % CAPTURE_BUFFERS], frame,
+           FRAME_PIXELS * sizeof(uint32_t));
+    atomic_store_explicit(&CAP.head, head + 1, memory_order_release);
+    sem_post(&CAP.ready);
+}
+
+void capture_close(void)
+{
+    if (!CAP.open)
+        return;
+    atomic_store(&CAP.stop, true);
+    sem_post(&CAP.ready);
+    pthread_join(CAP.thread, NULL);
+    sem_destroy(&CAP.ready);
+    capture_free();
+    CAP.open = false;
+}
+
+bool capture_enabled(void)
+{
+    return CAP.open;
+}
+
+uint64_t capture_written(void)
+{
+    return atomic_load(&CAP.written);
+}
+
+uint64_t capture_dropped(void)
+{
+    return atomic_load(&CAP.dropped);
+}
@@ -0,0 +1,39 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "scale.h"
+
+/* Video capture: frames are copied at VBlank into a pool of preallocated
+ * buffers and written by a background thread, upscaled by a filter. When
+ * the writer falls behind and the pool is full, frames are dropped and
+ * counted rather than stalling the emulation. */
+
+/* Frames the pool holds while the writer catches up. */
+#define CAPTURE_BUFFERS 16
+
+typedef enum {
+    CAPTURE_Y4M = 0, /* YUV4MPEG2, 4:2:0 BT.601. */
+    CAPTURE_RAW = 1, /* Packed 24 bit RGB frames, no header. */
+} capture_format_e;
+
+/* Format by file name: .y4m is Y4M, anything else raw RGB. */
+capture_format_e capture_format(const char *path);
+/* Start capturing to path. factor is the nearest filter's factor. */
+int capture_open(const char *path, capture_format_e format,
+                 scale_filter_e filter, unsigned int factor);
+/* Queue a GB_SCREEN_WIDTH x GB_SCREEN_HEIGHT frame, never blocks. */
+void capture_frame(const uint32_t *frame);
+/* Write the queued frames and stop. */
+void capture_close(void);
+bool capture_enabled(void);
+uint64_t capture_written(void);
+uint64_t capture_dropped(void);
+
+/* Convert w x h pixels, w and h even, to 4:2:0 planes: BT.601 limited
+ * range, chroma from the rounded average of each 2x2 block. */
+void capture_yuv420(const uint32_t *src, unsigned int w, unsigned int h,
+                    uint8_t *y, uint8_t *u, uint8_t *v);
+
+#endif /* CAPTURE_H */
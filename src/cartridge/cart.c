@@ -2,12 +2,18 @@
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include "huc1.h"
 #include "mbc1.h"
+#include "mbc2.h"
 #include "mbc3.h"
+#include "mbc5.h"
+#include "ram_sync.h"
 
 #define ROM_OFFSET_TITLE 0x134
 
 cart_t CART;
+static bool ram_sync_enabled;
+static cart_remap_cb_t remap_cb;
 
 const char *g_rom_types[256] = {
     [CART_ROM_ONLY] = "ROM ONLY",
@@ -41,10 +47,38 @@ const char *g_rom_types[256] = {
     [CART_HUC1_RAM_BATTERY] = "HUC1+RAM+BATTERY"
 };
 
+/* ROM only carts have no RAM enable nor banking, only RAM smaller than a bank
+ * goes through these. */
+static uint8_t cart_rom_ram_read(uint16_t addr)
+{
+    size_t pos = addr & 0x1fff;
+    if (pos < CART.ram.size) {
+        return CART.ram.bytes[pos];
+    } else {
+        return 0xff;
+    }
+}
+
+static void cart_rom_ram_write(uint16_t addr, uint8_t val)
+{
+    size_t pos = addr & 0x1fff;
+    if (pos < CART.ram.size) {
+        CART.ram.bytes[pos] = val;
+        cart_ram_set_dirty(&CART.ram, pos);
+    }
+}
+
 static int cart_get_mbc(uint8_t cart_type, cart_mbc_t *mbc)
 {
     switch (cart_type) {
         case CART_ROM_ONLY:
+        case CART_ROM_RAM:
+        case CART_ROM_RAM_BATTERY:
+            mbc->init = NULL;
+            mbc->write = NULL;
+            mbc->ram_read = cart_rom_ram_read;
+            mbc->ram_write = cart_rom_ram_write;
+            return 0;
         case CART_MBC1:
         case CART_MBC1_RAM:
         case CART_MBC1_RAM_BATTERY:
@@ -53,6 +87,13 @@ static int cart_get_mbc(uint8_t cart_type, cart_mbc_t *mbc)
             mbc->ram_read = mbc1_ram_read;
             mbc->ram_write = mbc1_ram_write;
             return 0;
+        case CART_MBC2:
+        case CART_MBC2_BATTERY:
+            mbc->init = mbc2_init;
+            mbc->write = mbc2_write;
+            mbc->ram_read = mbc2_ram_read;
+            mbc->ram_write = mbc2_ram_write;
+            return 0;
         case CART_MBC3_TIMER_BATTERY:
         case CART_MBC3_TIMER_RAM_BATTERY:
         case CART_MBC3:
@@ -63,6 +104,23 @@ static int cart_get_mbc(uint8_t cart_type, cart_mbc_t *mbc)
             mbc->ram_read = mbc3_ram_read;
             mbc->ram_write = mbc3_ram_write;
             return 0;
+        case CART_MBC5:
+        case CART_MBC5_RAM:
+        case CART_MBC5_RAM_BATTERY:
+        case CART_MBC5_RUMBLE:
+        case CART_MBC5_RUMBLE_RAM:
+        case CART_MBC5_RUMBLE_RAM_BATTERY:
+            mbc->init = mbc5_init;
+            mbc->write = mbc5_write;
+            mbc->ram_read = mbc5_ram_read;
+            mbc->ram_write = mbc5_ram_write;
+            return 0;
+        case CART_HUC1_RAM_BATTERY:
+            mbc->init = huc1_init;
+            mbc->write = huc1_write;
+            mbc->ram_read = huc1_ram_read;
+            mbc->ram_write = huc1_ram_write;
+            return 0;
         default:
             return -1;
     }
@@ -72,6 +130,7 @@ static bool cart_has_battery(uint8_t cart_type)
 {
     switch (cart_type) {
         case CART_MBC1_RAM_BATTERY:
+        case CART_MBC2_BATTERY:
         case CART_ROM_RAM_BATTERY:
         case CART_MMM01_RAM_BATTERY:
         case CART_MBC3_TIMER_RAM_BATTERY:
@@ -151,6 +210,11 @@ static int cart_load_header(void)
             CART.ram.max_bank = 8;
             break;
     }
+    if (CART.type == CART_MBC2 || CART.type == CART_MBC2_BATTERY) {
+        /* Built-in RAM, not declared in the header. */
+        CART.ram.size = MBC2_RAM_SIZE;
+        CART.ram.max_bank = 1;
+    }
     printf("RAM size: %hhu = %luKB\n", header->ram_size, CART.ram.size / 1024);
     return 0;
 }
@@ -175,11 +239,32 @@ static char *card_get_ram_path(const char *rom_path)
     return ram_path;
 }
 
+static bool cart_ram_use_sync(void)
+{
+    return ram_sync_enabled && cart_has_battery(CART.type) &&
+           CART.ram.size > 0 && CART.ram.path != NULL;
+}
+
 static int cart_ram_init(FILE *ram_save_file)
 {
-    CART.ram.bytes = malloc(CART.ram.size);
     CART.ram.offset = 0x0000;
-    if (ram_save_file) {
+    if (cart_ram_use_sync()) {
+        if (ram_sync_open(&CART.ram) < 0) {
+            return -1;
+        }
+        /* The RTC is stored right after RAM, and is missing if the emulator
+         * did not exit cleanly. */
+        if (ram_save_file) {
+            fseek(ram_save_file, (long)CART.ram.size, SEEK_SET);
+            int c = fgetc(ram_save_file);
+            if (c == EOF) {
+                ram_save_file = NULL;
+            } else {
+                ungetc(c, ram_save_file);
+            }
+        }
+    } else if (ram_save_file) {
+        CART.ram.bytes = malloc(CART.ram.size);
         printf("Loading cartridge RAM from file: %s\n", CART.ram.path);
         size_t rv;
         rv = fread(CART.ram.bytes, 1, CART.ram.size, ram_save_file);
@@ -188,6 +273,7 @@ static int cart_ram_init(FILE *ram_save_file)
             return -1;
         }
     } else {
+        CART.ram.bytes = malloc(CART.ram.size);
         memset(CART.ram.bytes, 0, CART.ram.size);
     }
     CART.ram.enabled = false;
@@ -202,7 +288,21 @@ static int cart_ram_init(FILE *ram_save_file)
 
 static void cart_ram_save(void)
 {
-    if (cart_has_battery(CART.type) && CART.ram.path != NULL) {
+    if (CART.ram.mapped) {
+        /* RAM pages are synced in place, only the RTC is left to write. */
+        ram_sync_close(&CART.ram);
+        printf("Cartridge RAM synced to file: %s\n", CART.ram.path);
+        if (cart_has_rtc(CART.type)) {
+            FILE *f = fopen(CART.ram.path, "r+");
+            if (f == NULL) {
+                fprintf(stderr, "ERROR: Could not open %s\n", CART.ram.path);
+                return;
+            }
+            fseek(f, (long)CART.ram.size, SEEK_SET);
+            mbc3_rtc_save(f);
+            fclose(f);
+        }
+    } else if (cart_has_battery(CART.type) && CART.ram.path != NULL) {
         FILE *f = fopen(CART.ram.path, "w");
         if (f == NULL) {
             fprintf(stderr, "ERROR: Could not open %s\n", CART.ram.path);
@@ -225,9 +325,62 @@ static void cart_ram_save(void)
 
 static void cart_destroy(void)
 {
+    if (CART.ram.mapped)
+        ram_sync_close(&CART.ram);
     free(CART.ram.path);
     free(CART.rom.bytes);
     free(CART.ram.bytes);
+    CART.ram.path = NULL;
+    CART.rom.bytes = NULL;
+    CART.ram.bytes = NULL;
+    CART.ram.bank = NULL;
+}
+
+void cart_set_ram_sync(bool enable)
+{
+    ram_sync_enabled = enable;
+}
+
+void cart_set_rtc_clock(cart_rtc_clock_f clock)
+{
+    mbc3_rtc_set_clock(clock);
+}
+
+void cart_get_map(cart_map_t *map)
+{
+    map->rom0 = CART.rom.bytes;
+    map->rom1 = CART.rom.bank;
+    map->write = CART.mbc.write;
+    map->ram_read = CART.mbc.ram_read;
+    map->ram_write = CART.mbc.ram_write;
+    /* Writes to a mapped save file go through the handler to track dirty
+     * pages. */
+    map->ram_rd = CART.ram.bank;
+    map->ram_wr = CART.ram.mapped ? NULL : CART.ram.bank;
+}
+
+void cart_set_remap_cb(cart_remap_cb_t cb)
+{
+    remap_cb = cb;
+}
+
+void cart_set_rom_bank(unsigned int bank)
+{
+    CART.rom.bank = &CART.rom.bytes[bank * 0x4000];
+    if (remap_cb)
+        remap_cb();
+}
+
+unsigned int cart_get_rom_bank(void)
+{
+    return (unsigned int)((CART.rom.bank - CART.rom.bytes) / 0x4000);
+}
+
+void cart_set_ram_bank(uint8_t *bank)
+{
+    CART.ram.bank = bank;
+    if (remap_cb)
+        remap_cb();
 }
 
 int cart_load(const char *path)
@@ -243,7 +396,7 @@ int cart_load(const char *path)
     /* Init ROM. */
     CART.rom.size = size;
     CART.rom.bytes = malloc(size);
-    CART.rom.offset = 0x4000;
+    CART.rom.bank = &CART.rom.bytes[0x4000];
     /* Read rom to memory. */
     size_t read_size = fread(CART.rom.bytes, 1, size, file);
     fclose(file);
@@ -269,8 +422,11 @@ int cart_load(const char *path)
     }
     if (ram_save_file)
         fclose(ram_save_file);
-    /* Init MBC. */
-    CART.mbc.init();
+    /* Init MBC. Without MBC, a full RAM bank is plain memory. */
+    if (CART.mbc.init)
+        CART.mbc.init();
+    else if (CART.ram.size >= 0x2000)
+        CART.ram.bank = CART.ram.bytes;
     return 0;
 }
 
@@ -287,12 +443,13 @@ uint8_t cart_read_rom0(uint16_t addr)
 
 uint8_t cart_read_rom1(uint16_t addr)
 {
-    return CART.rom.bytes[CART.rom.offset + (addr & 0x3fff)];
+    return CART.rom.bank[addr & 0x3fff];
 }
 
 void cart_write_mbc(uint16_t addr, uint8_t val)
 {
-    CART.mbc.write(addr, val);
+    if (CART.mbc.write)
+        CART.mbc.write(addr, val);
 }
 
 uint8_t cart_read_ram(uint16_t addr)
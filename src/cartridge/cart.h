@@ -1,6 +1,7 @@
 #ifndef __CART_H__
 #define __CART_H__
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -59,7 +60,7 @@ typedef struct {
     uint8_t *bytes;
     size_t size;
     cart_header_t *header;
-    unsigned int offset;
+    uint8_t *bank; /* Switchable bank mapped at 0x4000-0x7fff. */
     unsigned int max_bank;
 } cart_rom_t;
 
@@ -68,10 +69,22 @@ typedef struct {
     size_t size;
     unsigned int offset;
     unsigned int max_bank;
+    uint8_t *bank; /* Bank accessible as plain memory, or NULL. */
     char *path;
     bool enabled;
+    bool mapped;             /* RAM is mmap'ed from the save file. */
+    atomic_uchar *dirty;     /* Dirty page flags when mapped. */
+    unsigned int page_shift; /* log2 of the host page size. */
 } cart_ram_t;
 
+/* Mark the page holding RAM position pos to be synced to the save file. */
+static inline void cart_ram_set_dirty(cart_ram_t *ram, size_t pos)
+{
+    if (ram->dirty)
+        atomic_store_explicit(&ram->dirty[pos >> ram->page_shift], 1,
+                              memory_order_release);
+}
+
 typedef void (*mbc_init_f)(void);
 typedef void (*mbc_write_f)(uint16_t addr, uint8_t val);
 typedef uint8_t (*mbc_ram_read_f)(uint16_t addr);
@@ -91,6 +104,31 @@ typedef struct {
     cart_mbc_t mbc;
 } cart_t;
 
+/* Cartridge memory and handlers, bound by the MMU at load time. */
+typedef struct {
+    uint8_t *rom0;             /* ROM bank 0 at 0x0000-0x3fff. */
+    uint8_t *rom1;             /* Switchable ROM bank at 0x4000-0x7fff. */
+    uint8_t *ram_rd;           /* Directly readable RAM, or NULL. */
+    uint8_t *ram_wr;           /* Directly writable RAM, or NULL. */
+    mbc_write_f write;         /* MBC registers, NULL without MBC. */
+    mbc_ram_read_f ram_read;   /* RAM read when ram_rd is NULL. */
+    mbc_ram_write_f ram_write; /* RAM write when ram_wr is NULL. */
+} cart_map_t;
+
+/* Called when the cartridge map changes, e.g. on ROM bank switch. */
+typedef void (*cart_remap_cb_t)(void);
+
+/* RTC time source in 32768 Hz ticks. */
+typedef uint64_t (*cart_rtc_clock_f)(void);
+
+void cart_set_ram_sync(bool enable);
+/* Drive the RTC from clock, or from the wall clock if NULL. */
+void cart_set_rtc_clock(cart_rtc_clock_f clock);
+void cart_get_map(cart_map_t *map);
+void cart_set_remap_cb(cart_remap_cb_t cb);
+void cart_set_rom_bank(unsigned int bank);
+unsigned int cart_get_rom_bank(void);
+void cart_set_ram_bank(uint8_t *bank);
 int cart_load(const char *path);
 void cart_unload(void);
 uint8_t cart_read_rom0(uint16_t addr);
@@ -0,0 +1,76 @@
+#include "huc1.h"
+#include "cart.h"
+
+/* Value written to 0x0000-0x1fff to map the IR port at 0xa000-0xbfff. */
+#define HUC1_IR_SELECT 0x0e
+
+typedef struct {
+    uint8_t rom_bank;
+    uint8_t ram_bank;
+    bool ir_mode; /* 0xa000-0xbfff mapped to the IR port instead of RAM. */
+    uint8_t ir;   /* IR LED state. */
+} mbc_t;
+
+static mbc_t MBC;
+extern cart_t CART;
+
+static void huc1_change_bank(void)
+{
+    unsigned int rom_bank_tmp = MBC.rom_bank & (CART.rom.max_bank - 1);
+    cart_set_rom_bank(rom_bank_tmp);
+}
+
+void huc1_init(void)
+{
+    MBC.rom_bank = 1;
+    MBC.ram_bank = 0;
+    MBC.ir_mode = false;
+    MBC.ir = 0;
+    /* HuC1 has no RAM enable register: RAM is mapped unless in IR mode. */
+    CART.ram.enabled = true;
+    huc1_change_bank();
+}
+
+void huc1_write(uint16_t addr, uint8_t val)
+{
+    if (addr <= 0x1fff) {
+        /* Select IR or RAM at 0xa000-0xbfff. */
+        MBC.ir_mode = (val & 0x0f) == HUC1_IR_SELECT;
+    } else if (addr <= 0x3fff) {
+        /* Select ROM bank 1-63 (value 0 is seen as 1). */
+        uint8_t bank = val & 0x3f;
+        MBC.rom_bank = bank == 0 ? 1 : bank;
+        huc1_change_bank();
+    } else if (addr <= 0x5fff) {
+        /* Select RAM bank 0-3. */
+        MBC.ram_bank = val & 3;
+        CART.ram.offset = (MBC.ram_bank & (CART.ram.max_bank - 1)) * 0x2000;
+    }
+}
+
+uint8_t huc1_ram_read(uint16_t addr)
+{
+    if (MBC.ir_mode) {
+        /* No IR light is ever received. */
+        return 0xc0;
+    }
+    size_t pos = CART.ram.offset + (addr & 0x1fff);
+    if (pos < CART.ram.size) {
+        return CART.ram.bytes[pos];
+    } else {
+        return 0xff;
+    }
+}
+
+void huc1_ram_write(uint16_t addr, uint8_t val)
+{
+    if (MBC.ir_mode) {
+        MBC.ir = val & 1;
+        return;
+    }
+    size_t pos = CART.ram.offset + (addr & 0x1fff);
+    if (pos < CART.ram.size) {
+        CART.ram.bytes[pos] = val;
+        cart_ram_set_dirty(&CART.ram, pos);
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef __HUC1_H__
+#define __HUC1_H__
+
+#include <stdint.h>
+
+void huc1_init(void);
+void huc1_write(uint16_t addr, uint8_t val);
+uint8_t huc1_ram_read(uint16_t addr);
+void huc1_ram_write(uint16_t addr, uint8_t val);
+
+#endif /* __HUC1_H__ */
@@ -7,20 +7,30 @@ typedef struct {
     uint8_t mode;
 } mbc_t;
 
-mbc_t MBC;
+static mbc_t MBC;
 extern cart_t CART;
 
+static void mbc1_change_bank(void)
+{
+    unsigned int rom_bank_tmp = MBC.rom_bank % CART.rom.max_bank;
+    cart_set_rom_bank(rom_bank_tmp);
+}
+
+/* Enabled RAM banks are accessed as plain memory. */
+static void mbc1_map_ram(void)
+{
+    bool full_bank = CART.ram.offset + 0x2000 <= CART.ram.size;
+    cart_set_ram_bank(CART.ram.enabled && full_bank
+                          ? &CART.ram.bytes[CART.ram.offset]
+                          : NULL);
+}
+
 void mbc1_init(void)
 {
     MBC.rom_bank = 1;
     MBC.ram_bank = 0;
     MBC.mode = 0;
-}
-
-static void mbc1_change_bank(void)
-{
-    unsigned int rom_bank_tmp = MBC.rom_bank % CART.rom.max_bank;
-    CART.rom.offset = (unsigned int)(rom_bank_tmp) * 0x4000;
+    mbc1_map_ram();
 }
 
 void mbc1_write(uint16_t addr, uint8_t val)
@@ -28,6 +38,7 @@ void mbc1_write(uint16_t addr, uint8_t val)
     if (addr <= 0x1fff) {
         /* Enable/disable external RAM. */
         CART.ram.enabled = (val & 0x0f) == 0x0a ? true : false;
+        mbc1_map_ram();
     } else if (addr <= 0x3fff) {
         /* Switch between banks 1-31 (value 0 is seen as 1). */
         uint8_t bankl = val & 0x1f;
@@ -44,6 +55,7 @@ void mbc1_write(uint16_t addr, uint8_t val)
             /* RAM mode: switch RAM bank 0-3. */
             MBC.ram_bank = val & 3;
             CART.ram.offset = (unsigned int)(MBC.ram_bank % CART.ram.max_bank) * 0x2000;
+            mbc1_map_ram();
         } else {
             /* ROM mode (high 2 bits): switch ROM bank "set" {1-31}-{97-127}. */
             MBC.rom_bank =
@@ -71,6 +83,7 @@ void mbc1_ram_write(uint16_t addr, uint8_t val)
         size_t pos = CART.ram.offset + (addr & 0x1fff);
         if (pos < CART.ram.size) {
             CART.ram.bytes[pos] = val;
+            cart_ram_set_dirty(&CART.ram, pos);
         }
     }
 }
@@ -0,0 +1,56 @@
+#include "mbc2.h"
+#include "cart.h"
+
+typedef struct {
+    uint8_t rom_bank;
+} mbc_t;
+
+static mbc_t MBC;
+extern cart_t CART;
+
+static void mbc2_change_bank(void)
+{
+    unsigned int rom_bank_tmp = MBC.rom_bank & (CART.rom.max_bank - 1);
+    cart_set_rom_bank(rom_bank_tmp);
+}
+
+void mbc2_init(void)
+{
+    MBC.rom_bank = 1;
+    mbc2_change_bank();
+}
+
+void mbc2_write(uint16_t addr, uint8_t val)
+{
+    if (addr > 0x3fff)
+        return;
+    if (addr & 0x0100) {
+        /* Select ROM bank 1-15 (value 0 is seen as 1). */
+        uint8_t bank = val & 0x0f;
+        MBC.rom_bank = bank == 0 ? 1 : bank;
+        mbc2_change_bank();
+    } else {
+        /* Enable/disable built-in RAM. */
+        CART.ram.enabled = (val & 0x0f) == 0x0a ? true : false;
+    }
+}
+
+/* The built-in RAM is mirrored over 0xa000-0xbfff. Only the lower nibble is
+ * stored, the upper one reads as 1s. */
+uint8_t mbc2_ram_read(uint16_t addr)
+{
+    if (CART.ram.enabled) {
+        return CART.ram.bytes[addr & (MBC2_RAM_SIZE - 1)] | 0xf0;
+    } else {
+        return 0xff;
+    }
+}
+
+void mbc2_ram_write(uint16_t addr, uint8_t val)
+{
+    if (CART.ram.enabled) {
+        size_t pos = addr & (MBC2_RAM_SIZE - 1);
+        CART.ram.bytes[pos] = val & 0x0f;
+        cart_ram_set_dirty(&CART.ram, pos);
+    }
+}
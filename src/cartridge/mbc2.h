@@ -0,0 +1,14 @@
+#ifndef __MBC2_H__
+#define __MBC2_H__
+
+#include <stdint.h>
+
+/* MBC2 built-in RAM: 512 x 4 bits, stored one nibble per byte. */
+#define MBC2_RAM_SIZE 512
+
+void mbc2_init(void);
+void mbc2_write(uint16_t addr, uint8_t val);
+uint8_t mbc2_ram_read(uint16_t addr);
+void mbc2_ram_write(uint16_t addr, uint8_t val);
+
+#endif /* __MBC2_H__ */
@@ -6,15 +6,44 @@
 #define HOUR_SECS (60 * 60)
 #define DAY_SECS (60 * 60 * 24)
 
+#define RTC_HALT (1 << 6)
+
 typedef struct {
     uint8_t rom_bank;
     uint8_t ram_bank;
     rtc_t rtc;
+    uint64_t rtc_start;     /* Clock ticks when the RTC time was last synced. */
+    cart_rtc_clock_f clock; /* Emulated time source, NULL for wall clock. */
 } mbc_t;
 
-mbc_t MBC;
+static mbc_t MBC;
 extern cart_t CART;
 
+void mbc3_rtc_set_clock(cart_rtc_clock_f clock)
+{
+    MBC.clock = clock;
+}
+
+static uint64_t mbc3_rtc_now(void)
+{
+    if (MBC.clock)
+        return MBC.clock();
+    return (uint64_t)time(NULL) * RTC_HZ;
+}
+
+/* Advance RTC time to now, keeping the sub-second remainder. */
+static void mbc3_rtc_sync(void)
+{
+    uint64_t now = mbc3_rtc_now();
+    if ((MBC.rtc.time.dayh & RTC_HALT) || now < MBC.rtc_start) {
+        MBC.rtc_start = now;
+        return;
+    }
+    uint64_t secs = (now - MBC.rtc_start) / RTC_HZ;
+    mbc3_rtc_update(&MBC.rtc.time, (time_t)secs);
+    MBC.rtc_start += secs * RTC_HZ;
+}
+
 void mbc3_init(void)
 {
     MBC.rom_bank = 1;
@@ -34,6 +63,12 @@ int mbc3_rtc_load(FILE *file)
         memset(&MBC.rtc.latched_time, 0, sizeof(MBC.rtc.latched_time));
         MBC.rtc.time_start = time(NULL);
     }
+    if (MBC.clock) {
+        /* Emulated time does not run while the emulator is off. */
+        MBC.rtc_start = MBC.clock();
+    } else {
+        MBC.rtc_start = (uint64_t)MBC.rtc.time_start * RTC_HZ;
+    }
     printf("RTC current: ");
     rtc_print(&MBC.rtc.time);
     printf("RTC latched: ");
@@ -43,6 +78,8 @@ int mbc3_rtc_load(FILE *file)
 
 int mbc3_rtc_save(FILE *file)
 {
+    mbc3_rtc_sync();
+    MBC.rtc.time_start = time(NULL);
     int rv = fwrite(&MBC.rtc, 1, sizeof(MBC.rtc), file);
     if (rv != sizeof(MBC.rtc)) {
         fprintf(stderr, "Could not save RTC to save file\n");
@@ -54,7 +91,7 @@ int mbc3_rtc_save(FILE *file)
 static void mbc3_change_bank(void)
 {
     unsigned int rom_bank_tmp = MBC.rom_bank % CART.rom.max_bank;
-    CART.rom.offset = (unsigned int)(rom_bank_tmp)*0x4000;
+    cart_set_rom_bank(rom_bank_tmp);
 }
 
 void mbc3_rtc_update(rtc_time_t *time, time_t diff)
@@ -96,8 +133,7 @@ void mbc3_write(uint16_t addr, uint8_t val)
         /* Latch Clock Data. */
         static uint8_t last = 0xff;
         if (last == 0 && val == 1) {
-            time_t time_diff = time(NULL) - MBC.rtc.time_start;
-            mbc3_rtc_update(&MBC.rtc.time, time_diff);
+            mbc3_rtc_sync();
             MBC.rtc.latched_time = MBC.rtc.time;
         }
         last = val;
@@ -128,14 +164,15 @@ void mbc3_ram_write(uint16_t addr, uint8_t val)
         uint8_t bank = MBC.ram_bank;
         if (bank <= 7) {
             CART.ram.bytes[pos] = val;
+            cart_ram_set_dirty(&CART.ram, pos);
         } else if (bank <= 0x0c) {
-            if (MBC.rtc.time.reg[4] & 0x40 || (bank == 0x0c && val & 0x40)) {
+            if (MBC.rtc.time.reg[4] & RTC_HALT ||
+                (bank == 0x0c && val & RTC_HALT)) {
                 /* The Halt Flag is supposed to be set before writing to the RTC
-                 * registers. */
+                 * registers. Counting restarts from the written time. */
+                mbc3_rtc_sync();
                 MBC.rtc.time.reg[bank - 8] = val;
-                if ((val & 0x40) == 0) {
-                    MBC.rtc.time_start = time(NULL);
-                }
+                MBC.rtc_start = mbc3_rtc_now();
             }
         }
     }
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <time.h>
+#include "cart.h"
 
 typedef struct {
     union {
@@ -20,13 +21,18 @@ typedef struct {
 
 void rtc_print(rtc_time_t *time);
 
+/* Saved RTC state, appended to the save file after RAM. */
 typedef struct {
     rtc_time_t time;
     rtc_time_t latched_time;
-    time_t time_start;
+    time_t time_start; /* Wall clock time of the last sync. */
 } rtc_t;
 
+/* RTC oscillator frequency. */
+#define RTC_HZ 32768
+
 void mbc3_init(void);
+void mbc3_rtc_set_clock(cart_rtc_clock_f clock);
 void mbc3_write(uint16_t addr, uint8_t val);
 uint8_t mbc3_ram_read(uint16_t addr);
 void mbc3_ram_write(uint16_t addr, uint8_t val);
@@ -0,0 +1,87 @@
+#include "mbc5.h"
+#include "cart.h"
+
+typedef struct {
+    uint16_t rom_bank;      /* 9-bit ROM bank number. */
+    uint8_t ram_bank;       /* 4-bit RAM bank number. */
+    uint8_t ram_mask;       /* RAM bank bits (bit 3 drives the rumble motor). */
+    uint16_t ram_addr_mask; /* Address mask inside a RAM bank. */
+    uint8_t *ram;           /* Selected RAM bank. */
+} mbc_t;
+
+static mbc_t MBC;
+extern cart_t CART;
+
+static bool mbc5_has_rumble(void)
+{
+    return CART.type == CART_MBC5_RUMBLE ||
+           CART.type == CART_MBC5_RUMBLE_RAM ||
+           CART.type == CART_MBC5_RUMBLE_RAM_BATTERY;
+}
+
+/* ROM and RAM bank counts are powers of two, so wrapping bank numbers is a
+ * mask and the selected bank is cached as a host pointer. */
+static void mbc5_change_rom_bank(void)
+{
+    unsigned int bank = MBC.rom_bank & (CART.rom.max_bank - 1);
+    cart_set_rom_bank(bank);
+}
+
+static void mbc5_change_ram_bank(void)
+{
+    unsigned int bank = MBC.ram_bank & (CART.ram.max_bank - 1);
+    MBC.ram = &CART.ram.bytes[bank * 0x2000];
+    /* Enabled RAM banks are accessed as plain memory. */
+    bool full_bank = CART.ram.size >= 0x2000;
+    cart_set_ram_bank(CART.ram.enabled && full_bank ? MBC.ram : NULL);
+}
+
+void mbc5_init(void)
+{
+    MBC.rom_bank = 1;
+    MBC.ram_bank = 0;
+    MBC.ram_mask = mbc5_has_rumble() ? 0x07 : 0x0f;
+    /* 2KB RAM carts mirror the single bank over 0xa000-0xbfff. */
+    MBC.ram_addr_mask = CART.ram.size < 0x2000 ? CART.ram.size - 1 : 0x1fff;
+    mbc5_change_rom_bank();
+    mbc5_change_ram_bank();
+}
+
+void mbc5_write(uint16_t addr, uint8_t val)
+{
+    if (addr <= 0x1fff) {
+        /* Enable/disable external RAM. */
+        CART.ram.enabled = (val & 0x0f) == 0x0a ? true : false;
+        mbc5_change_ram_bank();
+    } else if (addr <= 0x2fff) {
+        /* Low 8 bits of ROM bank (value 0 selects bank 0). */
+        MBC.rom_bank = (uint16_t)((MBC.rom_bank & 0x100) | val);
+        mbc5_change_rom_bank();
+    } else if (addr <= 0x3fff) {
+        /* Bit 8 of ROM bank. */
+        MBC.rom_bank = (uint16_t)((MBC.rom_bank & 0xff) | ((val & 1) << 8));
+        mbc5_change_rom_bank();
+    } else if (addr <= 0x5fff) {
+        /* Select RAM bank 0-15. */
+        MBC.ram_bank = val & MBC.ram_mask;
+        mbc5_change_ram_bank();
+    }
+}
+
+uint8_t mbc5_ram_read(uint16_t addr)
+{
+    if (CART.ram.enabled && CART.ram.size > 0) {
+        return MBC.ram[addr & MBC.ram_addr_mask];
+    } else {
+        return 0xff;
+    }
+}
+
+void mbc5_ram_write(uint16_t addr, uint8_t val)
+{
+    if (CART.ram.enabled && CART.ram.size > 0) {
+        uint8_t *p = &MBC.ram[addr & MBC.ram_addr_mask];
+        *p = val;
+        cart_ram_set_dirty(&CART.ram, (size_t)(p - CART.ram.bytes));
+    }
+}
@@ -0,0 +1,133 @@
+#include "ram_sync.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool running;
+    int fd;
+} ram_sync_t;
+
+static ram_sync_t SYNC = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .fd = -1,
+};
+
+void ram_sync_flush(cart_ram_t *ram)
+{
+    size_t page_size = (size_t)1 << ram->page_shift;
+    size_t pages = (ram->size + page_size - 1) >> ram->page_shift;
+    for (size_t i = 0; i < pages; ++i) {
+        /* Clear the flag before syncing, so a write racing with msync marks
+         * the page dirty again for the next round. */
+        if (!atomic_exchange_explicit(&ram->dirty[i], 0, memory_order_acquire))
+            continue;
+        size_t offset = i << ram->page_shift;
+        size_t len = ram->size - offset < page_size ? ram->size - offset
+                                                    : page_size;
+        if (msync(ram->bytes + offset, len, MS_SYNC) < 0) {
+            perror("msync ram");
+        }
+    }
+}
+
+static void *ram_sync_thread(void *arg)
+{
+    cart_ram_t *ram = arg;
+    pthread_mutex_lock(&SYNC.lock);
+    while (SYNC.running) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += (RAM_SYNC_INTERVAL_MS % 1000) * 1000000L;
+        ts.tv_sec += RAM_SYNC_INTERVAL_MS / 1000 + ts.tv_nsec / 1000000000L;
+        ts.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&SYNC.cond, &SYNC.lock, &ts);
+        pthread_mutex_unlock(&SYNC.lock);
+        ram_sync_flush(ram);
+        pthread_mutex_lock(&SYNC.lock);
+    }
+    pthread_mutex_unlock(&SYNC.lock);
+    return NULL;
+}
+
+int ram_sync_open(cart_ram_t *ram)
+{
+    int fd = open(ram->path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("open ram");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("fstat ram");
+        close(fd);
+        return -1;
+    }
+    /* A new (or short) save file is zero-extended to the RAM size. */
+    if ((size_t)st.st_size < ram->size && ftruncate(fd, (off_t)ram->size) < 0) {
+        perror("ftruncate ram");
+        close(fd);
+        return -1;
+    }
+    void *bytes =
+        mmap(NULL, ram->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (bytes == MAP_FAILED) {
+        perror("mmap ram");
+        close(fd);
+        return -1;
+    }
+    ram->bytes = bytes;
+    ram->mapped = true;
+    SYNC.fd = fd;
+    ram->page_shift = (unsigned int)__builtin_ctzl(sysconf(_SC_PAGESIZE));
+    size_t pages = (ram->size >> ram->page_shift) + 1;
+    ram->dirty = calloc(pages, sizeof(*ram->dirty));
+    if (ram->dirty == NULL) {
+        perror("calloc ram dirty pages");
+        ram_sync_close(ram);
+        return -1;
+    }
+    SYNC.running = true;
+    int ret = pthread_create(&SYNC.thread, NULL, ram_sync_thread, ram);
+    if (ret != 0) {
+        errno = ret;
+        perror("pthread_create ram sync");
+        SYNC.running = false;
+        ram_sync_close(ram);
+        return -1;
+    }
+    printf("Cartridge RAM mapped to file: %s\n", ram->path);
+    return 0;
+}
+
+void ram_sync_close(cart_ram_t *ram)
+{
+    if (!ram->mapped)
+        return;
+    pthread_mutex_lock(&SYNC.lock);
+    bool running = SYNC.running;
+    SYNC.running = false;
+    pthread_cond_signal(&SYNC.cond);
+    pthread_mutex_unlock(&SYNC.lock);
+    if (running)
+        pthread_join(SYNC.thread, NULL);
+    /* Without the dirty map, nothing was written through the mapping. */
+    if (ram->dirty)
+        ram_sync_flush(ram);
+    munmap(ram->bytes, ram->size);
+    close(SYNC.fd);
+    SYNC.fd = -1;
+    free(ram->dirty);
+    ram->dirty = NULL;
+    ram->bytes = NULL;
+    ram->mapped = false;
+}
@@ -0,0 +1,19 @@
+#ifndef __RAM_SYNC_H__
+#define __RAM_SYNC_H__
+
+#include "cart.h"
+
+/* Sync interval of dirty battery RAM pages to disk. */
+#define RAM_SYNC_INTERVAL_MS 500
+
+/* Map the battery RAM save file of ram->path into ram->bytes and start the
+ * background thread that writes dirty pages back to it. */
+int ram_sync_open(cart_ram_t *ram);
+
+/* Stop the background thread, flush remaining dirty pages and unmap RAM. */
+void ram_sync_close(cart_ram_t *ram);
+
+/* Write dirty pages back to the save file. */
+void ram_sync_flush(cart_ram_t *ram);
+
+#endif /* __RAM_SYNC_H__ */
@@ -1,17 +1,32 @@
 #include "clock.h"
+#include "profile.h"
+#include "serial.h"
 #include "timer.h"
 
+/* Normal speed CPU cycles per 32768 Hz RTC tick. */
+#define CYCLES_PER_RTC_TICK 128
+
 static unsigned int step;
+static unsigned int speed;
+static uint64_t elapsed; /* Normal speed cycles since reset. */
 
 void clock_reset(void)
 {
     timer_reset();
+    speed = 0;
+    elapsed = 0;
 }
 
 void clock_step(unsigned int cycles)
 {
+    PROF_ENTER(PROF_TIMER);
     timer_step(cycles);
+    PROF_ENTER(PROF_SERIAL);
+    serial_step(cycles);
+    PROF_ENTER(PROF_CPU);
     step += cycles;
+    /* Cycles run twice as fast in double speed mode. */
+    elapsed += cycles >> speed;
 }
 
 unsigned int clock_get_step(void)
@@ -23,3 +38,18 @@ void clock_clear(void)
 {
     step = 0;
 }
+
+void clock_change_speed(unsigned int new_speed)
+{
+    speed = new_speed;
+}
+
+uint64_t clock_get_cycles(void)
+{
+    return elapsed;
+}
+
+uint64_t clock_get_rtc_ticks(void)
+{
+    return elapsed / CYCLES_PER_RTC_TICK;
+}
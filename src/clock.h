@@ -1,9 +1,16 @@
 #ifndef CLOCK_H
 #define CLOCK_H
 
+#include <stdint.h>
+
 void clock_reset(void);
 void clock_step(unsigned int cycles);
 unsigned int clock_get_step(void);
 void clock_clear(void);
+void clock_change_speed(unsigned int new_speed);
+/* Normal speed cycles since reset. */
+uint64_t clock_get_cycles(void);
+/* Emulated time in 32768 Hz RTC ticks. */
+uint64_t clock_get_rtc_ticks(void);
 
 #endif /* CLOCK_H */
@@ -7,11 +7,16 @@
 #include "cpu_ext_ops.h"
 #include "cpu_opcodes.h"
 #include "debug.h"
+#include "debugger.h"
 #include "gpu.h"
 #include "interrupt.h"
 #include "mmu.h"
+#include "profile.h"
+#include "serial.h"
+#include "trace.h"
 
 cpu_t CPU;
+static cpu_instr_cb_t instr_cb;
 
 typedef void (*func0)(void);
 typedef void (*func8)(uint8_t);
@@ -285,35 +290,13 @@ const instruction_t g_instr[256] = {
     {"rst $38", NULL, 0, rst_38, NULL, NULL},            // 0xff
 };
 
-#ifdef DEBUG
-char debug_str[100];
-
-static char *cpu_debug_instr0(char *str, uint8_t opcode)
-{
-    sprintf(str, "0x%02x:   %s", opcode, g_instr[opcode].asm1);
-    return str;
-}
-
-static char *cpu_debug_instr1(char *str, uint8_t opcode, uint8_t operand)
-{
-    const char *asm1 = g_instr[opcode].asm1;
-    const char *asm2 = g_instr[opcode].asm2 ? g_instr[opcode].asm2 : "";
-    if (opcode == 0xcb) {
-        print_ext_ops(str, operand);
-    } else {
-        sprintf(str, "0x%02x:   %s%02x%s", opcode, asm1, operand, asm2);
-    }
-    return str;
-}
-
-static char *cpu_debug_instr2(char *str, uint8_t opcode, uint16_t operand)
+void cpu_print_instr(char *str, uint8_t opcode)
 {
-    const char *asm1 = g_instr[opcode].asm1;
-    const char *asm2 = g_instr[opcode].asm2 ? g_instr[opcode].asm2 : "";
-    sprintf(str, "0x%02x:   %s%04x%s", opcode, asm1, operand, asm2);
-    return str;
+    static const char *operands[] = {"", "n", "nn"};
+    const instruction_t *instr = &g_instr[opcode];
+    sprintf(str, "0x%02x:   %s%s%s", opcode, instr->asm1,
+            operands[instr->operand_length], instr->asm2 ? instr->asm2 : "");
 }
-#endif
 
 void cpu_dump(void)
 {
@@ -324,6 +307,12 @@ void cpu_dump(void)
     gpu_dump();
     mmu_dump(0xc000, 128);
     interrupt_dump();
+    serial_dump();
+}
+
+void cpu_set_instr_cb(cpu_instr_cb_t cb)
+{
+    instr_cb = cb;
 }
 
 int cpu_init(const char *rom_path)
@@ -357,6 +346,7 @@ void cpu_reset(void)
     }
     clock_reset();
     mmu_reset();
+    trace_reset();
 }
 
 static uint8_t cpu_fetch_opcode(void)
@@ -366,40 +356,80 @@ static uint8_t cpu_fetch_opcode(void)
     return op;
 }
 
+/* Record the CPU state before the instruction at CPU.last_pc executes. */
+static void cpu_trace(uint8_t opcode, uint16_t operand)
+{
+    trace_entry_t *entry = trace_next();
+    if (entry == NULL)
+        return;
+    entry->cycles = (uint32_t)clock_get_cycles();
+    entry->pc = CPU.last_pc;
+    entry->sp = CPU.reg.sp;
+    entry->af = CPU.reg.af;
+    entry->bc = CPU.reg.bc;
+    entry->de = CPU.reg.de;
+    entry->hl = CPU.reg.hl;
+    entry->opcode = opcode;
+    entry->operand[0] = (uint8_t)operand;
+    entry->operand[1] = (uint8_t)(operand >> 8);
+    if (CPU.last_pc >= 0x4000 && CPU.last_pc < 0x8000)
+        entry->bank = (uint8_t)cart_get_rom_bank();
+}
+
 static void cpu_decode_opcode(uint8_t opcode)
 {
     uint8_t oper_length = g_instr[opcode].operand_length;
-    printd("PC:0x%04x SP:0x%04x AF:0x%04x BC:0x%04x DE:0x%04x HL:0x%04x: ",
-           CPU.last_pc, CPU.reg.sp, CPU.reg.af, CPU.reg.bc, CPU.reg.de,
-           CPU.reg.hl);
     if (oper_length == 0) {
-        printd("%s\n", cpu_debug_instr0(debug_str, opcode));
+        cpu_trace(opcode, 0);
         g_instr[opcode].exec0();
+        PROF_OPCODE(opcode, 0, CPU.last_pc, clock_get_step());
     } else if (oper_length == 1) {
         uint8_t operand = mmu_read_byte(CPU.reg.pc);
         CPU.reg.pc = (uint16_t)(CPU.reg.pc + 1);
-        printd("%s\n", cpu_debug_instr1(debug_str, opcode, operand));
+        cpu_trace(opcode, operand);
         g_instr[opcode].exec1(operand);
+        PROF_OPCODE(opcode, operand, CPU.last_pc, clock_get_step());
     } else if (oper_length == 2) {
         uint16_t operand = mmu_read_word(CPU.reg.pc);
         CPU.reg.pc = (uint16_t)(CPU.reg.pc + 2);
-        printd("%s\n", cpu_debug_instr2(debug_str, opcode, operand));
+        cpu_trace(opcode, operand);
         g_instr[opcode].exec2(operand);
+        PROF_OPCODE(opcode, 0, CPU.last_pc, clock_get_step());
     } else {
         error("invalid operand length %hhu", oper_length);
     }
 }
 
-void cpu_emulate_cycle(void)
+/* With debug, the debugger may stop before the instruction. Inlined into
+ * both entry points so that running freely tests nothing. */
+static inline void cpu_cycle(bool debug)
 {
+    PROF_ENTER(PROF_CPU);
     interrupt_step();
     clock_clear();
-    if (CPU.halt) {
+    unsigned int stall = gpu_take_dma_stall();
+    if (stall) {
+        /* The CPU is halted during VRAM DMA. */
+        clock_step(stall);
+    } else if (CPU.halt) {
         /* Tick clock while halted. */
         clock_step(4);
-    } else {
+    } else if (!debug || !debugger_break()) {
+        if (instr_cb)
+            instr_cb();
         uint8_t opcode = cpu_fetch_opcode();
         cpu_decode_opcode(opcode);
     }
+    PROF_SAMPLE(clock_get_step());
     gpu_step(clock_get_step());
 }
+
+void cpu_emulate_cycle(void)
+{
+    cpu_cycle(false);
+}
+
+void cpu_debug_cycle(void)
+{
+    cpu_cycle(true);
+}
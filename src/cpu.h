@@ -101,10 +101,19 @@ typedef struct {
     bool halt;
 } cpu_t;
 
+/* Called before each instruction executes. */
+typedef void (*cpu_instr_cb_t)(void);
+
 int cpu_init(const char *rom_path);
 void cpu_finish(void);
 void cpu_reset(void);
 void cpu_emulate_cycle(void);
+/* cpu_emulate_cycle() checking breakpoints, steps and stops, while the
+ * debugger is armed. */
+void cpu_debug_cycle(void);
 void cpu_dump(void);
+/* Write the opcode number and mnemonic to str. */
+void cpu_print_instr(char *str, uint8_t opcode);
+void cpu_set_instr_cb(cpu_instr_cb_t cb);
 
 #endif /* CPU_H */
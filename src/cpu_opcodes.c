@@ -4,8 +4,10 @@
 #include "clock.h"
 #include "cpu.h"
 #include "cpu_utils.h"
+#include "debug.h"
 #include "interrupt.h"
 #include "mmu.h"
+#include "profile.h"
 
 extern cpu_t CPU;
 
@@ -298,8 +300,7 @@ void undefined(void)
 {
     CPU.reg.pc--;
     uint8_t opcode = mmu_read_byte(CPU.reg.pc);
-    printf("ERROR: undefined instruction 0x%02x!\n", opcode);
-    exit(EXIT_FAILURE);
+    error("undefined instruction 0x%02x", opcode);
 }
 
 /*************** Opcodes implementation. ***************/
@@ -1466,6 +1467,7 @@ void ret_nz(void)
 {
     if (!FLAG_IS_SET(FLAG_Z)) {
         reg16_set(&CPU.reg.pc, pop());
+        PROF_RET(CPU.reg.sp);
     }
     clock_step(4);
 }
@@ -1496,6 +1498,7 @@ void call_nz_nn(uint16_t addr)
     if (!FLAG_IS_SET(FLAG_Z)) {
         push(CPU.reg.pc);
         CPU.reg.pc = addr;
+        PROF_CALL(CPU.reg.pc, CPU.reg.sp);
     }
 }
 
@@ -1516,6 +1519,7 @@ void rst_00(void)
 {
     push(CPU.reg.pc);
     CPU.reg.pc = 0x0000;
+    PROF_CALL(CPU.reg.pc, CPU.reg.sp);
 }
 
 /* 0xc8: Return if Z flag is set. */
@@ -1523,6 +1527,7 @@ void ret_z(void)
 {
     if (FLAG_IS_SET(FLAG_Z)) {
         reg16_set(&CPU.reg.pc, pop());
+        PROF_RET(CPU.reg.sp);
     }
     clock_step(4);
 }
@@ -1531,6 +1536,7 @@ void ret_z(void)
 void ret(void)
 {
     reg16_set(&CPU.reg.pc, pop());
+    PROF_RET(CPU.reg.sp);
 }
 
 /* 0xca: Jump to address. */
@@ -1547,6 +1553,7 @@ void call_z_nn(uint16_t addr)
     if (FLAG_IS_SET(FLAG_Z)) {
         push(CPU.reg.pc);
         CPU.reg.pc = addr;
+        PROF_CALL(CPU.reg.pc, CPU.reg.sp);
     }
 }
 
@@ -1555,6 +1562,7 @@ void call_nn(uint16_t addr)
 {
     push(CPU.reg.pc);
     CPU.reg.pc = addr;
+    PROF_CALL(CPU.reg.pc, CPU.reg.sp);
 }
 
 /* 0xce: Add immediate 8-bit value and carry flag to A. */
@@ -1568,6 +1576,7 @@ void rst_08(void)
 {
     push(CPU.reg.pc);
     CPU.reg.pc = 0x0008;
+    PROF_CALL(CPU.reg.pc, CPU.reg.sp);
 }
 
 /* 0xd0: Return if C flag is not set. */
@@ -1575,6 +1584,7 @@ void ret_nc(void)
 {
     if (!FLAG_IS_SET(FLAG_C)) {
         reg16_set(&CPU.reg.pc, pop());
+        PROF_RET(CPU.reg.sp);
     }
     clock_step(4);
 }
@@ -1599,6 +1609,7 @@ void call_nc_nn(uint16_t addr)
     if (!FLAG_IS_SET(FLAG_C)) {
         push(CPU.reg.pc);
         CPU.reg.pc = addr;
+        PROF_CALL(CPU.reg.pc, CPU.reg.sp);
     }
 }
 
@@ -1619,6 +1630,7 @@ void rst_10(void)
 {
     push(CPU.reg.pc);
     CPU.reg.pc = 0x0010;
+    PROF_CALL(CPU.reg.pc, CPU.reg.sp);
 }
 
 /* 0xd8: Return if C flag is set. */
@@ -1626,6 +1638,7 @@ void ret_c(void)
 {
     if (FLAG_IS_SET(FLAG_C)) {
         reg16_set(&CPU.reg.pc, pop());
+        PROF_RET(CPU.reg.sp);
     }
     clock_step(4);
 }
@@ -1635,6 +1648,7 @@ void ret_c(void)
 void reti(void)
 {
     reg16_set(&CPU.reg.pc, pop());
+    PROF_RET(CPU.reg.sp);
     interrupt_set_master(1);
 }
 
@@ -1652,6 +1666,7 @@ void call_c_nn(uint16_t addr)
     if (FLAG_IS_SET(FLAG_C)) {
         push(CPU.reg.pc);
         CPU.reg.pc = addr;
+        PROF_CALL(CPU.reg.pc, CPU.reg.sp);
     }
 }
 
@@ -1666,6 +1681,7 @@ void rst_18(void)
 {
     push(CPU.reg.pc);
     CPU.reg.pc = 0x0018;
+    PROF_CALL(CPU.reg.pc, CPU.reg.sp);
 }
 
 /* 0xe0: Put A into memory address $FF00+n. */
@@ -1705,6 +1721,7 @@ void rst_20(void)
 {
     push(CPU.reg.pc);
     CPU.reg.pc = 0x0020;
+    PROF_CALL(CPU.reg.pc, CPU.reg.sp);
 }
 
 /* 0xe8: Add n to Stack Pointer (SP). */
@@ -1748,6 +1765,7 @@ void rst_28(void)
 {
     push(CPU.reg.pc);
     CPU.reg.pc = 0x0028;
+    PROF_CALL(CPU.reg.pc, CPU.reg.sp);
 }
 
 /* 0xf0: Put memory address $FF00+n into A. */
@@ -1795,6 +1813,7 @@ void rst_30(void)
 {
     push(CPU.reg.pc);
     CPU.reg.pc = 0x0030;
+    PROF_CALL(CPU.reg.pc, CPU.reg.sp);
 }
 
 /* 0xf8: Put SP + n effective address into HL. */
@@ -1846,4 +1865,5 @@ void rst_38(void)
 {
     push(CPU.reg.pc);
     CPU.reg.pc = 0x0038;
+    PROF_CALL(CPU.reg.pc, CPU.reg.sp);
 }
@@ -0,0 +1,388 @@
+#include "debugger.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cpu.h"
+#include "mmu.h"
+
+#define DEBUGGER_LINE_MAX 256
+
+typedef struct {
+    uint8_t breakpoints[0x10000 / 8]; /* One bit per address. */
+    unsigned int nbreakpoints;
+    uint8_t watch[0x10000]; /* DEBUGGER_WATCH_ flags per address. */
+    unsigned int nwatch;
+    /* Watchpoints per page, for each flag. */
+    unsigned int page_reads[MMU_PAGES];
+    unsigned int page_writes[MMU_PAGES];
+    bool stopped;
+    bool stop_request;  /* Stop before the next instruction. */
+    bool resumed;       /* Don't stop on the breakpoint just resumed from. */
+    unsigned int steps; /* Instructions left to step, 0 to run. */
+    bool next;          /* Stop on return to next_pc. */
+    uint16_t next_pc;
+    uint16_t next_sp;
+    char reason[64];
+    /* Console input read past the last command. */
+    char input[DEBUGGER_LINE_MAX - 1];
+    size_t input_len;
+} debugger_t;
+
+extern cpu_t CPU;
+
+atomic_bool debugger_armed;
+static debugger_t DBG;
+/* Set by debugger_stop(), from any thread. */
+static atomic_bool debugger_interrupted;
+
+static void debugger_arm(void)
+{
+    bool armed = DBG.nbreakpoints || DBG.nwatch || DBG.stop_request ||
+                 DBG.steps || DBG.next || DBG.stopped;
+    atomic_store(&debugger_armed, armed);
+    /* A debugger_stop() may have raced with the store. */
+    if (!armed && atomic_load(&debugger_interrupted))
+        atomic_store(&debugger_armed, true);
+}
+
+/* Turn a debugger_stop() into a stop request, dropped when stopped. */
+static void debugger_take_stop(void)
+{
+    if (atomic_load_explicit(&debugger_interrupted, memory_order_relaxed) &&
+        atomic_exchange(&debugger_interrupted, false) && !DBG.stopped)
+        DBG.stop_request = true;
+}
+
+static void debugger_print_pc(void)
+{
+    char instr[64];
+    cpu_print_instr(instr, mmu_read_byte_dma(CPU.reg.pc));
+    printf("0x%04x: %s\n", CPU.reg.pc, instr);
+}
+
+static void debugger_print_regs(void)
+{
+    printf("AF:0x%04x BC:0x%04x DE:0x%04x HL:0x%04x SP:0x%04x PC:0x%04x\n",
+           CPU.reg.af, CPU.reg.bc, CPU.reg.de, CPU.reg.hl, CPU.reg.sp,
+           CPU.reg.pc);
+    printf("Flags: %c%c%c%c%s\n", CPU.reg.f & FLAG_Z ? 'Z' : '-',
+           CPU.reg.f & FLAG_N ? 'N' : '-', CPU.reg.f & FLAG_H ? 'H' : '-',
+           CPU.reg.f & FLAG_C ? 'C' : '-', CPU.halt ? " halted" : "");
+}
+
+bool debugger_break(void)
+{
+    const char *reason = NULL;
+    uint16_t pc = CPU.reg.pc;
+    debugger_take_stop();
+    bool resumed = DBG.resumed;
+    DBG.resumed = false;
+    if (DBG.stop_request) {
+        reason = DBG.reason[0] ? DBG.reason : "break";
+    } else if (!resumed &&
+               (DBG.breakpoints[pc >> 3] >> (pc & 7) & 1)) {
+        reason = "breakpoint";
+    } else if (DBG.next && pc == DBG.next_pc && CPU.reg.sp >= DBG.next_sp) {
+        reason = "next";
+    } else if (DBG.steps && --DBG.steps == 0) {
+        /* Stop after this instruction: one more check. */
+        DBG.stop_request = true;
+        snprintf(DBG.reason, sizeof(DBG.reason), "step");
+        return false;
+    }
+    if (reason == NULL)
+        return false;
+    printf("Stopped (%s) at ", reason);
+    debugger_print_pc();
+    DBG.stopped = true;
+    DBG.stop_request = false;
+    DBG.reason[0] = '\0';
+    DBG.steps = 0;
+    DBG.next = false;
+    debugger_arm();
+    return true;
+}
+
+static void debugger_watch_hit(uint16_t addr, const char *access,
+                               uint8_t value)
+{
+    snprintf(DBG.reason, sizeof(DBG.reason), "%s 0x%04x = 0x%02x at 0x%04x",
+             access, addr, value, CPU.last_pc);
+    DBG.stop_request = true;
+    atomic_store(&debugger_armed, true);
+}
+
+void debugger_watch_read(uint16_t addr)
+{
+    if (DBG.watch[addr] & DEBUGGER_WATCH_READ)
+        debugger_watch_hit(addr, "read", mmu_read_byte_dma(addr));
+}
+
+void debugger_watch_write(uint16_t addr, uint8_t value)
+{
+    if (DBG.watch[addr] & DEBUGGER_WATCH_WRITE)
+        debugger_watch_hit(addr, "write", value);
+}
+
+void debugger_stop(void)
+{
+    atomic_store(&debugger_interrupted, true);
+    atomic_store(&debugger_armed, true);
+}
+
+bool debugger_poll(void)
+{
+    /* Stop requests are taken here too: the CPU does not run while halted
+     * or paused. */
+    debugger_take_stop();
+    if (DBG.stop_request && !DBG.stopped)
+        debugger_break();
+    return DBG.stopped;
+}
+
+bool debugger_stopped(void)
+{
+    return DBG.stopped;
+}
+
+void debugger_continue(unsigned int steps)
+{
+    DBG.stopped = false;
+    DBG.resumed = true;
+    DBG.steps = steps;
+    debugger_arm();
+}
+
+/* CALL nn, CALL cc,nn and RST n return to the next instruction. */
+static unsigned int debugger_call_length(uint8_t opcode)
+{
+    if (opcode == 0xcd || (opcode & 0xe7) == 0xc4)
+        return 3;
+    if ((opcode & 0xc7) == 0xc7)
+        return 1;
+    return 0;
+}
+
+void debugger_next(void)
+{
+    unsigned int len = debugger_call_length(mmu_read_byte_dma(CPU.reg.pc));
+    if (len == 0) {
+        debugger_continue(1);
+        return;
+    }
+    DBG.next = true;
+    DBG.next_pc = (uint16_t)(CPU.reg.pc + len);
+    DBG.next_sp = CPU.reg.sp;
+    debugger_continue(0);
+}
+
+void debugger_set_breakpoint(uint16_t addr, bool set)
+{
+    uint8_t bit = (uint8_t)(1 << (addr & 7));
+    if (set == debugger_has_breakpoint(addr))
+        return;
+    DBG.breakpoints[addr >> 3] ^= bit;
+    if (set)
+        DBG.nbreakpoints++;
+    else
+        DBG.nbreakpoints--;
+    debugger_arm();
+}
+
+bool debugger_has_breakpoint(uint16_t addr)
+{
+    return DBG.breakpoints[addr >> 3] >> (addr & 7) & 1;
+}
+
+void debugger_set_watchpoint(uint16_t addr, uint8_t flags)
+{
+    unsigned int page = addr >> MMU_PAGE_SHIFT;
+    uint8_t old = DBG.watch[addr];
+    if (old == flags)
+        return;
+    DBG.page_reads[page] -= old & DEBUGGER_WATCH_READ ? 1 : 0;
+    DBG.page_writes[page] -= old & DEBUGGER_WATCH_WRITE ? 1 : 0;
+    DBG.page_reads[page] += flags & DEBUGGER_WATCH_READ ? 1 : 0;
+    DBG.page_writes[page] += flags & DEBUGGER_WATCH_WRITE ? 1 : 0;
+    if (old == 0)
+        DBG.nwatch++;
+    else if (flags == 0)
+        DBG.nwatch--;
+    DBG.watch[addr] = flags;
+    mmu_watch_page(page,
+                   (DBG.page_reads[page] ? MMU_WATCH_READ : 0) |
+                       (DBG.page_writes[page] ? MMU_WATCH_WRITE : 0));
+    debugger_arm();
+}
+
+void debugger_clear(void)
+{
+    for (unsigned int addr = 0; addr < 0x10000; ++addr) {
+        debugger_set_breakpoint((uint16_t)addr, false);
+        debugger_set_watchpoint((uint16_t)addr, 0);
+    }
+}
+
+static void debugger_list(void)
+{
+    for (unsigned int addr = 0; addr < 0x10000; ++addr) {
+        if (debugger_has_breakpoint((uint16_t)addr))
+            printf("breakpoint 0x%04x\n", addr);
+        if (DBG.watch[addr])
+            printf("watchpoint 0x%04x %s%s\n", addr,
+                   DBG.watch[addr] & DEBUGGER_WATCH_READ ? "r" : "",
+                   DBG.watch[addr] & DEBUGGER_WATCH_WRITE ? "w" : "");
+    }
+}
+
+static void debugger_examine(uint16_t addr, unsigned int len)
+{
+    for (unsigned int i = 0; i < len; ++i) {
+        if (i % 16 == 0)
+            printf("%s0x%04x:", i ? "\n" : "", (uint16_t)(addr + i));
+        printf(" %02x", mmu_read_byte_dma((uint16_t)(addr + i)));
+    }
+    printf("\n");
+}
+
+static void debugger_help(void)
+{
+    printf("Commands, numbers in hex:\n"
+           "  c\t\t\tContinue\n"
+           "  s [count]\t\tStep instructions\n"
+           "  n\t\t\tStep over calls\n"
+           "  b <addr>\t\tSet a breakpoint\n"
+           "  db <addr>\t\tDelete a breakpoint\n"
+           "  w <addr> [r|w|rw]\tWatch memory accesses (default w)\n"
+           "  dw <addr>\t\tDelete a watchpoint\n"
+           "  l\t\t\tList breakpoints and watchpoints\n"
+           "  r\t\t\tShow registers\n"
+           "  x <addr> [len]\tExamine memory\n"
+           "  set <addr> <val>\tWrite memory\n"
+           "  q\t\t\tQuit\n");
+}
+
+/* Parse a hex number, return -1 if missing or invalid. */
+static long debugger_number(const char *s, long max)
+{
+    if (s == NULL)
+        return -1;
+    char *end;
+    errno = 0;
+    long val = strtol(s, &end, 16);
+    if (errno || *end || end == s || val < 0 || val > max)
+        return -1;
+    return val;
+}
+
+int debugger_command(const char *line)
+{
+    char buf[DEBUGGER_LINE_MAX];
+    snprintf(buf, sizeof(buf), "%s", line);
+    char *save;
+    char *cmd = strtok_r(buf, " \t\n", &save);
+    char *arg1 = strtok_r(NULL, " \t\n", &save);
+    char *arg2 = strtok_r(NULL, " \t\n", &save);
+    long addr = debugger_number(arg1, 0xffff);
+    if (cmd == NULL) {
+        return 0;
+    } else if (strcmp(cmd, "c") == 0) {
+        debugger_continue(0);
+    } else if (strcmp(cmd, "s") == 0) {
+        long steps = arg1 ? debugger_number(arg1, 0xffffff) : 1;
+        if (steps > 0)
+            debugger_continue((unsigned int)steps);
+        else
+            printf("Invalid count\n");
+    } else if (strcmp(cmd, "n") == 0) {
+        debugger_next();
+    } else if (strcmp(cmd, "r") == 0) {
+        debugger_print_regs();
+        debugger_print_pc();
+    } else if (strcmp(cmd, "l") == 0) {
+        debugger_list();
+    } else if (strcmp(cmd, "q") == 0) {
+        return -1;
+    } else if (strcmp(cmd, "h") == 0 || strcmp(cmd, "help") == 0) {
+        debugger_help();
+    } else if (addr < 0) {
+        printf("Unknown command or missing address, h for help\n");
+    } else if (strcmp(cmd, "b") == 0 || strcmp(cmd, "db") == 0) {
+        debugger_set_breakpoint((uint16_t)addr, cmd[0] == 'b');
+    } else if (strcmp(cmd, "w") == 0) {
+        uint8_t flags = 0;
+        const char *mode = arg2 ? arg2 : "w";
+        if (strchr(mode, 'r'))
+            flags |= DEBUGGER_WATCH_READ;
+        if (strchr(mode, 'w'))
+            flags |= DEBUGGER_WATCH_WRITE;
+        debugger_set_watchpoint((uint16_t)addr, flags);
+    } else if (strcmp(cmd, "dw") == 0) {
+        debugger_set_watchpoint((uint16_t)addr, 0);
+    } else if (strcmp(cmd, "x") == 0) {
+        long len = arg2 ? debugger_number(arg2, 0x10000) : 16;
+        debugger_examine((uint16_t)addr, len > 0 ? (unsigned int)len : 16);
+    } else if (strcmp(cmd, "set") == 0) {
+        long val = debugger_number(arg2, 0xff);
+        if (val < 0)
+            printf("Invalid value\n");
+        else
+            mmu_write_byte_debug((uint16_t)addr, (uint8_t)val);
+    } else {
+        printf("Unknown command, h for help\n");
+    }
+    return 0;
+}
+
+/* Take the next line of console input, cut when longer than the buffer.
+ * Returns false when no complete line was read yet. */
+static bool debugger_take_line(char *line)
+{
+    char *end = memchr(DBG.input, '\n', DBG.input_len);
+    if (end == NULL && DBG.input_len < sizeof(DBG.input))
+        return false;
+    size_t len = end ? (size_t)(end - DBG.input) + 1 : DBG.input_len;
+    memcpy(line, DBG.input, len);
+    line[len] = '\0';
+    DBG.input_len -= len;
+    memmove(DBG.input, &DBG.input[len], DBG.input_len);
+    return true;
+}
+
+int debugger_console(int timeout_ms)
+{
+    static bool prompt = true;
+    if (prompt) {
+        printf("(gusgb) ");
+        fflush(stdout);
+        prompt = false;
+    }
+    /* stdin is read directly: stdio would buffer commands that arrived
+     * together where poll() cannot see them. */
+    char line[DEBUGGER_LINE_MAX];
+    if (!debugger_take_line(line)) {
+        struct pollfd pfd = {.fd = STDIN_FILENO, .events = POLLIN};
+        if (poll(&pfd, 1, timeout_ms) <= 0)
+            return 0;
+        ssize_t len = read(STDIN_FILENO, &DBG.input[DBG.input_len],
+                           sizeof(DBG.input) - DBG.input_len);
+        if (len < 0 && errno == EINTR)
+            return 0;
+        if (len <= 0) {
+            /* End of input: run what is left of a last unterminated
+             * line first. */
+            if (DBG.input_len == 0)
+                return -1;
+            DBG.input[DBG.input_len++] = '\n';
+        } else {
+            DBG.input_len += (size_t)len;
+        }
+        if (!debugger_take_line(line))
+            return 0;
+    }
+    prompt = true;
+    return debugger_command(line);
+}
@@ -0,0 +1,60 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Debugger: PC breakpoints, memory watchpoints and stepping, driven from a
+ * command console on stdin while the emulation is stopped.
+ *
+ * debugger_armed is set with breakpoints or watchpoints set, a stop or step
+ * pending, or while stopped. The emulation loop tests it once per
+ * instruction and only runs cpu_debug_cycle() while it is set, so the
+ * debugger costs nothing else otherwise. Watched pages are taken out of the
+ * MMU page tables, watchpoints are checked on the slow path only. */
+
+#define DEBUGGER_WATCH_READ (1 << 0)
+#define DEBUGGER_WATCH_WRITE (1 << 1)
+
+extern atomic_bool debugger_armed;
+
+/* A stop from another thread is seen on the next test, no ordering is
+ * needed. */
+static inline bool debugger_is_armed(void)
+{
+    return atomic_load_explicit(&debugger_armed, memory_order_relaxed);
+}
+
+/* Called by the emulation loop while armed: returns true while stopped. */
+bool debugger_poll(void);
+/* Called by cpu_debug_cycle() before each instruction: returns true to stop
+ * before executing it. */
+bool debugger_break(void);
+/* Called by the MMU on a CPU access to a watched page. */
+void debugger_watch_read(uint16_t addr);
+void debugger_watch_write(uint16_t addr, uint8_t value);
+
+/* Stop before the next instruction, from any thread. */
+void debugger_stop(void);
+bool debugger_stopped(void);
+/* Resume, stopping again after steps instructions if not 0. */
+void debugger_continue(unsigned int steps);
+/* Resume until the instruction after the current one, stepping over calls
+ * and RSTs. */
+void debugger_next(void);
+
+void debugger_set_breakpoint(uint16_t addr, bool set);
+bool debugger_has_breakpoint(uint16_t addr);
+/* Watch addr for the DEBUGGER_WATCH_ flags, 0 to remove. */
+void debugger_set_watchpoint(uint16_t addr, uint8_t flags);
+/* Remove every breakpoint and watchpoint. */
+void debugger_clear(void);
+
+/* Run a console command line. Returns -1 on quit, else 0. */
+int debugger_command(const char *line);
+/* While stopped: run a command from stdin if one arrives within timeout_ms.
+ * Returns -1 on quit or end of input, else 0. */
+int debugger_console(int timeout_ms);
+
+#endif /* DEBUGGER_H */
@@ -0,0 +1,74 @@
+#include "doctor.h"
+#include <stdio.h>
+#include "cpu.h"
+#include "gpu.h"
+#include "mmu.h"
+
+extern cpu_t CPU;
+
+static FILE *doctor_log;
+
+/* Append name and val as uppercase hex, faster than printf on every
+ * instruction. */
+static char *doctor_put(char *p, const char *name, unsigned int val,
+                        int digits)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    while (*name)
+        *p++ = *name++;
+    for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4)
+        *p++ = hex[(val >> shift) & 0xf];
+    return p;
+}
+
+void doctor_format(char line[DOCTOR_LINE_LEN + 1])
+{
+    uint16_t pc = CPU.reg.pc;
+    char *p = line;
+    p = doctor_put(p, "A:", CPU.reg.a, 2);
+    p = doctor_put(p, " F:", CPU.reg.f, 2);
+    p = doctor_put(p, " B:", CPU.reg.b, 2);
+    p = doctor_put(p, " C:", CPU.reg.c, 2);
+    p = doctor_put(p, " D:", CPU.reg.d, 2);
+    p = doctor_put(p, " E:", CPU.reg.e, 2);
+    p = doctor_put(p, " H:", CPU.reg.h, 2);
+    p = doctor_put(p, " L:", CPU.reg.l, 2);
+    p = doctor_put(p, " SP:", CPU.reg.sp, 4);
+    p = doctor_put(p, " PC:", pc, 4);
+    p = doctor_put(p, " PCMEM:", mmu_read_byte_dma(pc), 2);
+    for (uint16_t i = 1; i < 4; ++i)
+        p = doctor_put(p, ",", mmu_read_byte_dma((uint16_t)(pc + i)), 2);
+    *p = '\0';
+}
+
+static void doctor_log_line(void)
+{
+    char line[DOCTOR_LINE_LEN + 1];
+    doctor_format(line);
+    line[DOCTOR_LINE_LEN] = '\n';
+    fwrite(line, 1, sizeof(line), doctor_log);
+}
+
+int doctor_log_open(const char *path)
+{
+    doctor_log = fopen(path, "w");
+    if (doctor_log == NULL) {
+        perror(path);
+        return -1;
+    }
+    /* Logs reach hundreds of millions of lines. */
+    setvbuf(doctor_log, NULL, _IOFBF, 1 << 20);
+    gpu_stub_ly(true);
+    cpu_set_instr_cb(doctor_log_line);
+    return 0;
+}
+
+void doctor_log_close(void)
+{
+    if (doctor_log == NULL)
+        return;
+    cpu_set_instr_cb(NULL);
+    gpu_stub_ly(false);
+    fclose(doctor_log);
+    doctor_log = NULL;
+}
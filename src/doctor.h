@@ -0,0 +1,21 @@
+#ifndef DOCTOR_H
+#define DOCTOR_H
+
+#include <stddef.h>
+
+/**
+ * Gameboy Doctor CPU trace lines, one per instruction before it executes:
+ * A:01 F:B0 B:00 C:13 D:00 E:D8 H:01 L:4D SP:FFFE PC:0100 PCMEM:00,C3,13,02
+ * Reference: https://github.com/robert/gameboy-doctor
+ */
+
+/* Line length without the newline. */
+#define DOCTOR_LINE_LEN 73
+
+/* Write the line of the current CPU state to line, NUL terminated. */
+void doctor_format(char line[DOCTOR_LINE_LEN + 1]);
+/* Log every instruction to path, with LY stubbed to 0x90. */
+int doctor_log_open(const char *path);
+void doctor_log_close(void);
+
+#endif /* DOCTOR_H */
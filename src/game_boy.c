@@ -2,9 +2,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "apu.h"
+#include "capture.h"
+#include "cartridge/cart.h"
+#include "clock.h"
 #include "cpu.h"
+#include "debugger.h"
+#include "doctor.h"
+#include "gdb.h"
 #include "gpu.h"
 #include "keys.h"
+#include "link/socket.h"
+#include "movie.h"
+#include "profile.h"
+#include "serial.h"
+#include "trace.h"
+#include "viewer.h"
 
 typedef struct {
     int width;
@@ -12,6 +24,11 @@ typedef struct {
     bool running;
     bool paused;
     SDL_Window *window;
+    serial_link_t *link;
+    const char *stacks_path; /* Sampled guest call stacks output. */
+    bool debugger;           /* G breaks into the debugger console. */
+    bool gdb;                /* GDB server running. */
+    bool viewer;             /* VRAM viewer window, or dump on exit. */
 } game_boy_t;
 
 static game_boy_t GB;
@@ -20,28 +37,28 @@ static void gb_key_press(uint8_t key)
 {
     switch (key) {
         case SDL_SCANCODE_A:
-            key_press(KEY_A);
+            movie_key(KEY_A, true);
             break;
         case SDL_SCANCODE_S:
-            key_press(KEY_B);
+            movie_key(KEY_B, true);
             break;
         case SDL_SCANCODE_RETURN:
-            key_press(KEY_START);
+            movie_key(KEY_START, true);
             break;
         case SDL_SCANCODE_LSHIFT:
-            key_press(KEY_SELECT);
+            movie_key(KEY_SELECT, true);
             break;
         case SDL_SCANCODE_UP:
-            key_press(KEY_UP);
+            movie_key(KEY_UP, true);
             break;
         case SDL_SCANCODE_DOWN:
-            key_press(KEY_DOWN);
+            movie_key(KEY_DOWN, true);
             break;
         case SDL_SCANCODE_LEFT:
-            key_press(KEY_LEFT);
+            movie_key(KEY_LEFT, true);
             break;
         case SDL_SCANCODE_RIGHT:
-            key_press(KEY_RIGHT);
+            movie_key(KEY_RIGHT, true);
             break;
         case SDL_SCANCODE_P:
             /* Pause emulation. */
@@ -51,6 +68,27 @@ static void gb_key_press(uint8_t key)
             /* Debug CPU. */
             cpu_dump();
             break;
+        case SDL_SCANCODE_G:
+            /* Break into the debugger console. */
+            if (GB.debugger)
+                debugger_stop();
+            break;
+        case SDL_SCANCODE_T:
+            /* Dump the execution trace. */
+            if (trace_dump(TRACE_PATH) == 0)
+                printf("Execution trace written to: %s\n", TRACE_PATH);
+            break;
+        case SDL_SCANCODE_V:
+            /* Dump the VRAM viewer. */
+            if (viewer_dump(VIEWER_PATH) == 0)
+                printf("VRAM viewer written to: %s\n", VIEWER_PATH);
+            break;
+#ifdef PROFILE
+        case SDL_SCANCODE_I:
+            /* Dump the guest opcode profile. */
+            prof_dump(stdout);
+            break;
+#endif
         case SDL_SCANCODE_Q:
         case SDL_SCANCODE_ESCAPE:
             /* Quit. */
@@ -65,35 +103,35 @@ static void gb_key_release(uint8_t key)
 {
     switch (key) {
         case SDL_SCANCODE_A:
-            key_release(KEY_A);
+            movie_key(KEY_A, false);
             break;
         case SDL_SCANCODE_S:
-            key_release(KEY_B);
+            movie_key(KEY_B, false);
             break;
         case SDL_SCANCODE_RETURN:
-            key_release(KEY_START);
+            movie_key(KEY_START, false);
             break;
         case SDL_SCANCODE_LSHIFT:
-            key_release(KEY_SELECT);
+            movie_key(KEY_SELECT, false);
             break;
         case SDL_SCANCODE_UP:
-            key_release(KEY_UP);
+            movie_key(KEY_UP, false);
             break;
         case SDL_SCANCODE_DOWN:
-            key_release(KEY_DOWN);
+            movie_key(KEY_DOWN, false);
             break;
         case SDL_SCANCODE_LEFT:
-            key_release(KEY_LEFT);
+            movie_key(KEY_LEFT, false);
             break;
         case SDL_SCANCODE_RIGHT:
-            key_release(KEY_RIGHT);
+            movie_key(KEY_RIGHT, false);
             break;
         default:
             break;
     }
 }
 
-static void handle_events(void)
+static void poll_events(void)
 {
     SDL_Event e;
     while (SDL_PollEvent(&e)) {
@@ -104,6 +142,16 @@ static void handle_events(void)
             case SDL_KEYUP:
                 gb_key_release(e.key.keysym.scancode);
                 break;
+            case SDL_WINDOWEVENT:
+                /* With the viewer open, SDL_QUIT only comes once both
+                 * windows are closed. */
+                if (e.window.event != SDL_WINDOWEVENT_CLOSE)
+                    break;
+                if (e.window.windowID == viewer_window_id())
+                    viewer_close();
+                else
+                    GB.running = false;
+                break;
             case SDL_QUIT:
                 GB.running = false;
                 break;
@@ -111,6 +159,30 @@ static void handle_events(void)
     }
 }
 
+static void handle_events(void)
+{
+    capture_frame((const uint32_t *)gpu_get_framebuffer());
+    viewer_frame();
+    movie_frame();
+    if (GB.window == NULL) {
+        /* Headless playback ends with the movie. */
+        if (movie_done())
+            GB.running = false;
+        return;
+    }
+    poll_events();
+}
+
+/* While paused: show the last frame and take input. Emulated time stands
+ * still, so the frame callback does not run and movies, captures and the
+ * viewer see no frame. */
+static void gb_pause_frame(void)
+{
+    gpu_present();
+    if (GB.window)
+        poll_events();
+}
+
 static SDL_Window *sdl_init(const char *name, int width, int height)
 {
     /* Initialize SDL. */
@@ -130,44 +202,162 @@ static SDL_Window *sdl_init(const char *name, int width, int height)
                             SDL_WINDOW_SHOWN);
 }
 
-int gb_init(int scale, const char *rom_path)
+int gb_init(const gb_config_t *config, const char *rom_path)
 {
-    GB.width = GB_SCREEN_WIDTH * scale;
-    GB.height = GB_SCREEN_HEIGHT * scale;
+    GB.width = GB_SCREEN_WIDTH * config->scale;
+    GB.height = GB_SCREEN_HEIGHT * config->scale;
     GB.running = true;
     GB.paused = false;
     /* Initialize SDL. */
-    GB.window = sdl_init("gusgb", GB.width, GB.height);
-    if (GB.window == NULL) {
-        fprintf(stderr, "ERROR: %s\n", SDL_GetError());
-        return -1;
+    if (!config->headless) {
+        GB.window = sdl_init("gusgb", GB.width, GB.height);
+        if (GB.window == NULL) {
+            fprintf(stderr, "ERROR: %s\n", SDL_GetError());
+            return -1;
+        }
     }
+    if (config->movie_play && movie_play(config->movie_play) < 0)
+        return -1;
+    if (config->movie_record && movie_record(config->movie_record) < 0)
+        return -1;
     /* Initialize emulation. */
+    if (!config->no_trace) {
+        trace_enable(true);
+        trace_catch_crash(TRACE_PATH);
+    }
+#ifdef PROFILE
+    prof_opcodes = true;
+#endif
+    cart_set_ram_sync(config->ram_sync);
+    cart_set_rtc_clock(config->rtc_emu ? clock_get_rtc_ticks : NULL);
     if (cpu_init(rom_path) < 0) {
         fprintf(stderr, "ERROR: Could not load rom: %s\n", rom_path);
         return -1;
     }
+    if (config->doctor_path && doctor_log_open(config->doctor_path) < 0)
+        return -1;
+#ifdef PROFILE
+    GB.stacks_path = config->stacks_path;
+    if (GB.stacks_path &&
+        prof_stacks_start(config->period, config->sym_path) < 0)
+        return -1;
+#endif
     if (gpu_init(GB.window, handle_events) < 0) {
         fprintf(stderr, "ERROR: %s\n", SDL_GetError());
     }
+    gpu_set_frame_skip(config->frame_skip);
+    gpu_set_renderer(config->ppu_fifo ? GPU_RENDERER_FIFO
+                                      : GPU_RENDERER_SCANLINE);
+    if (config->upscale &&
+        gpu_set_scaler(config->filter, (unsigned int)config->scale) < 0)
+        return -1;
+    /* Captures are upscaled like the window, at 1x without a filter. */
+    if (config->capture_path &&
+        capture_open(config->capture_path,
+                     capture_format(config->capture_path),
+                     config->upscale ? config->filter : SCALE_NEAREST,
+                     config->upscale ? (unsigned int)config->scale : 1) < 0)
+        return -1;
+    GB.debugger = config->debugger;
+    if (config->debugger) {
+        printf("Debugger: G breaks into the console, h for help\n");
+        debugger_stop();
+    }
+    GB.viewer = config->viewer;
+    if (GB.viewer && GB.window && viewer_open() < 0)
+        return -1;
+    if (config->gdb_addr) {
+        if (gdb_open(config->gdb_addr) < 0)
+            return -1;
+        GB.gdb = true;
+    }
+    if (config->link_path) {
+        GB.link = link_socket_open(config->link_path);
+        if (GB.link == NULL)
+            return -1;
+        serial_set_link(GB.link);
+    }
     return 0;
 }
 
 void gb_finish(void)
 {
+    if (GB.window == NULL) {
+        printf("Frames: %llu cycles: %llu frame hash: %016llx\n",
+               (unsigned long long)movie_get_frame(),
+               (unsigned long long)clock_get_cycles(),
+               (unsigned long long)gpu_frame_hash());
+    }
+    if (GB.viewer && GB.window == NULL && viewer_dump(VIEWER_PATH) == 0)
+        printf("VRAM viewer written to: %s\n", VIEWER_PATH);
+    viewer_close();
+    if (capture_enabled()) {
+        capture_close();
+        printf("Capture: %llu frames written, %llu dropped\n",
+               (unsigned long long)capture_written(),
+               (unsigned long long)capture_dropped());
+    }
+    if (GB.gdb)
+        gdb_close();
+    movie_close();
+    doctor_log_close();
+    if (GB.link) {
+        serial_set_link(NULL);
+        GB.link->close(GB.link);
+    }
+#ifdef PROFILE
+    prof_dump(stdout);
+    if (GB.stacks_path && prof_stacks_write(GB.stacks_path) == 0)
+        printf("Guest call stacks written to: %s\n", GB.stacks_path);
+#endif
     gpu_finish();
     cpu_finish();
     SDL_DestroyWindow(GB.window);
     SDL_Quit();
 }
 
-void gb_main(void)
+/* While the debugger is armed: run with its checks, or wait for commands
+ * while stopped. */
+static void gb_debug_step(void)
 {
-    while (GB.running) {
-        if (GB.paused) {
-            gpu_render_framebuffer();
-        } else {
-            cpu_emulate_cycle();
-        }
+    if (!debugger_poll()) {
+        if (GB.paused)
+            gb_pause_frame();
+        else
+            cpu_debug_cycle();
+        return;
     }
+    /* Resuming from the debugger runs the emulation. */
+    GB.paused = false;
+    /* Keep the window responsive while waiting for commands. */
+    int ret = gdb_wait(16);
+    if (ret > 0)
+        ret = debugger_console(16);
+    if (ret < 0)
+        GB.running = false;
+    if (GB.window)
+        poll_events();
+}
+
+void gb_step(void)
+{
+    /* Stops, steps, breakpoints and GDB requests all arm the debugger: a
+     * single test while running freely. */
+    if (debugger_is_armed())
+        gb_debug_step();
+    else if (GB.paused)
+        gb_pause_frame();
+    else
+        cpu_emulate_cycle();
+}
+
+void gb_pause(bool paused)
+{
+    GB.paused = paused;
+}
+
+void gb_main(void)
+{
+    while (GB.running)
+        gb_step();
 }
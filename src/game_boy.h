@@ -3,9 +3,38 @@
 
 #include <SDL.h>
 #include <stdbool.h>
+#include "scale.h"
 
-int gb_init(int scale, const char *rom_path);
+typedef struct {
+    int scale;                /* Window scale. */
+    bool ram_sync;            /* Map battery RAM to the save file, sync it. */
+    bool rtc_emu;             /* Drive the cartridge RTC from emulated time. */
+    const char *link_path;    /* Link cable socket, or NULL. */
+    const char *movie_record; /* Input movie to record, or NULL. */
+    const char *movie_play;   /* Input movie to replay, or NULL. */
+    bool headless;            /* No window nor audio, run at full speed. */
+    bool no_trace;            /* Disable the execution trace ring. */
+    const char *doctor_path;  /* Gameboy Doctor CPU log output, or NULL. */
+    const char *stacks_path;  /* Sampled guest call stacks output, or NULL. */
+    const char *sym_path;     /* Symbols naming the stack frames, or NULL. */
+    unsigned int period;      /* Cycles between stack samples, 0: default. */
+    unsigned int frame_skip;  /* Frames left unrendered after each shown. */
+    bool ppu_fifo;            /* Render with the accurate pixel FIFO. */
+    bool upscale;             /* Upscale on the CPU with filter. */
+    scale_filter_e filter;
+    const char *capture_path; /* Video capture output, or NULL. */
+    bool debugger;            /* Start stopped in the debugger console. */
+    const char *gdb_addr;     /* GDB server port or Unix socket, or NULL. */
+    bool viewer;              /* VRAM viewer window, headless: dump on exit. */
+} gb_config_t;
+
+int gb_init(const gb_config_t *config, const char *rom_path);
 void gb_finish(void);
 void gb_main(void);
+/* One iteration of gb_main(): an instruction, or a wait while paused or
+ * stopped in the debugger. */
+void gb_step(void);
+/* Pause or resume the emulation, like the P key. */
+void gb_pause(bool paused);
 
 #endif /* GAME_BOY_H */
@@ -0,0 +1,612 @@
+#include "gdb.h"
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "cpu.h"
+#include "debugger.h"
+#include "mmu.h"
+
+#define GDB_PACKET_MAX 0x1000
+/* Registers in the order of GDB's z80 target, SM83 having its first six:
+ * AF BC DE HL SP PC. IX IY AF' BC' DE' HL' and IR read as unavailable. */
+#define GDB_REGS 6
+#define GDB_Z80_REGS 13
+
+#define GDB_SIGINT 2
+#define GDB_SIGTRAP 5
+
+/* Wake-up bytes for the server thread. */
+#define GDB_WAKE_HALTED 'h' /* The emulation handed over. */
+#define GDB_WAKE_QUIT 'q'
+
+/* gdb_next() result when the emulation halted. */
+#define GDB_HALTED 0x100
+
+typedef struct {
+    int listen_fd;
+    int fd; /* Connection to GDB, or -1. */
+    char *path; /* Unix socket to remove, or NULL. */
+    int wake[2];
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    /* Under lock. */
+    bool attached;
+    bool halted; /* The server owns the CPU and memory. */
+    int resume;  /* Instructions to step, 0 to continue, -1 when none. */
+    bool kill;
+    bool quit;
+    /* Breakpoint change for the emulation thread to make, the debugger
+     * being its own. */
+    bool bp_pending;
+    bool bp_set;
+    uint16_t bp_addr;
+    /* Server thread only. */
+    uint8_t rx[GDB_PACKET_MAX];
+    size_t rx_pos;
+    size_t rx_len;
+    char packet[GDB_PACKET_MAX];
+    char reply[GDB_PACKET_MAX + 4]; /* Last reply, resent on a NAK. */
+    size_t reply_len;
+    int signal; /* Of the last stop. */
+} gdb_t;
+
+extern cpu_t CPU;
+
+static gdb_t GDB = {.listen_fd = -1,
+                    .fd = -1,
+                    .wake = {-1, -1},
+                    .resume = -1,
+                    .lock = PTHREAD_MUTEX_INITIALIZER,
+                    .cond = PTHREAD_COND_INITIALIZER};
+
+static uint16_t *const gdb_regs[GDB_REGS] = {
+    &CPU.reg.af, &CPU.reg.bc, &CPU.reg.de,
+    &CPU.reg.hl, &CPU.reg.sp, &CPU.reg.pc,
+};
+
+static bool gdb_quitting(void)
+{
+    pthread_mutex_lock(&GDB.lock);
+    bool quit = GDB.quit;
+    pthread_mutex_unlock(&GDB.lock);
+    return quit;
+}
+
+static bool gdb_halted(void)
+{
+    pthread_mutex_lock(&GDB.lock);
+    bool halted = GDB.halted;
+    pthread_mutex_unlock(&GDB.lock);
+    return halted;
+}
+
+/* Wait for the next byte from GDB or, with stop set, for the emulation to
+ * halt. Only interrupts are taken from GDB while the emulation runs.
+ * Returns the byte, GDB_HALTED, or -1 when the connection or the server
+ * ends. */
+static int gdb_next(bool stop)
+{
+    for (;;) {
+        bool buffered = GDB.rx_pos < GDB.rx_len;
+        if (buffered && (!stop || GDB.rx[GDB.rx_pos] == 0x03))
+            return GDB.rx[GDB.rx_pos++];
+        struct pollfd pfd[2] = {{.fd = GDB.wake[0], .events = POLLIN},
+                                {.fd = GDB.fd, .events = POLLIN}};
+        if (poll(pfd, buffered ? 1 : 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll gdb");
+            return -1;
+        }
+        char wake;
+        if ((pfd[0].revents & POLLIN) && read(GDB.wake[0], &wake, 1) == 1) {
+            if (wake == GDB_WAKE_QUIT)
+                return -1;
+            /* Stale when GDB resumed in between. */
+            if (stop && gdb_halted())
+                return GDB_HALTED;
+        }
+        if (!buffered && pfd[1].revents) {
+            ssize_t len = recv(GDB.fd, GDB.rx, sizeof(GDB.rx), 0);
+            if (len <= 0)
+                return -1;
+            GDB.rx_pos = 0;
+            GDB.rx_len = (size_t)len;
+        }
+    }
+}
+
+static int gdb_send(const char *data, size_t len)
+{
+    if (send(GDB.fd, data, len, MSG_NOSIGNAL) != (ssize_t)len)
+        return -1;
+    return 0;
+}
+
+static int gdb_reply(const char *data)
+{
+    uint8_t sum = 0;
+    for (const char *c = data; *c; ++c)
+        sum = (uint8_t)(sum + *c);
+    int len = snprintf(GDB.reply, sizeof(GDB.reply), "$%s#%02x", data, sum);
+    GDB.reply_len = (size_t)len;
+    return gdb_send(GDB.reply, GDB.reply_len);
+}
+
+/* Receive a packet into GDB.packet and acknowledge it. Returns -1 when the
+ * connection ends. */
+static int gdb_recv(void)
+{
+    for (;;) {
+        int c;
+        do {
+            c = gdb_next(false);
+            if (c < 0)
+                return -1;
+            if (c == '-' && gdb_send(GDB.reply, GDB.reply_len) < 0)
+                return -1;
+        } while (c != '$');
+        size_t len = 0;
+        uint8_t sum = 0;
+        while ((c = gdb_next(false)) != '#') {
+            if (c < 0)
+                return -1;
+            if (len < sizeof(GDB.packet) - 1)
+                GDB.packet[len++] = (char)c;
+            sum = (uint8_t)(sum + c);
+        }
+        GDB.packet[len] = '\0';
+        char check[3] = {0};
+        for (int i = 0; i < 2; ++i) {
+            if ((c = gdb_next(false)) < 0)
+                return -1;
+            check[i] = (char)c;
+        }
+        bool ok = strtoul(check, NULL, 16) == sum;
+        /* A packet is still served when GDB already hung up, a kill. */
+        gdb_send(ok ? "+" : "-", 1);
+        if (ok)
+            return 0;
+    }
+}
+
+static void gdb_hex16(char *out, uint16_t val)
+{
+    /* Target byte order: little endian. */
+    sprintf(out, "%02x%02x", val & 0xff, val >> 8);
+}
+
+static uint16_t gdb_parse16(const char *hex)
+{
+    char buf[5] = {0};
+    memcpy(buf, hex, 4);
+    unsigned long val = strtoul(buf, NULL, 16);
+    return (uint16_t)((val >> 8) | (val & 0xff) << 8);
+}
+
+static void gdb_set_reg(unsigned int n, uint16_t val)
+{
+    /* The low nibble of F is always 0. */
+    *gdb_regs[n] = n == 0 ? val & 0xfff0 : val;
+}
+
+static int gdb_read_regs(void)
+{
+    char out[GDB_REGS * 4 + 1];
+    for (unsigned int i = 0; i < GDB_REGS; ++i)
+        gdb_hex16(&out[i * 4], *gdb_regs[i]);
+    return gdb_reply(out);
+}
+
+static int gdb_write_regs(const char *hex)
+{
+    if (strlen(hex) < GDB_REGS * 4)
+        return gdb_reply("E01");
+    for (unsigned int i = 0; i < GDB_REGS; ++i)
+        gdb_set_reg(i, gdb_parse16(&hex[i * 4]));
+    return gdb_reply("OK");
+}
+
+static int gdb_read_reg(const char *args)
+{
+    unsigned long n = strtoul(args, NULL, 16);
+    char out[5];
+    if (n >= GDB_Z80_REGS)
+        return gdb_reply("E01");
+    if (n >= GDB_REGS)
+        return gdb_reply("xxxx");
+    gdb_hex16(out, *gdb_regs[n]);
+    return gdb_reply(out);
+}
+
+static int gdb_write_reg(const char *args)
+{
+    char *end;
+    unsigned long n = strtoul(args, &end, 16);
+    if (*end != '=' || strlen(end + 1) < 4 || n >= GDB_Z80_REGS)
+        return gdb_reply("E01");
+    if (n < GDB_REGS)
+        gdb_set_reg((unsigned int)n, gdb_parse16(end + 1));
+    return gdb_reply("OK");
+}
+
+/* Parse "addr,len", return a pointer past it or NULL. */
+static const char *gdb_parse_range(const char *args, uint16_t *addr,
+                                   size_t *len)
+{
+    char *end;
+    *addr = (uint16_t)strtoul(args, &end, 16);
+    if (*end != ',')
+        return NULL;
+    *len = strtoul(end + 1, &end, 16);
+    return end;
+}
+
+static int gdb_read_mem(const char *args)
+{
+    uint16_t addr;
+    size_t len;
+    char out[GDB_PACKET_MAX];
+    if (gdb_parse_range(args, &addr, &len) == NULL ||
+        len * 2 >= sizeof(out))
+        return gdb_reply("E01");
+    for (size_t i = 0; i < len; ++i)
+        sprintf(&out[i * 2], "%02x", mmu_read_byte_dma((uint16_t)(addr + i)));
+    out[len * 2] = '\0';
+    return gdb_reply(out);
+}
+
+static int gdb_write_mem(const char *args)
+{
+    uint16_t addr;
+    size_t len;
+    const char *hex = gdb_parse_range(args, &addr, &len);
+    if (hex == NULL || *hex != ':' || strlen(hex + 1) < len * 2)
+        return gdb_reply("E01");
+    for (size_t i = 0; i < len; ++i) {
+        char byte[3] = {hex[1 + i * 2], hex[2 + i * 2], '\0'};
+        mmu_write_byte_debug((uint16_t)(addr + i),
+                             (uint8_t)strtoul(byte, NULL, 16));
+    }
+    return gdb_reply("OK");
+}
+
+/* Z/z type,addr,kind: software and hardware breakpoints are the same. */
+static int gdb_breakpoint(const char *args, bool set)
+{
+    char *end;
+    unsigned long type = strtoul(args, &end, 16);
+    if (type > 1)
+        return gdb_reply("");
+    if (*end != ',')
+        return gdb_reply("E01");
+    /* Wait for gdb_wait() to make the change, so that it is in place once
+     * GDB resumes. */
+    pthread_mutex_lock(&GDB.lock);
+    GDB.bp_addr = (uint16_t)strtoul(end + 1, NULL, 16);
+    GDB.bp_set = set;
+    GDB.bp_pending = true;
+    pthread_cond_broadcast(&GDB.cond);
+    while (GDB.bp_pending && !GDB.quit)
+        pthread_cond_wait(&GDB.cond, &GDB.lock);
+    pthread_mutex_unlock(&GDB.lock);
+    return gdb_reply("OK");
+}
+
+static int gdb_query(const char *query)
+{
+    if (strncmp(query, "Supported", 9) == 0) {
+        char out[32];
+        snprintf(out, sizeof(out), "PacketSize=%x", GDB_PACKET_MAX);
+        return gdb_reply(out);
+    }
+    if (strcmp(query, "Attached") == 0)
+        return gdb_reply("1");
+    return gdb_reply("");
+}
+
+/* Let the emulation run, stepping steps instructions if not 0. */
+static void gdb_resume(int steps)
+{
+    pthread_mutex_lock(&GDB.lock);
+    GDB.resume = steps;
+    GDB.halted = false;
+    pthread_cond_broadcast(&GDB.cond);
+    pthread_mutex_unlock(&GDB.lock);
+}
+
+/* Wait for the emulation to halt, passing on interrupts from GDB. */
+static int gdb_wait_halted(void)
+{
+    int c;
+    GDB.signal = GDB_SIGTRAP;
+    while ((c = gdb_next(true)) != GDB_HALTED) {
+        if (c < 0)
+            return -1;
+        if (c == 0x03) {
+            GDB.signal = GDB_SIGINT;
+            debugger_stop();
+        }
+    }
+    return 0;
+}
+
+static int gdb_reply_stop(void)
+{
+    char out[4];
+    snprintf(out, sizeof(out), "S%02x", GDB.signal);
+    return gdb_reply(out);
+}
+
+/* Serve a packet while the emulation is halted. Returns 1 after resuming,
+ * -1 to end the session, else 0. */
+static int gdb_handle(void)
+{
+    const char *args = &GDB.packet[1];
+    int ret;
+    switch (GDB.packet[0]) {
+        case '?':
+            ret = gdb_reply_stop();
+            break;
+        case 'g':
+            ret = gdb_read_regs();
+            break;
+        case 'G':
+            ret = gdb_write_regs(args);
+            break;
+        case 'p':
+            ret = gdb_read_reg(args);
+            break;
+        case 'P':
+            ret = gdb_write_reg(args);
+            break;
+        case 'm':
+            ret = gdb_read_mem(args);
+            break;
+        case 'M':
+            ret = gdb_write_mem(args);
+            break;
+        case 'Z':
+        case 'z':
+            ret = gdb_breakpoint(args, GDB.packet[0] == 'Z');
+            break;
+        case 'c':
+        case 's':
+            /* Optionally from a new address. */
+            if (*args)
+                CPU.reg.pc = (uint16_t)strtoul(args, NULL, 16);
+            gdb_resume(GDB.packet[0] == 's');
+            return 1;
+        case 'D':
+            gdb_reply("OK");
+            return -1;
+        case 'k':
+            pthread_mutex_lock(&GDB.lock);
+            GDB.kill = true;
+            pthread_cond_broadcast(&GDB.cond);
+            pthread_mutex_unlock(&GDB.lock);
+            return -1;
+        case 'H':
+            ret = gdb_reply("OK");
+            break;
+        case 'q':
+            ret = gdb_query(args);
+            break;
+        default:
+            ret = gdb_reply("");
+            break;
+    }
+    return ret;
+}
+
+static void gdb_session(void)
+{
+    GDB.rx_pos = GDB.rx_len = 0;
+    GDB.reply_len = 0;
+    pthread_mutex_lock(&GDB.lock);
+    GDB.attached = true;
+    pthread_mutex_unlock(&GDB.lock);
+    /* Stop on attach, GDB's first packets wait for it. */
+    debugger_stop();
+    int ret = gdb_wait_halted();
+    GDB.signal = GDB_SIGTRAP;
+    while (ret == 0 && gdb_recv() == 0) {
+        ret = gdb_handle();
+        if (ret > 0)
+            ret = gdb_wait_halted() < 0 ? -1 : gdb_reply_stop();
+    }
+    if (gdb_quitting())
+        gdb_reply("W00");
+    pthread_mutex_lock(&GDB.lock);
+    GDB.attached = false;
+    /* Detached: run on. */
+    if (GDB.halted) {
+        GDB.halted = false;
+        GDB.resume = 0;
+        pthread_cond_broadcast(&GDB.cond);
+    }
+    pthread_mutex_unlock(&GDB.lock);
+    close(GDB.fd);
+    GDB.fd = -1;
+    printf("GDB detached\n");
+}
+
+static void *gdb_serve(void *arg)
+{
+    (void)arg;
+    while (!gdb_quitting()) {
+        struct pollfd pfd[2] = {{.fd = GDB.wake[0], .events = POLLIN},
+                                {.fd = GDB.listen_fd, .events = POLLIN}};
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll gdb");
+            break;
+        }
+        char wake;
+        if ((pfd[0].revents & POLLIN) && read(GDB.wake[0], &wake, 1) == 1 &&
+            wake == GDB_WAKE_QUIT)
+            break;
+        if (!(pfd[1].revents & POLLIN))
+            continue;
+        GDB.fd = accept(GDB.listen_fd, NULL, NULL);
+        if (GDB.fd < 0) {
+            perror("accept gdb");
+            continue;
+        }
+        printf("GDB attached\n");
+        gdb_session();
+    }
+    return NULL;
+}
+
+static int gdb_listen_tcp(unsigned long port)
+{
+    struct sockaddr_in addr = {.sin_family = AF_INET,
+                               .sin_port = htons((uint16_t)port),
+                               .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    if (port == 0 || port > 0xffff) {
+        fprintf(stderr, "ERROR: invalid GDB port: %lu\n", port);
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    if (fd < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0 ||
+        bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("listen gdb");
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int gdb_listen_unix(const char *path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "ERROR: GDB socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    /* Stale socket of a previous run. */
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("listen gdb");
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    GDB.path = strdup(path);
+    return fd;
+}
+
+int gdb_open(const char *addr)
+{
+    char *end;
+    unsigned long port = strtoul(addr, &end, 10);
+    if (*addr && *end == '\0')
+        GDB.listen_fd = gdb_listen_tcp(port);
+    else
+        GDB.listen_fd = gdb_listen_unix(addr);
+    if (GDB.listen_fd < 0)
+        return -1;
+    if (listen(GDB.listen_fd, 1) < 0 || pipe(GDB.wake) < 0) {
+        perror("listen gdb");
+        gdb_close();
+        return -1;
+    }
+    GDB.attached = GDB.halted = GDB.kill = GDB.quit = false;
+    GDB.bp_pending = false;
+    GDB.resume = -1;
+    if (pthread_create(&GDB.thread, NULL, gdb_serve, NULL) != 0) {
+        fprintf(stderr, "ERROR: could not start the GDB server\n");
+        gdb_close();
+        return -1;
+    }
+    printf("GDB server listening on %s\n", addr);
+    return 0;
+}
+
+void gdb_close(void)
+{
+    if (GDB.wake[1] >= 0 && GDB.listen_fd >= 0) {
+        pthread_mutex_lock(&GDB.lock);
+        bool running = !GDB.quit;
+        GDB.quit = true;
+        /* The server may wait on a breakpoint change. */
+        pthread_cond_broadcast(&GDB.cond);
+        pthread_mutex_unlock(&GDB.lock);
+        char wake = GDB_WAKE_QUIT;
+        if (running && write(GDB.wake[1], &wake, 1) == 1)
+            pthread_join(GDB.thread, NULL);
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (GDB.wake[i] >= 0)
+            close(GDB.wake[i]);
+        GDB.wake[i] = -1;
+    }
+    if (GDB.listen_fd >= 0)
+        close(GDB.listen_fd);
+    GDB.listen_fd = -1;
+    if (GDB.path) {
+        unlink(GDB.path);
+        free(GDB.path);
+        GDB.path = NULL;
+    }
+    /* A resume left by a detach must not reach a later stop. */
+    GDB.resume = -1;
+}
+
+int gdb_wait(int timeout_ms)
+{
+    pthread_mutex_lock(&GDB.lock);
+    /* Resumed by a detach: run on even though GDB left. */
+    if (!GDB.attached && GDB.resume < 0) {
+        pthread_mutex_unlock(&GDB.lock);
+        return 1;
+    }
+    if (!GDB.halted && GDB.resume < 0) {
+        /* A new stop: hand the CPU and memory over to the server. */
+        GDB.halted = true;
+        char wake = GDB_WAKE_HALTED;
+        if (write(GDB.wake[1], &wake, 1) != 1)
+            perror("write gdb");
+    }
+    if (GDB.halted && !GDB.kill && !GDB.bp_pending) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += timeout_ms * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&GDB.cond, &GDB.lock, &deadline);
+    }
+    if (GDB.bp_pending) {
+        debugger_set_breakpoint(GDB.bp_addr, GDB.bp_set);
+        GDB.bp_pending = false;
+        pthread_cond_broadcast(&GDB.cond);
+    }
+    bool kill = GDB.kill;
+    int steps = GDB.resume;
+    GDB.resume = -1;
+    pthread_mutex_unlock(&GDB.lock);
+    if (kill)
+        return -1;
+    if (steps >= 0)
+        debugger_continue((unsigned int)steps);
+    return 0;
+}
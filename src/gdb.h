@@ -0,0 +1,25 @@
+#ifndef GDB_H
+#define GDB_H
+
+/* GDB remote serial protocol server, on a localhost TCP port or a Unix
+ * socket, run by its own thread.
+ *
+ * The server stops the emulation with debugger_stop() on attach and on
+ * interrupts. Once the debugger stopped, the emulation thread calls
+ * gdb_wait() before the console: while GDB is attached, the server thread
+ * then owns the CPU and memory until GDB resumes, so it serves register
+ * and memory packets directly, without advancing the clock. The debugger
+ * state stays the emulation thread's: gdb_wait() makes the breakpoint
+ * changes GDB asks for. */
+
+/* Listen on addr: a port number, or a Unix socket path. */
+int gdb_open(const char *addr);
+void gdb_close(void);
+
+/* Emulation thread, while the debugger is stopped: hand over to the server,
+ * make its breakpoint changes and resume when GDB asks for it within
+ * timeout_ms. Returns 1 when GDB is not attached, the console is in charge
+ * then, -1 when GDB kills the program, else 0. */
+int gdb_wait(int timeout_ms);
+
+#endif /* GDB_H */
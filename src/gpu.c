@@ -5,19 +5,46 @@
 #include <string.h>
 #include "cartridge/cart.h"
 #include "debug.h"
+#include "gpu_fifo.h"
 #include "interrupt.h"
 #include "mmu.h"
+#include "profile.h"
 
 typedef struct {
     render_callback_t cb;
     SDL_Renderer *ren;
     SDL_Texture *tex;
+    /* CPU upscaling, off when factor is 0. */
+    scale_filter_e filter;
+    unsigned int factor;
+    uint32_t *scaled;
 } gpu_gl_t;
 
-static gpu_t GPU;
+/* Frame tracking, updated at VBlank. */
+typedef struct {
+    bool enable;
+    bool changed; /* Some line differs from the previous frame. */
+    uint64_t hash;
+    uint64_t line_hash[GB_SCREEN_HEIGHT];
+    /* Changed lines, bit (line & 63) of word (line >> 6). */
+    uint64_t dirty[(GB_SCREEN_HEIGHT + 63) / 64];
+} gpu_frames_t;
+
+/* OAM DMA copies one byte every 4 clocks, at any speed. */
+#define OAM_DMA_CLOCKS (0xa0 * 4)
+
+gpu_t GPU;
 static gpu_gl_t GPU_GL;
-
-static const color_t g_palette[4] = {
+/* LY reads 0x90, survives resets. */
+static bool ly_stub;
+/* Frames left unrendered after each rendered one, survives resets. */
+static unsigned int frame_skip;
+/* Renderer of the next lines, survives resets. */
+static gpu_renderer_e renderer;
+/* Per frame hashing, enabled across resets. */
+static gpu_frames_t FRAMES;
+
+const color_t g_palette[4] = {
 #if (SDL_BYTE_ORDER == SDL_BIG_ENDIAN)
     {SDL_ALPHA_OPAQUE, 0xe0, 0xf8, 0xd0}, /* off */
     {SDL_ALPHA_OPAQUE, 0x88, 0xc0, 0x70}, /* 33% on */
@@ -36,6 +63,9 @@ int gpu_init(SDL_Window *win, render_callback_t cb)
     gpu_reset();
     assert(cb != NULL);
     GPU_GL.cb = cb;
+    /* Headless: frames are only passed to the callback. */
+    if (win == NULL)
+        return 0;
     /* Create SDL renderer */
     GPU_GL.ren = SDL_CreateRenderer(
         win, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
@@ -52,8 +82,13 @@ int gpu_init(SDL_Window *win, render_callback_t cb)
 
 void gpu_finish(void)
 {
+    if (GPU_GL.ren == NULL)
+        return;
     SDL_DestroyTexture(GPU_GL.tex);
     SDL_DestroyRenderer(GPU_GL.ren);
+    free(GPU_GL.scaled);
+    GPU_GL.scaled = NULL;
+    GPU_GL.factor = 0;
 }
 
 void gpu_reset(void)
@@ -66,7 +101,9 @@ void gpu_reset(void)
         gpu_write_obp0(0xFF);
         gpu_write_obp1(0xFF);
     }
+    GPU.hdma_len = 0xff;
     GPU.speed = 1;
+    GPU.hblank_clocks = 200;
 }
 
 /* Check if the CPU can access VRAM. */
@@ -137,7 +174,9 @@ static void gpu_set_cgb_bg_palette(uint8_t value)
     uint8_t reg = GPU.cgb_bg_pal_idx;
     unsigned int i = reg & 0x3f;
     GPU.cgb_bg_pal_data[i] = value;
-    uint16_t c = (GPU.cgb_bg_pal_data[i + 1] << 8) | value;
+    /* Colors are little endian pairs, either byte may change. */
+    const uint8_t *pair = &GPU.cgb_bg_pal_data[i & ~1u];
+    uint16_t c = (uint16_t)(pair[1] << 8 | pair[0]);
     color_t color;
     color.a = SDL_ALPHA_OPAQUE;
     color.r = (c & 0x1f) * 255 / 31;
@@ -153,7 +192,9 @@ static void gpu_set_cgb_sprite_palette(uint8_t value)
     uint8_t reg = GPU.cgb_sprite_pal_idx;
     unsigned int i = reg & 0x3f;
     GPU.cgb_sprite_pal_data[i] = value;
-    uint16_t c = (GPU.cgb_sprite_pal_data[i + 1] << 8) | value;
+    /* Colors are little endian pairs, either byte may change. */
+    const uint8_t *pair = &GPU.cgb_sprite_pal_data[i & ~1u];
+    uint16_t c = (uint16_t)(pair[1] << 8 | pair[0]);
     color_t color;
     color.a = SDL_ALPHA_OPAQUE;
     color.r = (c & 0x1f) * 255 / 31;
@@ -192,6 +233,7 @@ void gpu_write_lcdc(uint8_t val)
         gpu_clear_screen();
         GPU.modeclock = 0;
         GPU.scanline = 0;
+        GPU.window_line = 0;
         GPU.mode_flag = GPU_MODE_OAM;
     }
     GPU.lcd_control = val;
@@ -230,9 +272,60 @@ void gpu_write_scx(uint8_t val)
 
 uint8_t gpu_read_ly(void)
 {
+    if (ly_stub)
+        return 0x90;
     return GPU.scanline;
 }
 
+void gpu_stub_ly(bool enable)
+{
+    ly_stub = enable;
+}
+
+void gpu_set_frame_skip(unsigned int skip)
+{
+    frame_skip = skip;
+}
+
+void gpu_set_renderer(gpu_renderer_e new_renderer)
+{
+    renderer = new_renderer;
+}
+
+int gpu_set_scaler(scale_filter_e filter, unsigned int factor)
+{
+    if (GPU_GL.ren == NULL)
+        return 0;
+    factor = scale_factor(filter, factor);
+    uint32_t *scaled = malloc(sizeof(uint32_t) * GB_SCREEN_WIDTH *
+                              GB_SCREEN_HEIGHT * factor * factor);
+    if (scaled == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    SDL_Texture *tex = SDL_CreateTexture(
+        GPU_GL.ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+        (int)(GB_SCREEN_WIDTH * factor), (int)(GB_SCREEN_HEIGHT * factor));
+    if (tex == NULL) {
+        fprintf(stderr, "ERROR: SDL_CreateTexture: %s\n", SDL_GetError());
+        free(scaled);
+        return -1;
+    }
+    SDL_DestroyTexture(GPU_GL.tex);
+    free(GPU_GL.scaled);
+    GPU_GL.tex = tex;
+    GPU_GL.scaled = scaled;
+    GPU_GL.filter = filter;
+    GPU_GL.factor = factor;
+    return 0;
+}
+
+/* Skipped frames run the full mode/LY/STAT timing but draw no pixels. */
+static bool gpu_frame_skipped(void)
+{
+    return frame_skip && GPU.frame % (frame_skip + 1);
+}
+
 uint8_t gpu_read_lyc(void)
 {
     return GPU.lyc;
@@ -251,11 +344,28 @@ uint8_t gpu_read_dma(void)
 void gpu_write_dma(uint8_t val)
 {
     GPU.dma = val;
-    for (int i = 0; i < GB_SCREEN_WIDTH; i++) {
-        uint16_t dma_addr = (uint16_t)((val << 8) + i);
-        uint8_t v = mmu_read_byte_dma(dma_addr);
-        GPU.oam[i] = v;
+    GPU.dma_clock = OAM_DMA_CLOCKS;
+}
+
+/* Read the byte being transferred by the OAM DMA, as seen by the CPU on a
+ * conflicting read. */
+uint8_t gpu_read_dma_bus(uint16_t addr)
+{
+    if (addr >= 0xfe00)
+        return 0xff;
+    unsigned int pos = (OAM_DMA_CLOCKS - GPU.dma_clock) / 4;
+    return mmu_read_byte_dma((uint16_t)((GPU.dma << 8) + pos));
+}
+
+/* Copy the whole OAM when the transfer completes. */
+static void gpu_oam_dma_step(uint32_t clock_step)
+{
+    if (clock_step < GPU.dma_clock) {
+        GPU.dma_clock -= clock_step;
+        return;
     }
+    GPU.dma_clock = 0;
+    mmu_read_block((uint16_t)(GPU.dma << 8), GPU.oam, sizeof(GPU.oam));
 }
 
 uint8_t gpu_read_bgp(void)
@@ -321,6 +431,87 @@ void gpu_write_vbk(uint8_t val)
     GPU.vram_bank = val & 1;
 }
 
+/* Copy 16 byte blocks from the VRAM DMA source to the current VRAM bank. The
+ * CPU is halted for 32 clocks per block, twice as many in double speed.
+ * The destination does not wrap: the DMA ends at the end of VRAM. Returns
+ * false when it did. */
+static bool gpu_hdma_copy(unsigned int blocks)
+{
+    uint8_t *vram = GPU.vram[GPU.vram_bank];
+    unsigned int len = blocks * 16;
+    if (len > 0x2000u - GPU.hdma_dst)
+        len = 0x2000u - GPU.hdma_dst;
+    mmu_read_block(GPU.hdma_src, &vram[GPU.hdma_dst], len);
+    GPU.hdma_src = (uint16_t)(GPU.hdma_src + len);
+    GPU.hdma_dst = (uint16_t)(GPU.hdma_dst + len);
+    GPU.dma_stall += len / 16 * 32 * GPU.speed;
+    if (GPU.hdma_dst < 0x2000)
+        return true;
+    GPU.hdma_dst = 0;
+    GPU.hdma_len = 0xff;
+    GPU.hdma_active = false;
+    return false;
+}
+
+/* Copy one block of an H-Blank DMA. */
+static void gpu_hdma_hblank(void)
+{
+    if (!gpu_hdma_copy(1))
+        return;
+    if (GPU.hdma_len == 0) {
+        GPU.hdma_len = 0xff;
+        GPU.hdma_active = false;
+    } else {
+        GPU.hdma_len--;
+    }
+}
+
+uint8_t gpu_read_hdma5(void)
+{
+    return GPU.hdma_len;
+}
+
+void gpu_write_hdma1(uint8_t val)
+{
+    GPU.hdma_src = (uint16_t)((val << 8) | (GPU.hdma_src & 0x00f0));
+}
+
+void gpu_write_hdma2(uint8_t val)
+{
+    GPU.hdma_src = (uint16_t)((GPU.hdma_src & 0xff00) | (val & 0xf0));
+}
+
+void gpu_write_hdma3(uint8_t val)
+{
+    GPU.hdma_dst = (uint16_t)(((val & 0x1f) << 8) | (GPU.hdma_dst & 0x00f0));
+}
+
+void gpu_write_hdma4(uint8_t val)
+{
+    GPU.hdma_dst = (uint16_t)((GPU.hdma_dst & 0x1f00) | (val & 0xf0));
+}
+
+void gpu_write_hdma5(uint8_t val)
+{
+    if (GPU.hdma_active && !(val & 0x80)) {
+        /* Stop the H-Blank DMA, the remaining length stays readable. */
+        GPU.hdma_active = false;
+        GPU.hdma_len |= 0x80;
+    } else if (val & 0x80) {
+        /* H-Blank DMA: 16 bytes at each H-Blank. */
+        GPU.hdma_len = val & 0x7f;
+        GPU.hdma_active = true;
+        /* With the LCD off there is no H-Blank, the first block is copied
+         * right away. */
+        if (!GPU.lcd_enable)
+            gpu_hdma_hblank();
+    } else {
+        /* General purpose DMA: everything at once. */
+        gpu_hdma_copy((val & 0x7f) + 1u);
+        GPU.hdma_len = 0xff;
+    }
+}
+
 uint8_t gpu_read_bgpi(void)
 {
     return GPU.cgb_bg_pal_idx;
@@ -361,10 +552,21 @@ void gpu_write_obpd(uint8_t val)
     gpu_set_cgb_sprite_palette(val);
 }
 
-static uint32_t gpu_get_tile_id(int mapoffs, int map_row, int map_col)
+/* Line pixels are flipped horizontally by reversing the bits of the tile
+ * data. */
+#define R2(n) n, n + 2 * 64, n + 1 * 64, n + 3 * 64
+#define R4(n) R2(n), R2(n + 2 * 16), R2(n + 1 * 16), R2(n + 3 * 16)
+#define R6(n) R4(n), R4(n + 2 * 4), R4(n + 1 * 4), R4(n + 3 * 4)
+static const uint8_t bit_reverse[256] = {R6(0), R6(2), R6(1), R6(3)};
+
+/* Set in the background color numbers of a line when the CGB attribute
+ * gives the background priority over sprites. */
+#define BG_PRIORITY 0x04
+
+static uint32_t gpu_get_tile_id(uint32_t map_offs)
 {
     /* Unsigned tile region: 0 to 255. */
-    uint32_t tile_id = GPU.vram[GPU.vram_bank][mapoffs + map_row + map_col];
+    uint32_t tile_id = GPU.vram[0][map_offs];
     if (!GPU.bg_tile_set) {
         /* Signed tile region: -128 to 127. */
         /* Adjust id for the 0x8000 - 0x97ff range. */
@@ -378,27 +580,25 @@ typedef struct {
     uint8_t data_l;
 } tile_line_t;
 
-static tile_line_t get_tile_line(uint32_t tile_id, int y)
+/* Line y of a background tile, taken from the bank and flipped as the CGB
+ * attributes say. */
+static tile_line_t get_tile_line(uint32_t tile_id, int y, cgb_bg_attr_t attr)
 {
     tile_line_t tile_line;
+    if (attr.vflip)
+        y = 7 - (y & 7);
     /* Get tile index for the correct line of the tile. Each tile is 16 bytes
      * long. */
     uint32_t tile_line_id = (tile_id << 4) + (uint32_t)((y & 7) << 1);
     /* Get tile line data: Each tile line takes 2 bytes. */
-    tile_line.data_l = GPU.vram[GPU.vram_bank][tile_line_id];
-    tile_line.data_h = GPU.vram[GPU.vram_bank][tile_line_id + 1];
-    return tile_line;
-}
-
-static uint32_t get_tile_palette(uint32_t tile_id)
-{
-    if (cart_is_cgb()) {
-        cgb_bg_attr_t bg_attr;
-        bg_attr.attributes = GPU.vram[1][tile_id];
-        return bg_attr.pal_number;
-    } else {
-        return 0;
+    const uint8_t *data = &GPU.vram[attr.vram_bank][tile_line_id];
+    tile_line.data_l = data[0];
+    tile_line.data_h = data[1];
+    if (attr.hflip) {
+        tile_line.data_l = bit_reverse[tile_line.data_l];
+        tile_line.data_h = bit_reverse[tile_line.data_h];
     }
+    return tile_line;
 }
 
 static tile_line_t get_tile_line_sprite(sprite_t *sprite, int sy,
@@ -426,49 +626,64 @@ static uint32_t gpu_get_tile_color(tile_line_t tile_line, int tile_x)
     return color_num;
 }
 
-static void gpu_update_fb_bg(uint8_t *scanline_row)
+/* Draw the screen pixels [screen_x, end) of a line from a tile map, starting
+ * at map pixel (map_x, map_y). */
+static void gpu_draw_map(uint8_t *scanline_row, uint32_t screen_x,
+                         uint32_t end, int mapoffs, uint32_t map_x,
+                         uint32_t map_y)
 {
-    int mapoffs, bg_x, bg_y;
-    /* Get background xy coordinate, and Get map offset relative to vram array.
-     */
-    if (GPU.window_enable && GPU.window_y <= GPU.scanline) {
-        bg_x = 7 - GPU.window_x;
-        bg_y = GPU.scanline - GPU.window_y;
-        mapoffs = (GPU.window_tile_map) ? 0x1c00 : 0x1800;
-    } else {
-        bg_x = GPU.scroll_x;
-        bg_y = (GPU.scanline + GPU.scroll_y) & 0xff;
-        mapoffs = (GPU.bg_tile_map) ? 0x1c00 : 0x1800;
-    }
-    /* Map row offset: (bg_y / 8) * 32. */
-    int map_row = (bg_y >> 3) << 5;
-    uint32_t screen_x = 0;
-    uint32_t pixeloffs = GPU.scanline * GB_SCREEN_WIDTH;
-    while (screen_x < GB_SCREEN_WIDTH) {
-        int map_col = (bg_x >> 3) & 0x1f;
+    /* Map row offset: (map_y / 8) * 32. */
+    uint32_t map_row = (uint32_t)mapoffs + ((map_y >> 3) << 5);
+    color_t *line = &GPU.framebuffer[GPU.scanline * GB_SCREEN_WIDTH];
+    bool cgb = cart_is_cgb();
+    cgb_bg_attr_t attr = {.attributes = 0};
+    while (screen_x < end) {
+        uint32_t map_offs = map_row + ((map_x >> 3) & 0x1f);
         /* Get tile index adjusted for the 0x8000 - 0x97ff range. */
-        uint32_t tile_id = gpu_get_tile_id(mapoffs, map_row, map_col);
-        /* Get tile line data. */
-        tile_line_t tile_line = get_tile_line(tile_id, bg_y);
-        /* Get correct palette. */
-        uint32_t palette_num = get_tile_palette(tile_id);
-        /* Iterate over remaining pixels of the tile. */
-        for (int tile_x = bg_x & 0x7; tile_x < 8; ++tile_x) {
-            if (screen_x >= GB_SCREEN_WIDTH) {
-                return;
-            }
-            /* Get tile color number for coordinate. */
-            uint32_t color_num = gpu_get_tile_color(tile_line, tile_x);
-            scanline_row[screen_x] = (uint8_t)color_num;
-            /* Copy color to frame buffer. */
-            GPU.framebuffer[pixeloffs + screen_x] =
-                GPU.bg_palette[palette_num * 4 + color_num];
-            ++screen_x;
-            ++bg_x;
+        uint32_t tile_id = gpu_get_tile_id(map_offs);
+        /* CGB: the attributes are at the same offset in bank 1. */
+        if (cgb)
+            attr.attributes = GPU.vram[1][map_offs];
+        tile_line_t tile_line = get_tile_line(tile_id, (int)map_y, attr);
+        const color_t *pal = &GPU.bg_palette[attr.pal_number * 4];
+        uint8_t priority = attr.priority ? BG_PRIORITY : 0;
+        /* Remaining pixels of the tile, up to the end of the span. */
+        uint32_t n = 8 - (map_x & 7);
+        if (n > end - screen_x)
+            n = end - screen_x;
+        uint32_t bit = 7 - (map_x & 7);
+        map_x += n;
+        while (n--) {
+            uint32_t color_num = ((tile_line.data_h >> bit) & 1) << 1 |
+                                 ((tile_line.data_l >> bit) & 1);
+            scanline_row[screen_x] = (uint8_t)(color_num | priority);
+            line[screen_x++] = pal[color_num];
+            bit--;
         }
     }
 }
 
+/* Background then window, each pixel of the line drawn once. */
+static void gpu_update_fb_bg(uint8_t *scanline_row)
+{
+    /* The window covers the line from WX - 7 on, once LY reached WY. */
+    uint32_t window_x = GB_SCREEN_WIDTH;
+    if (GPU.window_enable && GPU.window_y <= GPU.scanline &&
+        GPU.window_x < GB_SCREEN_WIDTH + 7)
+        window_x = GPU.window_x > 7 ? GPU.window_x - 7u : 0;
+    gpu_draw_map(scanline_row, 0, window_x,
+                 GPU.bg_tile_map ? 0x1c00 : 0x1800, GPU.scroll_x,
+                 (GPU.scanline + GPU.scroll_y) & 0xff);
+    if (window_x == GB_SCREEN_WIDTH)
+        return;
+    /* The window has its own line counter, it only counts the lines it
+     * was drawn on. WX below 7 shifts it left. */
+    gpu_draw_map(scanline_row, window_x, GB_SCREEN_WIDTH,
+                 GPU.window_tile_map ? 0x1c00 : 0x1800,
+                 GPU.window_x < 7 ? 7u - GPU.window_x : 0,
+                 GPU.window_line++);
+}
+
 static color_t *get_sprite_pal(sprite_t *sprite)
 {
     color_t *pal;
@@ -503,9 +718,11 @@ static void gpu_update_fb_sprite(uint8_t *scanline_row)
                 uint32_t pixeloffs = GPU.scanline * GB_SCREEN_WIDTH + px;
                 /* If pixel is on screen. */
                 if (px >= 0 && px < GB_SCREEN_WIDTH) {
-                    /* Check if pixel is hidden. */
-                    if (GPU.bg_display && sprite.priority == 1 &&
-                        scanline_row[px] != 0)
+                    /* Check if pixel is hidden: background colors 1-3 are
+                     * above it by the sprite or the CGB tile priority. */
+                    uint8_t bg = scanline_row[px];
+                    if (GPU.bg_display && (bg & 3) &&
+                        (sprite.priority || (bg & BG_PRIORITY)))
                         continue;
                     /* Check if sprite is x-flipped. */
                     int tile_x_flip = sprite.xflip ? 7 - tile_x : tile_x;
@@ -526,6 +743,8 @@ static void gpu_update_fb_sprite(uint8_t *scanline_row)
 static void gpu_render_scanline(void)
 {
     uint8_t scanline_row[GB_SCREEN_WIDTH];
+    if (gpu_frame_skipped())
+        return;
     if (cart_is_cgb()) {
         /* In CGB mode when Bit 0 is cleared, the background and window
          * lose their priority. */
@@ -541,14 +760,91 @@ static void gpu_render_scanline(void)
         gpu_update_fb_sprite(scanline_row);
 }
 
-void gpu_render_framebuffer(void)
+__extension__ typedef unsigned __int128 gpu_u128_t;
+
+/* wyhash constants and mixing: a 64x64 -> 128 bit multiply folded to 64. */
+#define HASH_P0 0xa0761d6478bd642full
+#define HASH_P1 0xe7037ed1a0b428dbull
+#define HASH_P2 0x8ebc6af09c88c6e3ull
+
+static uint64_t gpu_hash_mix(uint64_t a, uint64_t b)
+{
+    gpu_u128_t r = (gpu_u128_t)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+/* Hash of a framebuffer line, 16 bytes per multiply. */
+static uint64_t gpu_hash_line(unsigned int line)
+{
+    const uint8_t *p =
+        (const uint8_t *)&GPU.framebuffer[line * GB_SCREEN_WIDTH];
+    uint64_t h = HASH_P0;
+    for (size_t i = 0; i < GB_SCREEN_WIDTH * sizeof(color_t); i += 16) {
+        uint64_t w[2];
+        memcpy(w, p + i, sizeof(w));
+        h += gpu_hash_mix(w[0] ^ h ^ HASH_P1, w[1] ^ HASH_P2);
+    }
+    return h;
+}
+
+static uint64_t gpu_hash_lines(const uint64_t *line_hash)
+{
+    uint64_t h = HASH_P0;
+    for (unsigned int i = 0; i < GB_SCREEN_HEIGHT; ++i)
+        h = gpu_hash_mix(h ^ HASH_P1, line_hash[i] ^ HASH_P2);
+    return h;
+}
+
+/* VBlank: hash the completed frame line by line, mark the changed lines. */
+static void gpu_track_frame(bool rendered)
 {
+    memset(FRAMES.dirty, 0, sizeof(FRAMES.dirty));
+    FRAMES.changed = false;
+    if (!rendered)
+        return;
+    for (unsigned int i = 0; i < GB_SCREEN_HEIGHT; ++i) {
+        uint64_t h = gpu_hash_line(i);
+        if (h != FRAMES.line_hash[i]) {
+            FRAMES.line_hash[i] = h;
+            FRAMES.dirty[i >> 6] |= 1ull << (i & 63);
+            FRAMES.changed = true;
+        }
+    }
+    if (FRAMES.changed)
+        FRAMES.hash = gpu_hash_lines(FRAMES.line_hash);
+}
+
+void gpu_present(void)
+{
+    if (GPU_GL.ren == NULL)
+        return;
     SDL_SetRenderDrawColor(GPU_GL.ren, 0, 0, 0, SDL_ALPHA_OPAQUE);
     SDL_RenderClear(GPU_GL.ren);
-    SDL_UpdateTexture(GPU_GL.tex, NULL, GPU.framebuffer, GB_SCREEN_WIDTH * 4);
+    if (GPU_GL.factor) {
+        scale_frame(GPU_GL.filter, GPU_GL.factor,
+                    (const uint32_t *)GPU.framebuffer, GPU_GL.scaled);
+        SDL_UpdateTexture(GPU_GL.tex, NULL, GPU_GL.scaled,
+                          (int)(GB_SCREEN_WIDTH * 4 * GPU_GL.factor));
+    } else {
+        SDL_UpdateTexture(GPU_GL.tex, NULL, GPU.framebuffer,
+                          GB_SCREEN_WIDTH * 4);
+    }
     SDL_RenderCopy(GPU_GL.ren, GPU_GL.tex, NULL, NULL);
     SDL_RenderPresent(GPU_GL.ren);
+}
+
+/* VBlank: count and track the frame, show it unless skipped. */
+static void gpu_end_frame(void)
+{
+    PROF_ENTER(PROF_FRAME);
+    bool skipped = gpu_frame_skipped();
+    GPU.frame++;
+    if (FRAMES.enable)
+        gpu_track_frame(!skipped);
+    if (!skipped)
+        gpu_present();
     GPU_GL.cb();
+    PROF_ENTER(PROF_GPU);
 }
 
 static void gpu_change_mode(gpu_mode_e new_mode)
@@ -579,6 +875,9 @@ static void gpu_change_mode(gpu_mode_e new_mode)
  */
 void gpu_step(uint32_t clock_step)
 {
+    PROF_ENTER(PROF_GPU);
+    if (GPU.dma_clock)
+        gpu_oam_dma_step(clock_step);
     if (!GPU.lcd_enable)
         return;
     GPU.modeclock += clock_step;
@@ -588,28 +887,44 @@ void gpu_step(uint32_t clock_step)
             if (GPU.modeclock >= 80 * GPU.speed) {
                 GPU.modeclock -= 80 * GPU.speed;
                 gpu_change_mode(GPU_MODE_VRAM);
+                GPU.fifo_line = renderer == GPU_RENDERER_FIFO;
+                if (GPU.fifo_line)
+                    gpu_fifo_start_line(!gpu_frame_skipped());
             }
             break;
         case GPU_MODE_VRAM:
-            /* Mode 3 takes between 169 and 175 clocks. */
-            if (GPU.modeclock >= 172 * GPU.speed) {
+            if (GPU.fifo_line) {
+                /* Mode 3 lasts until the FIFO output the whole line, the
+                 * line keeps its 456 clocks. */
+                unsigned int len = gpu_fifo_draw();
+                if (len == 0)
+                    break;
+                GPU.hblank_clocks = 456 - 80 - len;
+                gpu_change_mode(GPU_MODE_HBLANK);
+                if (GPU.hdma_active)
+                    gpu_hdma_hblank();
+            } else if (GPU.modeclock >= 172 * GPU.speed) {
+                /* Mode 3 takes between 169 and 175 clocks. */
                 GPU.modeclock -= 172 * GPU.speed;
+                GPU.hblank_clocks = 200;
                 gpu_change_mode(GPU_MODE_HBLANK);
                 /* End of scanline. Write a scanline to framebuffer. */
                 gpu_render_scanline();
+                if (GPU.hdma_active)
+                    gpu_hdma_hblank();
             }
             break;
         case GPU_MODE_HBLANK:
             /* Mode 0 takes between 201 and 207 clocks. */
-            if (GPU.modeclock >= 200 * GPU.speed) {
-                GPU.modeclock -= 200 * GPU.speed;
+            if (GPU.modeclock >= GPU.hblank_clocks * GPU.speed) {
+                GPU.modeclock -= GPU.hblank_clocks * GPU.speed;
                 GPU.scanline++;
                 if (GPU.coincidence_int && GPU.scanline == GPU.lyc) {
                     interrupt_raise(INTERRUPTS_LCDSTAT);
                 }
                 if (GPU.scanline == GB_SCREEN_HEIGHT) {
                     gpu_change_mode(GPU_MODE_VBLANK);
-                    gpu_render_framebuffer();
+                    gpu_end_frame();
                 } else {
                     gpu_change_mode(GPU_MODE_OAM);
                 }
@@ -621,6 +936,7 @@ void gpu_step(uint32_t clock_step)
                 GPU.modeclock -= 456 * GPU.speed;
                 if (GPU.scanline > 153) {
                     GPU.scanline = 0;
+                    GPU.window_line = 0;
                     gpu_change_mode(GPU_MODE_OAM);
                 } else {
                     GPU.scanline++;
@@ -635,6 +951,46 @@ void gpu_change_speed(unsigned int speed)
     GPU.speed = speed + 1;
 }
 
+const color_t *gpu_get_framebuffer(void)
+{
+    return GPU.framebuffer;
+}
+
+void gpu_track_frames(bool enable)
+{
+    FRAMES.enable = enable;
+    /* Start with every line dirty. */
+    memset(FRAMES.line_hash, 0, sizeof(FRAMES.line_hash));
+    FRAMES.hash = 0;
+}
+
+uint64_t gpu_frame_hash(void)
+{
+    if (FRAMES.enable)
+        return FRAMES.hash;
+    uint64_t line_hash[GB_SCREEN_HEIGHT];
+    for (unsigned int i = 0; i < GB_SCREEN_HEIGHT; ++i)
+        line_hash[i] = gpu_hash_line(i);
+    return gpu_hash_lines(line_hash);
+}
+
+bool gpu_frame_changed(void)
+{
+    return FRAMES.changed;
+}
+
+bool gpu_line_dirty(unsigned int line)
+{
+    return (FRAMES.dirty[line >> 6] >> (line & 63)) & 1;
+}
+
+unsigned int gpu_take_dma_stall(void)
+{
+    unsigned int stall = GPU.dma_stall;
+    GPU.dma_stall = 0;
+    return stall;
+}
+
 void gpu_dump(void)
 {
     printf("GPU dump:\n");
@@ -654,6 +1010,10 @@ void gpu_dump(void)
     printf("[$ff45] lyc=%hhu\n", GPU.lyc);
     printf("[$ff4a] window_y=%hhu\n", GPU.window_y);
     printf("[$ff4b] window_x=%hhu\n", GPU.window_x);
+    printf("[$ff51] hdma_src=0x%.4x\n", GPU.hdma_src);
+    printf("[$ff53] hdma_dst=0x%.4x\n", 0x8000 + GPU.hdma_dst);
+    printf("[$ff55] hdma_len=0x%.2hhx active=%d\n", GPU.hdma_len,
+           GPU.hdma_active);
     printf("BG palettes:\n");
     for (int i = 0; i < 8; ++i) {
         printf("BG %d: ", i);
@@ -4,6 +4,7 @@
 #include <SDL.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include "scale.h"
 
 #define GB_SCREEN_WIDTH 160
 #define GB_SCREEN_HEIGHT 144
@@ -15,6 +16,11 @@ typedef enum {
     GPU_MODE_VRAM = 3,
 } gpu_mode_e;
 
+typedef enum {
+    GPU_RENDERER_SCANLINE = 0, /* Whole lines at the end of mode 3. */
+    GPU_RENDERER_FIFO = 1,     /* Pixel FIFO, accurate mode 3 length. */
+} gpu_renderer_e;
+
 typedef void (*render_callback_t)(void);
 
 typedef struct {
@@ -73,8 +79,19 @@ typedef struct {
     uint8_t window_y;
     /* 0xff4b (WX): Window X Position minus 7 (R/W) */
     uint8_t window_x;
+    uint8_t window_line; /* Window lines drawn in this frame. */
     /* 0xff4f (VBK): VRAM Bank - CGB only */
     uint8_t vram_bank;
+    /* 0xff51-0xff52 (HDMA1, HDMA2): VRAM DMA Source - CGB only */
+    uint16_t hdma_src;
+    /* 0xff53-0xff54 (HDMA3, HDMA4): VRAM DMA Destination (VRAM offset) - CGB
+     * only */
+    uint16_t hdma_dst;
+    /* 0xff55 (HDMA5): VRAM DMA Length/Mode/Start - CGB only */
+    uint8_t hdma_len;
+    bool hdma_active;   /* H-Blank DMA in progress. */
+    uint32_t dma_stall; /* CPU cycles halted by VRAM DMA. */
+    uint32_t dma_clock; /* Clocks left of the OAM DMA, 0 when idle. */
     /* 0xff68 (BGPI): Background Palette Index - CGB only */
     uint8_t cgb_bg_pal_idx;
     /* 0xff69 (BGPD): Background Palette Data - CGB only */
@@ -90,8 +107,28 @@ typedef struct {
     color_t bg_palette[8 * 4];
     color_t sprite_palette[8 * 4];
     unsigned int speed;
+    unsigned int frame;     /* Frames since reset, skipped ones included. */
+    uint32_t hblank_clocks; /* Mode 0 length of the current line. */
+    bool fifo_line;         /* The pixel FIFO draws the current line. */
 } gpu_t;
 
+extern gpu_t GPU;
+
+#define IS_VRAM_BUS(addr) ((addr) >= 0x8000 && (addr) < 0xa000)
+
+/* Check if the CPU loses a bus access at addr to the OAM DMA. The CPU keeps
+ * HRAM and I/O, and the bus (VRAM or external) the DMA is not reading.
+ * Inline, as the MMU checks every access and the DMA is mostly idle. */
+static inline bool gpu_oam_dma_conflict(uint16_t addr)
+{
+    if (!GPU.dma_clock || addr >= 0xff00)
+        return false;
+    if (addr >= 0xfe00)
+        return true;
+    uint16_t src = (uint16_t)(GPU.dma << 8);
+    return IS_VRAM_BUS(addr) == IS_VRAM_BUS(src);
+}
+
 typedef struct {
     uint8_t y;    /* Y-coordinate minus 16. */
     uint8_t x;    /* X-coordinate minus 8. */
@@ -123,6 +160,8 @@ typedef struct {
     };
 } cgb_bg_attr_t;
 
+/* Init GPU rendering to win, or headless if win is NULL. cb is called after
+ * each frame. */
 int gpu_init(SDL_Window *win, render_callback_t cb);
 void gpu_finish(void);
 void gpu_reset(void);
@@ -132,14 +171,30 @@ uint8_t gpu_read_stat(void);
 uint8_t gpu_read_scy(void);
 uint8_t gpu_read_scx(void);
 uint8_t gpu_read_ly(void);
+/* Make LY always read 0x90, as reference CPU traces expect. */
+void gpu_stub_ly(bool enable);
+/* Render one frame out of skip + 1. Skipped frames keep the exact LCD timing
+ * and interrupts, still reach the frame callback, but leave the framebuffer
+ * as the last rendered frame. */
+void gpu_set_frame_skip(unsigned int skip);
+/* Select the renderer, from the next line on. The scanline renderer is the
+ * default and the fastest, the pixel FIFO handles mid-line raster effects
+ * and the variable mode 3 length. */
+void gpu_set_renderer(gpu_renderer_e renderer);
+/* Upscale frames on the CPU before presenting them, by factor for
+ * SCALE_NEAREST and the filter's own factor otherwise, instead of letting
+ * SDL stretch them. */
+int gpu_set_scaler(scale_filter_e filter, unsigned int factor);
 uint8_t gpu_read_lyc(void);
 uint8_t gpu_read_dma(void);
+uint8_t gpu_read_dma_bus(uint16_t addr);
 uint8_t gpu_read_bgp(void);
 uint8_t gpu_read_obp0(void);
 uint8_t gpu_read_obp1(void);
 uint8_t gpu_read_wy(void);
 uint8_t gpu_read_wx(void);
 uint8_t gpu_read_vbk(void);
+uint8_t gpu_read_hdma5(void);
 uint8_t gpu_read_bgpi(void);
 uint8_t gpu_read_bgpd(void);
 uint8_t gpu_read_obpi(void);
@@ -157,6 +212,11 @@ void gpu_write_obp1(uint8_t val);
 void gpu_write_wy(uint8_t val);
 void gpu_write_wx(uint8_t val);
 void gpu_write_vbk(uint8_t val);
+void gpu_write_hdma1(uint8_t val);
+void gpu_write_hdma2(uint8_t val);
+void gpu_write_hdma3(uint8_t val);
+void gpu_write_hdma4(uint8_t val);
+void gpu_write_hdma5(uint8_t val);
 void gpu_write_bgpi(uint8_t val);
 void gpu_write_bgpd(uint8_t val);
 void gpu_write_obpi(uint8_t val);
@@ -167,8 +227,23 @@ void gpu_write_vram(uint16_t addr, uint8_t val);
 uint8_t gpu_read_oam(uint16_t addr);
 void gpu_write_oam(uint16_t addr, uint8_t val);
 void gpu_step(uint32_t cpu_tick);
-void gpu_render_framebuffer(void);
+/* Show the framebuffer in the window as it is. The frame callback and the
+ * frame count are left alone, they only follow the emulated VBlank. */
+void gpu_present(void);
+const color_t *gpu_get_framebuffer(void);
+/* Hash every completed frame at VBlank and track the lines that changed
+ * since the previous one, for consumers that skip identical frames. */
+void gpu_track_frames(bool enable);
+/* 64 bit hash of the framebuffer: with tracking, of the last completed
+ * frame, else of the framebuffer as it is. */
+uint64_t gpu_frame_hash(void);
+/* With tracking: did the last completed frame differ from the one before,
+ * and which lines. Skipped frames never change. */
+bool gpu_frame_changed(void);
+bool gpu_line_dirty(unsigned int line);
 void gpu_change_speed(unsigned int speed);
+/* Return and clear the CPU cycles the CPU must stay halted for VRAM DMA. */
+unsigned int gpu_take_dma_stall(void);
 void gpu_dump(void);
 
 #endif /* GPU_H */
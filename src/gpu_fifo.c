@@ -0,0 +1,284 @@
+#include "gpu_fifo.h"
+#include <string.h>
+#include "cartridge/cart.h"
+#include "gpu.h"
+
+/* Dots before the first fetch of a line, the tile fetched and thrown away by
+ * the hardware. */
+#define FIFO_START_DOTS 6
+/* Dots the background fetcher needs to fetch a tile, before pushing it. */
+#define FIFO_FETCH_DOTS 6
+#define FIFO_SPRITE_DOTS 6
+#define FIFO_MAX_SPRITES 10
+
+typedef struct {
+    uint8_t color;    /* Color number, 0 is transparent for sprites. */
+    uint8_t palette;  /* Palette number. */
+    uint8_t priority; /* BG: CGB attribute priority, OBJ: behind BG. */
+    uint8_t oam;      /* OBJ: OAM index, the lowest wins on CGB. */
+} fifo_pixel_t;
+
+typedef struct {
+    bool draw;       /* Write pixels to the framebuffer. */
+    unsigned int x;  /* Pixels output on the line. */
+    unsigned int dots;
+    unsigned int stall;   /* Dots the whole pipeline waits, e.g. for OBJ. */
+    unsigned int discard; /* Fine scroll pixels left to drop. */
+    /* Background FIFO, only refilled when empty. */
+    fifo_pixel_t bg[8];
+    unsigned int bg_len;
+    /* Sprite FIFO, slot (obj_head + n) is the pixel n dots ahead. */
+    fifo_pixel_t obj[8];
+    unsigned int obj_head;
+    /* Fetcher. */
+    unsigned int step;
+    unsigned int fetch_x; /* Tile column, relative to the line start. */
+    uint8_t tile;
+    cgb_bg_attr_t attr;
+    uint8_t data_l;
+    uint8_t data_h;
+    /* Window. */
+    bool window;      /* Fetching from the window on this line. */
+    bool wy_hit;      /* LY matched WY during this frame. */
+    /* Sprites on the line, by X then OAM order. */
+    uint8_t sprites[FIFO_MAX_SPRITES];
+    unsigned int nsprites;
+    unsigned int next_sprite;
+    int charged_tile; /* BG tile that already paid the OBJ fetch wait. */
+} gpu_fifo_t;
+
+extern const color_t g_palette[4];
+
+static gpu_fifo_t FIFO;
+
+static const sprite_t *gpu_fifo_sprite(unsigned int i)
+{
+    return &((const sprite_t *)GPU.oam)[FIFO.sprites[i]];
+}
+
+/* Mode 2: select the first 10 sprites on the line. */
+static void gpu_fifo_scan_oam(void)
+{
+    int height = GPU.obj_size ? 16 : 8;
+    FIFO.nsprites = 0;
+    for (uint8_t i = 0; i < 40 && FIFO.nsprites < FIFO_MAX_SPRITES; ++i) {
+        const sprite_t *sprite = &((const sprite_t *)GPU.oam)[i];
+        int y = GPU.scanline - ((int)sprite->y - 16);
+        if (y < 0 || y >= height)
+            continue;
+        /* Insertion sort by X, stable for the OAM order. */
+        unsigned int n = FIFO.nsprites++;
+        while (n > 0 && gpu_fifo_sprite(n - 1)->x > sprite->x) {
+            FIFO.sprites[n] = FIFO.sprites[n - 1];
+            n--;
+        }
+        FIFO.sprites[n] = i;
+    }
+}
+
+void gpu_fifo_start_line(bool draw)
+{
+    if (GPU.scanline == 0)
+        FIFO.wy_hit = false;
+    if (GPU.window_y == GPU.scanline)
+        FIFO.wy_hit = true;
+    FIFO.draw = draw;
+    FIFO.x = 0;
+    FIFO.dots = 0;
+    FIFO.stall = FIFO_START_DOTS;
+    FIFO.discard = GPU.scroll_x & 7;
+    FIFO.bg_len = 0;
+    memset(FIFO.obj, 0, sizeof(FIFO.obj));
+    FIFO.obj_head = 0;
+    FIFO.step = 0;
+    FIFO.fetch_x = 0;
+    FIFO.window = false;
+    FIFO.next_sprite = 0;
+    FIFO.charged_tile = -1;
+    gpu_fifo_scan_oam();
+}
+
+/* Map and tile line of the next fetch, read when the fetch starts so SCX and
+ * SCY writes apply from the next tile. */
+static void gpu_fifo_fetch_tile(void)
+{
+    unsigned int map, col, y;
+    if (FIFO.window) {
+        map = GPU.window_tile_map ? 0x1c00 : 0x1800;
+        col = FIFO.fetch_x & 31;
+        y = GPU.window_line;
+    } else {
+        map = GPU.bg_tile_map ? 0x1c00 : 0x1800;
+        col = ((GPU.scroll_x >> 3) + FIFO.fetch_x) & 31;
+        y = (GPU.scanline + GPU.scroll_y) & 0xff;
+    }
+    unsigned int offs = map + (y >> 3) * 32 + col;
+    FIFO.tile = GPU.vram[0][offs];
+    FIFO.attr.attributes = cart_is_cgb() ? GPU.vram[1][offs] : 0;
+}
+
+static const uint8_t *gpu_fifo_tile_line(void)
+{
+    unsigned int y = FIFO.window ? GPU.window_line
+                                 : (GPU.scanline + GPU.scroll_y) & 0xff;
+    unsigned int line = FIFO.attr.vflip ? 7 - (y & 7) : y & 7;
+    unsigned int addr = GPU.bg_tile_set
+                            ? FIFO.tile * 16u
+                            : (unsigned int)(0x1000 + (int8_t)FIFO.tile * 16);
+    return &GPU.vram[FIFO.attr.vram_bank][addr + line * 2];
+}
+
+static void gpu_fifo_push(void)
+{
+    for (unsigned int i = 0; i < 8; ++i) {
+        unsigned int bit = FIFO.attr.hflip ? i : 7 - i;
+        fifo_pixel_t *px = &FIFO.bg[i];
+        px->color = (uint8_t)(((FIFO.data_h >> bit) & 1) << 1 |
+                              ((FIFO.data_l >> bit) & 1));
+        px->palette = FIFO.attr.pal_number;
+        px->priority = FIFO.attr.priority;
+    }
+    FIFO.bg_len = 8;
+    FIFO.fetch_x++;
+}
+
+/* One dot of the background fetcher: tile number, low and high data take two
+ * dots each, then it waits for the FIFO to empty. */
+static void gpu_fifo_fetch(void)
+{
+    switch (FIFO.step) {
+        case 1:
+            gpu_fifo_fetch_tile();
+            break;
+        case 3:
+            FIFO.data_l = gpu_fifo_tile_line()[0];
+            break;
+        case 5:
+            FIFO.data_h = gpu_fifo_tile_line()[1];
+            break;
+        case FIFO_FETCH_DOTS:
+            if (FIFO.bg_len)
+                return;
+            gpu_fifo_push();
+            FIFO.step = 0;
+            return;
+    }
+    FIFO.step++;
+}
+
+static void gpu_fifo_start_window(void)
+{
+    FIFO.window = true;
+    FIFO.bg_len = 0;
+    /* Below 7, WX starts the window off screen, like SCX fine scroll. */
+    FIFO.discard = GPU.window_x < 7 ? 7u - GPU.window_x : 0;
+    FIFO.step = 0;
+    FIFO.fetch_x = 0;
+}
+
+/* Fetch a sprite line into the sprite FIFO. The pipeline stops for 6 dots,
+ * plus the wait for the background fetch when the sprite is the first of its
+ * background tile. */
+static void gpu_fifo_fetch_sprite(void)
+{
+    uint8_t idx = FIFO.sprites[FIFO.next_sprite++];
+    const sprite_t *sprite = &((const sprite_t *)GPU.oam)[idx];
+    unsigned int pos = (sprite->x + (FIFO.window ? 7u - GPU.window_x
+                                                 : GPU.scroll_x)) & 0xff;
+    FIFO.stall = FIFO_SPRITE_DOTS - 1;
+    if ((int)(pos >> 3) != FIFO.charged_tile) {
+        FIFO.charged_tile = (int)(pos >> 3);
+        if ((pos & 7) < 5)
+            FIFO.stall += 5 - (pos & 7);
+    }
+    bool cgb = cart_is_cgb();
+    unsigned int height = GPU.obj_size ? 16 : 8;
+    unsigned int line = (unsigned int)(GPU.scanline - (sprite->y - 16));
+    if (sprite->yflip)
+        line = height - 1 - line;
+    unsigned int tile = GPU.obj_size ? sprite->tile & 0xfe : sprite->tile;
+    unsigned int bank = cgb ? sprite->cgb_vram_bank : 0;
+    const uint8_t *data = &GPU.vram[bank][tile * 16 + line * 2];
+    for (unsigned int i = 0; i < 8; ++i) {
+        int px = sprite->x - 8 + (int)i;
+        if (px < (int)FIFO.x)
+            continue;
+        unsigned int bit = sprite->xflip ? i : 7 - i;
+        uint8_t color =
+            (uint8_t)(((data[1] >> bit) & 1) << 1 | ((data[0] >> bit) & 1));
+        fifo_pixel_t *slot =
+            &FIFO.obj[(FIFO.obj_head + (unsigned int)px - FIFO.x) & 7];
+        /* DMG: the first fetched, leftmost, sprite wins. CGB: OAM order. */
+        if (color == 0 || (slot->color && (!cgb || slot->oam < idx)))
+            continue;
+        slot->color = color;
+        slot->palette = cgb ? sprite->cgb_palette : sprite->palette;
+        slot->priority = sprite->priority;
+        slot->oam = idx;
+    }
+}
+
+static color_t gpu_fifo_mix(const fifo_pixel_t *bg, const fifo_pixel_t *obj)
+{
+    bool cgb = cart_is_cgb();
+    /* DMG: with LCDC bit 0 off the background and window are blank. */
+    bool bg_on = cgb || GPU.bg_display;
+    uint8_t bg_color = bg_on ? bg->color : 0;
+    if (obj->color && GPU.obj_enable) {
+        /* CGB: LCDC bit 0 off puts sprites above everything. */
+        bool behind = bg_color && (obj->priority || bg->priority) &&
+                      (!cgb || GPU.bg_display);
+        if (!behind)
+            return GPU.sprite_palette[obj->palette * 4 + obj->color];
+    }
+    if (!bg_on)
+        return g_palette[0];
+    return GPU.bg_palette[bg->palette * 4 + bg_color];
+}
+
+/* One dot of mode 3. */
+static void gpu_fifo_dot(void)
+{
+    if (FIFO.stall) {
+        FIFO.stall--;
+        return;
+    }
+    if (!FIFO.window && GPU.window_enable && FIFO.wy_hit &&
+        FIFO.x + 7 >= GPU.window_x)
+        gpu_fifo_start_window();
+    if (GPU.obj_enable && FIFO.next_sprite < FIFO.nsprites &&
+        gpu_fifo_sprite(FIFO.next_sprite)->x <= FIFO.x + 8) {
+        gpu_fifo_fetch_sprite();
+        return;
+    }
+    gpu_fifo_fetch();
+    if (FIFO.bg_len == 0)
+        return;
+    const fifo_pixel_t *bg = &FIFO.bg[8 - FIFO.bg_len--];
+    if (FIFO.discard) {
+        FIFO.discard--;
+        return;
+    }
+    fifo_pixel_t *obj = &FIFO.obj[FIFO.obj_head];
+    if (FIFO.draw)
+        GPU.framebuffer[GPU.scanline * GB_SCREEN_WIDTH + FIFO.x] =
+            gpu_fifo_mix(bg, obj);
+    obj->color = 0;
+    FIFO.obj_head = (FIFO.obj_head + 1) & 7;
+    FIFO.x++;
+}
+
+unsigned int gpu_fifo_draw(void)
+{
+    while (GPU.modeclock >= GPU.speed) {
+        GPU.modeclock -= GPU.speed;
+        FIFO.dots++;
+        gpu_fifo_dot();
+        if (FIFO.x == GB_SCREEN_WIDTH) {
+            if (FIFO.window)
+                GPU.window_line++;
+            return FIFO.dots;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef GPU_FIFO_H
+#define GPU_FIFO_H
+
+#include <stdbool.h>
+
+/* Pixel FIFO renderer: mode 3 of a line runs the background fetcher and the
+ * pixel FIFOs dot by dot, so its length depends on SCX, the window and the
+ * sprites, and register writes during the line take effect mid-line. */
+
+/* Scan OAM and set up the fetcher, at the start of mode 3. draw is false on
+ * skipped frames: the timing is kept, the framebuffer is left alone. */
+void gpu_fifo_start_line(bool draw);
+/* Run the FIFO on the clocks accumulated in the GPU mode clock. Return the
+ * mode 3 length in dots once the line is complete, 0 before. */
+unsigned int gpu_fifo_draw(void);
+
+#endif /* GPU_FIFO_H */
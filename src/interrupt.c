@@ -3,6 +3,7 @@
 #include "clock.h"
 #include "cpu.h"
 #include "cpu_opcodes.h"
+#include "profile.h"
 
 extern cpu_t CPU;
 
@@ -66,6 +67,7 @@ static void vblank(void)
 {
     push(CPU.reg.pc);
     CPU.reg.pc = 0x40;
+    PROF_CALL(CPU.reg.pc, CPU.reg.sp);
     clock_step(12);
 }
 
@@ -73,6 +75,7 @@ static void lcd_stat(void)
 {
     push(CPU.reg.pc);
     CPU.reg.pc = 0x48;
+    PROF_CALL(CPU.reg.pc, CPU.reg.sp);
     clock_step(12);
 }
 
@@ -80,6 +83,7 @@ static void timer(void)
 {
     push(CPU.reg.pc);
     CPU.reg.pc = 0x50;
+    PROF_CALL(CPU.reg.pc, CPU.reg.sp);
     clock_step(12);
 }
 
@@ -87,6 +91,7 @@ static void serial(void)
 {
     push(CPU.reg.pc);
     CPU.reg.pc = 0x58;
+    PROF_CALL(CPU.reg.pc, CPU.reg.sp);
     clock_step(12);
 }
 
@@ -94,6 +99,7 @@ static void joypad(void)
 {
     push(CPU.reg.pc);
     CPU.reg.pc = 0x60;
+    PROF_CALL(CPU.reg.pc, CPU.reg.sp);
     clock_step(12);
 }
 
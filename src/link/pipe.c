@@ -0,0 +1,82 @@
+#include "pipe.h"
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+bool link_pipe_send(link_pipe_end_t *end, uint8_t val)
+{
+    link_ring_t *ring = end->tx;
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - head == LINK_PIPE_SIZE)
+        return false;
+    ring->buf[tail & (LINK_PIPE_SIZE - 1)] = val;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+int link_pipe_recv(link_pipe_end_t *end)
+{
+    link_ring_t *ring = end->rx;
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head == tail)
+        return -1;
+    uint8_t val = ring->buf[head & (LINK_PIPE_SIZE - 1)];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return val;
+}
+
+/* Send our byte and wait for the peer's answer, blocking the emulation for
+ * up to SERIAL_LINK_TIMEOUT_MS of host time. */
+static int link_pipe_transfer(serial_link_t *link, uint8_t out)
+{
+    link_pipe_end_t *end = (link_pipe_end_t *)link;
+    if (!link_pipe_send(end, out))
+        return -1;
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned int i = 1;; ++i) {
+        int in = link_pipe_recv(end);
+        if (in >= 0)
+            return in;
+        /* Spin briefly, then let the peer thread run. */
+        if (i > 64)
+            sched_yield();
+        if (i % 1024 == 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long ms = (now.tv_sec - start.tv_sec) * 1000 +
+                      (now.tv_nsec - start.tv_nsec) / 1000000;
+            if (ms >= SERIAL_LINK_TIMEOUT_MS)
+                return -1;
+        }
+    }
+}
+
+/* Take a byte clocked by the peer and answer it. */
+static int link_pipe_poll(serial_link_t *link, uint8_t out)
+{
+    link_pipe_end_t *end = (link_pipe_end_t *)link;
+    int in = link_pipe_recv(end);
+    if (in >= 0)
+        link_pipe_send(end, out);
+    return in;
+}
+
+static void link_pipe_close(serial_link_t *link)
+{
+    (void)link;
+}
+
+void link_pipe_init(link_pipe_t *pipe)
+{
+    memset(pipe, 0, sizeof(*pipe));
+    for (int i = 0; i < 2; ++i) {
+        link_pipe_end_t *end = &pipe->end[i];
+        end->link.transfer = link_pipe_transfer;
+        end->link.poll = link_pipe_poll;
+        end->link.close = link_pipe_close;
+        end->tx = &pipe->ring[i];
+        end->rx = &pipe->ring[i ^ 1];
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef __LINK_PIPE_H__
+#define __LINK_PIPE_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include "serial.h"
+
+#define LINK_PIPE_SIZE 64 /* Power of 2. */
+
+/* Single producer, single consumer byte ring. */
+typedef struct {
+    atomic_uint head; /* Written by the consumer. */
+    atomic_uint tail; /* Written by the producer. */
+    uint8_t buf[LINK_PIPE_SIZE];
+} link_ring_t;
+
+typedef struct {
+    serial_link_t link;
+    link_ring_t *tx;
+    link_ring_t *rx;
+} link_pipe_end_t;
+
+/* In-process link cable between two threads, one per end. It needs no locks:
+ * each ring has a single writer and a single reader. */
+typedef struct {
+    link_ring_t ring[2];
+    link_pipe_end_t end[2];
+} link_pipe_t;
+
+void link_pipe_init(link_pipe_t *pipe);
+bool link_pipe_send(link_pipe_end_t *end, uint8_t val);
+int link_pipe_recv(link_pipe_end_t *end);
+
+#endif /* __LINK_PIPE_H__ */
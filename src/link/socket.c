@@ -0,0 +1,180 @@
+#include "socket.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Messages are two bytes: type and data. */
+#define MSG_CLOCK 'M'  /* Byte clocked by the sender. */
+#define MSG_ANSWER 'S' /* Answer to a clocked byte. */
+
+typedef struct {
+    serial_link_t link;
+    int listen_fd; /* Listening socket of the first side, or -1. */
+    int fd;        /* Connection to the peer, or -1. */
+    char *path;
+} link_socket_t;
+
+static bool link_socket_connected(link_socket_t *ls)
+{
+    if (ls->fd < 0 && ls->listen_fd >= 0) {
+        ls->fd = accept(ls->listen_fd, NULL, NULL);
+        if (ls->fd >= 0)
+            printf("Link cable connected: %s\n", ls->path);
+    }
+    return ls->fd >= 0;
+}
+
+static void link_socket_disconnect(link_socket_t *ls)
+{
+    printf("Link cable disconnected: %s\n", ls->path);
+    close(ls->fd);
+    ls->fd = -1;
+}
+
+static void link_socket_send(link_socket_t *ls, uint8_t type, uint8_t val)
+{
+    uint8_t msg[2] = {type, val};
+    if (send(ls->fd, msg, sizeof(msg), MSG_NOSIGNAL) != sizeof(msg))
+        link_socket_disconnect(ls);
+}
+
+/* Wait up to timeout_ms for a message, return its type or -1. */
+static int link_socket_recv(link_socket_t *ls, int timeout_ms, uint8_t *val)
+{
+    struct pollfd pfd = {.fd = ls->fd, .events = POLLIN};
+    if (poll(&pfd, 1, timeout_ms) <= 0)
+        return -1;
+    uint8_t msg[2];
+    if (recv(ls->fd, msg, sizeof(msg), MSG_WAITALL) != sizeof(msg)) {
+        link_socket_disconnect(ls);
+        return -1;
+    }
+    *val = msg[1];
+    return msg[0];
+}
+
+static long elapsed_ms(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 +
+           (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+static int link_socket_transfer(serial_link_t *link, uint8_t out)
+{
+    link_socket_t *ls = (link_socket_t *)link;
+    uint8_t val;
+    if (!link_socket_connected(ls))
+        return -1;
+    /* Drop answers that came after a previous timeout. */
+    int type;
+    while ((type = link_socket_recv(ls, 0, &val)) >= 0) {
+        if (type == MSG_CLOCK)
+            link_socket_send(ls, MSG_ANSWER, 0xff);
+    }
+    if (ls->fd < 0)
+        return -1;
+    link_socket_send(ls, MSG_CLOCK, out);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long left = SERIAL_LINK_TIMEOUT_MS;
+    while (ls->fd >= 0 && left > 0) {
+        type = link_socket_recv(ls, (int)left, &val);
+        if (type == MSG_ANSWER)
+            return val;
+        /* Both sides clocking: the peer reads a disconnected line. */
+        if (type == MSG_CLOCK)
+            link_socket_send(ls, MSG_ANSWER, 0xff);
+        left = SERIAL_LINK_TIMEOUT_MS - elapsed_ms(&start);
+    }
+    return -1;
+}
+
+static int link_socket_poll(serial_link_t *link, uint8_t out)
+{
+    link_socket_t *ls = (link_socket_t *)link;
+    uint8_t val;
+    if (!link_socket_connected(ls))
+        return -1;
+    if (link_socket_recv(ls, 0, &val) != MSG_CLOCK)
+        return -1;
+    link_socket_send(ls, MSG_ANSWER, out);
+    return val;
+}
+
+static void link_socket_close(serial_link_t *link)
+{
+    link_socket_t *ls = (link_socket_t *)link;
+    if (ls->fd >= 0)
+        close(ls->fd);
+    if (ls->listen_fd >= 0) {
+        close(ls->listen_fd);
+        unlink(ls->path);
+    }
+    free(ls->path);
+    free(ls);
+}
+
+/* Listen on addr after a failed connect, without blocking emulation while
+ * waiting for the peer. */
+static int link_socket_listen(int fd, struct sockaddr_un *addr)
+{
+    if (errno == ECONNREFUSED) {
+        /* Stale socket of a previous run. */
+        unlink(addr->sun_path);
+    } else if (errno != ENOENT) {
+        perror("connect link");
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)addr, sizeof(*addr)) < 0 ||
+        listen(fd, 1) < 0 || fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+        perror("listen link");
+        return -1;
+    }
+    return 0;
+}
+
+serial_link_t *link_socket_open(const char *path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "ERROR: link socket path too long: %s\n", path);
+        return NULL;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket link");
+        return NULL;
+    }
+    link_socket_t *ls = calloc(1, sizeof(*ls));
+    ls->link.transfer = link_socket_transfer;
+    ls->link.poll = link_socket_poll;
+    ls->link.close = link_socket_close;
+    ls->path = strdup(path);
+    ls->fd = -1;
+    ls->listen_fd = -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        ls->fd = fd;
+        printf("Link cable connected: %s\n", path);
+        return &ls->link;
+    }
+    if (link_socket_listen(fd, &addr) < 0) {
+        close(fd);
+        free(ls->path);
+        free(ls);
+        return NULL;
+    }
+    ls->listen_fd = fd;
+    printf("Link cable waiting for peer: %s\n", path);
+    return &ls->link;
+}
@@ -0,0 +1,10 @@
+#ifndef __LINK_SOCKET_H__
+#define __LINK_SOCKET_H__
+
+#include "serial.h"
+
+/* Link cable to another process over a Unix domain socket at path. The first
+ * side to open path listens on it, the second one connects. */
+serial_link_t *link_socket_open(const char *path);
+
+#endif /* __LINK_SOCKET_H__ */
@@ -3,20 +3,85 @@
 #include <unistd.h>
 #include "game_boy.h"
 
-static int scale = 4;
+#ifdef PROFILE
+#define PROFILE_OPTS "F:y:n:"
+#else
+#define PROFILE_OPTS ""
+#endif
+
+static gb_config_t config = {.scale = 4};
 static char *romfile = NULL;
 
 static int parse_args(int argc, char **argv)
 {
     int opt;
-    while ((opt = getopt(argc, argv, "s:ch")) != -1) {
+    const char *opts = "as:x:v:gG:Vmek:r:p:f:D:HTch" PROFILE_OPTS;
+    while ((opt = getopt(argc, argv, opts)) != -1) {
         switch (opt) {
+            case 'a':
+                config.ppu_fifo = true;
+                break;
             case 's':
-                scale = strtol(optarg, NULL, 10);
-                if (scale < 1 || scale > 10) {
-                    fprintf(stderr, "Invalid scale: %d\n", scale);
+                config.scale = strtol(optarg, NULL, 10);
+                if (config.scale < 1 || config.scale > 10) {
+                    fprintf(stderr, "Invalid scale: %d\n", config.scale);
+                    return -1;
+                }
+                break;
+            case 'x':
+                if (scale_parse(optarg, &config.filter) < 0) {
+                    fprintf(stderr, "Invalid filter: %s\n", optarg);
                     return -1;
                 }
+                config.upscale = true;
+                break;
+            case 'v':
+                config.capture_path = optarg;
+                break;
+            case 'g':
+                config.debugger = true;
+                break;
+            case 'G':
+                config.gdb_addr = optarg;
+                break;
+            case 'V':
+                config.viewer = true;
+                break;
+            case 'm':
+                config.ram_sync = true;
+                break;
+            case 'e':
+                config.rtc_emu = true;
+                break;
+            case 'k':
+                config.link_path = optarg;
+                break;
+            case 'r':
+                config.movie_record = optarg;
+                break;
+            case 'p':
+                config.movie_play = optarg;
+                break;
+            case 'f':
+                config.frame_skip = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            case 'H':
+                config.headless = true;
+                break;
+            case 'D':
+                config.doctor_path = optarg;
+                break;
+            case 'T':
+                config.no_trace = true;
+                break;
+            case 'F':
+                config.stacks_path = optarg;
+                break;
+            case 'y':
+                config.sym_path = optarg;
+                break;
+            case 'n':
+                config.period = (unsigned int)strtoul(optarg, NULL, 10);
                 break;
             case 'c':
                 printf(
@@ -24,6 +89,12 @@ static int parse_args(int argc, char **argv)
                     "Controls:\n"
                     "P:\tPause emulation\n"
                     "O:\tDump emulator debugs\n"
+                    "T:\tDump execution trace to gusgb.trace\n"
+                    "V:\tDump VRAM viewer to gusgb_vram.png\n"
+                    "G:\tBreak into the debugger (with -g)\n"
+#ifdef PROFILE
+                    "I:\tDump guest opcode profile\n"
+#endif
                     "ESQ:\tQuit program\n"
                     "\n"
                     "Key mapping:\n"
@@ -45,6 +116,10 @@ static int parse_args(int argc, char **argv)
     if (romfile == NULL) {
         return -1;
     }
+    if (config.headless && config.movie_play == NULL) {
+        fprintf(stderr, "Headless mode needs a movie to play\n");
+        return -1;
+    }
     return 0;
 }
 
@@ -53,9 +128,31 @@ static void print_help(char **argv)
     fprintf(stderr,
             "Usage: %s [options] romfile\n"
             "Options:\n"
+            "  -a\t\tAccurate PPU: render with the pixel FIFO\n"
             "  -c\t\tPrint keyboard controls\n"
+            "  -D <file>\tLog CPU state in Gameboy Doctor format\n"
+#ifdef PROFILE
+            "  -F <file>\tSample guest call stacks, write them folded\n"
+            "  -n <cycles>\tCycles between stack samples \n"
+            "  -y <file>\tSymbols (.sym) to name stack frames\n"
+#endif
+            "  -H\t\tHeadless: play the movie at full speed and quit\n"
+            "  -T\t\tDisable the execution trace\n"
+            "  -V\t\tVRAM viewer window (headless: gusgb_vram.png on exit)\n"
+            "  -e\t\tRun the cartridge RTC on emulated time\n"
+            "  -f <frames>\tSkip rendering <frames> frames after each shown\n"
+            "  -g\t\tStart in the debugger console, on stdin\n"
+            "  -G <addr>\tGDB server on a localhost port or a Unix socket\n"
             "  -h\t\tPrint help and exit\n"
-            "  -s <scale>\tScale video output\n",
+            "  -k <socket>\tLink cable to another gusgb on a Unix socket\n"
+            "  -m\t\tMap battery RAM to the save file (sync in background)\n"
+            "  -p <movie>\tReplay input movie\n"
+            "  -r <movie>\tRecord input movie\n"
+            "  -s <scale>\tScale video output\n"
+            "  -v <file>\tCapture video, Y4M if <file> ends in .y4m, else "
+            "raw RGB24\n"
+            "  -x <filter>\tUpscale on the CPU: nearest, scale2x, scale3x, "
+            "xbr\n",
             argv[0]);
 }
 
@@ -65,7 +162,7 @@ int main(int argc, char *argv[])
         print_help(argv);
         exit(EXIT_FAILURE);
     }
-    int ret = gb_init(scale, romfile);
+    int ret = gb_init(&config, romfile);
     if (ret < 0) {
         exit(EXIT_FAILURE);
     }
@@ -6,19 +6,75 @@
 #include "apu.h"
 #include "cartridge/cart.h"
 #include "clock.h"
+#include "debugger.h"
 #include "gpu.h"
 #include "interrupt.h"
 #include "keys.h"
+#include "serial.h"
 #include "timer.h"
 
 static mmu_t MMU;
 
+static uint8_t wram_get_bank(void)
+{
+    if (MMU.wram_bank == 0)
+        return 1;
+    return MMU.wram_bank;
+}
+
+/* Map pages of a host memory block starting at addr, except the pages
+ * watched for the access. */
+static void mmu_map_pages(uint8_t **pages, uint16_t addr, uint8_t *mem,
+                          unsigned int size)
+{
+    unsigned int first = addr >> MMU_PAGE_SHIFT;
+    uint8_t watch =
+        pages == MMU.read_page ? MMU_WATCH_READ : MMU_WATCH_WRITE;
+    for (unsigned int i = 0; i < size >> MMU_PAGE_SHIFT; ++i) {
+        bool watched = MMU.watch[first + i] & watch;
+        pages[first + i] =
+            mem && !watched ? mem + (i << MMU_PAGE_SHIFT) : NULL;
+    }
+}
+
+static void mmu_map_wram(void)
+{
+    uint8_t *bank = MMU.wram[wram_get_bank()];
+    mmu_map_pages(MMU.read_page, 0xd000, bank, 0x1000);
+    mmu_map_pages(MMU.write_page, 0xd000, bank, 0x1000);
+}
+
+/* Bind the cartridge map, called again by the cartridge on bank switch. */
+static void mmu_map_cart(void)
+{
+    cart_get_map(&MMU.cart);
+    mmu_map_pages(MMU.read_page, 0x0000, MMU.cart.rom0, 0x4000);
+    mmu_map_pages(MMU.read_page, 0x4000, MMU.cart.rom1, 0x4000);
+    mmu_map_pages(MMU.read_page, 0xa000, MMU.cart.ram_rd, 0x2000);
+    mmu_map_pages(MMU.write_page, 0xa000, MMU.cart.ram_wr, 0x2000);
+}
+
+static void mmu_map(void)
+{
+    memset(MMU.read_page, 0, sizeof(MMU.read_page));
+    memset(MMU.write_page, 0, sizeof(MMU.write_page));
+    mmu_map_cart();
+    /* 0xc000-0xcfff: WRAM bank 0 and its echo at 0xe000-0xefff. The
+     * 0xf000 page also holds OAM and I/O and is always decoded. */
+    mmu_map_pages(MMU.read_page, 0xc000, MMU.wram[0], 0x1000);
+    mmu_map_pages(MMU.write_page, 0xc000, MMU.wram[0], 0x1000);
+    mmu_map_pages(MMU.read_page, 0xe000, MMU.wram[0], 0x1000);
+    mmu_map_pages(MMU.write_page, 0xe000, MMU.wram[0], 0x1000);
+    mmu_map_wram();
+}
+
 int mmu_init(const char *rom_path)
 {
     int ret = cart_load(rom_path);
     if (ret < 0) {
         return -1;
     }
+    cart_set_remap_cb(mmu_map_cart);
     mmu_reset();
     return 0;
 }
@@ -33,8 +89,10 @@ void mmu_reset(void)
     memset(MMU.wram, 0, sizeof(MMU.wram));
     memset(MMU.zram, 0, sizeof(MMU.zram));
     MMU.wram_bank = 0;
+    mmu_map();
     interrupt_reset();
     keys_reset();
+    serial_reset();
     apu_reset();
     gpu_reset();
 }
@@ -45,11 +103,9 @@ static uint8_t mmu_read_reg(uint16_t addr)
         case 0x00:
             return keys_read();
         case 0x01:
-            /* TODO: SB Serial transfer data */
-            return 0;
+            return serial_read_sb();
         case 0x02:
-            /* TODO: SIO control */
-            return 0;
+            return serial_read_sc();
         case 0x04:
             return timer_read_div();
         case 0x05:
@@ -159,6 +215,13 @@ static uint8_t mmu_read_reg(uint16_t addr)
             return gpu_read_wx();
         case 0x4f:
             return gpu_read_vbk();
+        case 0x51:
+        case 0x52:
+        case 0x53:
+        case 0x54:
+            return 0xff;
+        case 0x55:
+            return gpu_read_hdma5();
         case 0x68:
             return gpu_read_bgpi();
         case 0x69:
@@ -188,10 +251,10 @@ static void mmu_write_reg(uint16_t addr, uint8_t value)
             keys_write(value);
             break;
         case 0x01:
-            /* TODO: SB Serial transfer data */
+            serial_write_sb(value);
             break;
         case 0x02:
-            /* TODO: SIO control */
+            serial_write_sc(value);
             break;
         case 0x04:
             timer_write_div();
@@ -341,6 +404,21 @@ static void mmu_write_reg(uint16_t addr, uint8_t value)
         case 0x4f:
             gpu_write_vbk(value);
             break;
+        case 0x51:
+            gpu_write_hdma1(value);
+            break;
+        case 0x52:
+            gpu_write_hdma2(value);
+            break;
+        case 0x53:
+            gpu_write_hdma3(value);
+            break;
+        case 0x54:
+            gpu_write_hdma4(value);
+            break;
+        case 0x55:
+            gpu_write_hdma5(value);
+            break;
         case 0x68:
             gpu_write_bgpi(value);
             break;
@@ -364,6 +442,7 @@ static void mmu_write_reg(uint16_t addr, uint8_t value)
             break;
         case 0x70:
             MMU.wram_bank = value & 7;
+            mmu_map_wram();
             break;
         default:
             printf("%s: not implemented: 0x%04x=0x%02x\n", __func__, addr,
@@ -372,15 +451,8 @@ static void mmu_write_reg(uint16_t addr, uint8_t value)
     }
 }
 
-static uint8_t wram_get_bank(void)
-{
-    if (MMU.wram_bank == 0)
-        return 1;
-    return MMU.wram_bank;
-}
-
-/* Read 8-bit byte from a given address */
-uint8_t mmu_read_byte_dma(uint16_t addr)
+/* Read a byte outside of the page tables. */
+static uint8_t mmu_read_slow(uint16_t addr)
 {
     if (addr < 0x4000) {
         /* 16kB ROM bank 0. */
@@ -393,7 +465,7 @@ uint8_t mmu_read_byte_dma(uint16_t addr)
         return gpu_read_vram(addr);
     } else if (addr < 0xc000) {
         /* 8kB Switchable RAM bank. */
-        return cart_read_ram(addr);
+        return MMU.cart.ram_read(addr);
     } else if (addr < 0xd000) {
         /* 4KB Work RAM Bank 0 (WRAM). */
         return MMU.wram[0][addr & 0x0fff];
@@ -424,10 +496,47 @@ uint8_t mmu_read_byte_dma(uint16_t addr)
     abort();
 }
 
+/* Read 8-bit byte from a given address */
+uint8_t mmu_read_byte_dma(uint16_t addr)
+{
+    uint8_t *page = MMU.read_page[addr >> MMU_PAGE_SHIFT];
+    if (page) {
+        return page[addr & (MMU_PAGE_SIZE - 1)];
+    }
+    return mmu_read_slow(addr);
+}
+
+void mmu_read_block(uint16_t addr, uint8_t *dst, unsigned int len)
+{
+    while (len > 0) {
+        unsigned int offset = addr & (MMU_PAGE_SIZE - 1);
+        unsigned int n = MMU_PAGE_SIZE - offset;
+        if (n > len)
+            n = len;
+        uint8_t *page = MMU.read_page[addr >> MMU_PAGE_SHIFT];
+        if (page) {
+            memcpy(dst, page + offset, n);
+        } else {
+            for (unsigned int i = 0; i < n; ++i)
+                dst[i] = mmu_read_byte_dma((uint16_t)(addr + i));
+        }
+        addr = (uint16_t)(addr + n);
+        dst += n;
+        len -= n;
+    }
+}
+
 uint8_t mmu_read_byte(uint16_t addr)
 {
     clock_step(4);
-    return mmu_read_byte_dma(addr);
+    if (gpu_oam_dma_conflict(addr))
+        return gpu_read_dma_bus(addr);
+    uint8_t *page = MMU.read_page[addr >> MMU_PAGE_SHIFT];
+    if (page)
+        return page[addr & (MMU_PAGE_SIZE - 1)];
+    if (MMU.watch[addr >> MMU_PAGE_SHIFT] & MMU_WATCH_READ)
+        debugger_watch_read(addr);
+    return mmu_read_slow(addr);
 }
 
 uint16_t mmu_read_word(uint16_t addr)
@@ -436,18 +545,19 @@ uint16_t mmu_read_word(uint16_t addr)
     return (uint16_t)(mmu_read_byte(addrh) << 8 | mmu_read_byte(addr));
 }
 
-void mmu_write_byte(uint16_t addr, uint8_t value)
+/* Write a byte outside of the page tables. */
+static void mmu_write_slow(uint16_t addr, uint8_t value)
 {
-    clock_step(4);
     if (addr < 0x8000) {
         /* 16kB ROM bank 0 and 16kB switchable ROM bank. */
-        cart_write_mbc(addr, value);
+        if (MMU.cart.write)
+            MMU.cart.write(addr, value);
     } else if (addr < 0xa000) {
         /* 8kB Video RAM. */
         gpu_write_vram(addr, value);
     } else if (addr < 0xc000) {
         /* 8kB Switchable RAM bank. */
-        cart_write_ram(addr, value);
+        MMU.cart.ram_write(addr, value);
     } else if (addr < 0xd000) {
         /* 4KB Work RAM Bank 0 (WRAM). */
         MMU.wram[0][addr & 0x0fff] = value;
@@ -475,6 +585,36 @@ void mmu_write_byte(uint16_t addr, uint8_t value)
     }
 }
 
+void mmu_write_byte(uint16_t addr, uint8_t value)
+{
+    clock_step(4);
+    if (gpu_oam_dma_conflict(addr))
+        return;
+    uint8_t *page = MMU.write_page[addr >> MMU_PAGE_SHIFT];
+    if (page) {
+        page[addr & (MMU_PAGE_SIZE - 1)] = value;
+        return;
+    }
+    if (MMU.watch[addr >> MMU_PAGE_SHIFT] & MMU_WATCH_WRITE)
+        debugger_watch_write(addr, value);
+    mmu_write_slow(addr, value);
+}
+
+void mmu_write_byte_debug(uint16_t addr, uint8_t value)
+{
+    uint8_t *page = MMU.write_page[addr >> MMU_PAGE_SHIFT];
+    if (page)
+        page[addr & (MMU_PAGE_SIZE - 1)] = value;
+    else
+        mmu_write_slow(addr, value);
+}
+
+void mmu_watch_page(unsigned int page, uint8_t flags)
+{
+    MMU.watch[page] = flags;
+    mmu_map();
+}
+
 void mmu_write_word(uint16_t addr, uint16_t value)
 {
     uint16_t addrh = (uint16_t)(addr + 1);
@@ -488,6 +628,7 @@ void mmu_stop(void)
         MMU.speed_switch = (~MMU.speed_switch) & 0x80;
         gpu_change_speed(MMU.speed_switch >> 7);
         timer_change_speed(MMU.speed_switch >> 7);
+        clock_change_speed(MMU.speed_switch >> 7);
     }
 }
 
@@ -3,8 +3,13 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "cartridge/cart.h"
 
-typedef void (*switch_ext_rom_cb_t)(void);
+#define MMU_PAGE_SHIFT 12
+#define MMU_PAGE_SIZE (1 << MMU_PAGE_SHIFT)
+#define MMU_PAGES (0x10000 >> MMU_PAGE_SHIFT)
+#define MMU_WATCH_READ (1 << 0)
+#define MMU_WATCH_WRITE (1 << 1)
 
 typedef struct {
     uint8_t wram[8][0x1000]; /* Working RAM. */
@@ -12,6 +17,13 @@ typedef struct {
     uint8_t ir;              /* 0xff56 (RP): Infrared Port */
     uint8_t speed_switch;    /* 0xff4d (KEY1): Prepare Speed Switch */
     unsigned int wram_bank;  /* 0xff70 (SVBK): WRAM Bank */
+    /* Host memory of 4KB pages accessed without address decoding, NULL for
+     * pages that need it (VRAM, I/O, or cartridge controllers). */
+    uint8_t *read_page[MMU_PAGES];
+    uint8_t *write_page[MMU_PAGES];
+    /* Pages with debugger watchpoints, left out of the tables above. */
+    uint8_t watch[MMU_PAGES];
+    cart_map_t cart; /* Cartridge handlers bound at load time. */
 } mmu_t;
 
 /* Init MMU subsystem. */
@@ -25,6 +37,9 @@ void mmu_reset(void);
 
 uint8_t mmu_read_byte_dma(uint16_t addr);
 
+/* Copy len bytes starting at addr as seen by DMA, page by page. */
+void mmu_read_block(uint16_t addr, uint8_t *dst, unsigned int len);
+
 /* Read byte from a given address. */
 uint8_t mmu_read_byte(uint16_t addr);
 
@@ -34,6 +49,14 @@ uint16_t mmu_read_word(uint16_t addr);
 /* Write byte to a given address. */
 void mmu_write_byte(uint16_t addr, uint8_t value);
 
+/* Write byte without advancing the clock nor triggering watchpoints, for
+ * debuggers. */
+void mmu_write_byte_debug(uint16_t addr, uint8_t value);
+
+/* Send CPU accesses to a page through the slow path, where the debugger
+ * checks its watchpoints: MMU_WATCH_ flags, 0 to map the page back. */
+void mmu_watch_page(unsigned int page, uint8_t flags);
+
 /* Write word to a given address. */
 void mmu_write_word(uint16_t addr, uint16_t value);
 
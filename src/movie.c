@@ -0,0 +1,153 @@
+#include "movie.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "clock.h"
+
+#define MOVIE_HEADER "gusgb-movie 1\n"
+
+typedef struct {
+    uint64_t frame;
+    uint64_t cycles;
+    key_e key;
+    bool pressed;
+} movie_event_t;
+
+typedef enum {
+    MOVIE_OFF = 0,
+    MOVIE_RECORD,
+    MOVIE_PLAY,
+} movie_mode_e;
+
+typedef struct {
+    movie_mode_e mode;
+    FILE *file;            /* Recording output. */
+    movie_event_t *events; /* Playback events. */
+    size_t count;
+    size_t next;
+    uint64_t frame; /* Frames emulated so far. */
+} movie_t;
+
+static movie_t MOVIE;
+
+int movie_record(const char *path)
+{
+    MOVIE.file = fopen(path, "w");
+    if (MOVIE.file == NULL) {
+        perror(path);
+        return -1;
+    }
+    fputs(MOVIE_HEADER, MOVIE.file);
+    MOVIE.mode = MOVIE_RECORD;
+    MOVIE.frame = 0;
+    return 0;
+}
+
+static int movie_parse_key(const char *name, key_e *key)
+{
+    for (int i = 0; i < KEY_MAX; ++i) {
+        if (strcmp(name, key_str((key_e)i)) == 0) {
+            *key = (key_e)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int movie_play(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    char line[128];
+    if (fgets(line, sizeof(line), file) == NULL ||
+        strcmp(line, MOVIE_HEADER) != 0) {
+        fprintf(stderr, "ERROR: not a movie file: %s\n", path);
+        fclose(file);
+        return -1;
+    }
+    size_t size = 0;
+    for (unsigned int n = 2; fgets(line, sizeof(line), file); ++n) {
+        unsigned long long frame, cycles;
+        char name[16], action[16];
+        movie_event_t ev;
+        if (sscanf(line, "%llu %llu %15s %15s", &frame, &cycles, name,
+                   action) != 4 ||
+            movie_parse_key(name, &ev.key) < 0 ||
+            (strcmp(action, "press") != 0 && strcmp(action, "release") != 0)) {
+            fprintf(stderr, "ERROR: %s:%u: invalid event\n", path, n);
+            fclose(file);
+            return -1;
+        }
+        ev.frame = frame;
+        ev.cycles = cycles;
+        ev.pressed = strcmp(action, "press") == 0;
+        if (MOVIE.count == size) {
+            size = size ? size * 2 : 256;
+            MOVIE.events = realloc(MOVIE.events, size * sizeof(ev));
+        }
+        MOVIE.events[MOVIE.count++] = ev;
+    }
+    fclose(file);
+    MOVIE.mode = MOVIE_PLAY;
+    MOVIE.next = 0;
+    MOVIE.frame = 0;
+    return 0;
+}
+
+static void movie_apply(key_e key, bool pressed)
+{
+    if (pressed)
+        key_press(key);
+    else
+        key_release(key);
+}
+
+void movie_key(key_e key, bool pressed)
+{
+    if (MOVIE.mode == MOVIE_PLAY)
+        return;
+    if (MOVIE.mode == MOVIE_RECORD) {
+        fprintf(MOVIE.file, "%llu %llu %s %s\n",
+                (unsigned long long)MOVIE.frame,
+                (unsigned long long)clock_get_cycles(), key_str(key),
+                pressed ? "press" : "release");
+    }
+    movie_apply(key, pressed);
+}
+
+void movie_frame(void)
+{
+    MOVIE.frame++;
+    if (MOVIE.mode != MOVIE_PLAY)
+        return;
+    while (MOVIE.next < MOVIE.count &&
+           MOVIE.events[MOVIE.next].frame <= MOVIE.frame) {
+        movie_event_t *ev = &MOVIE.events[MOVIE.next++];
+        if (ev->cycles != clock_get_cycles()) {
+            fprintf(stderr, "WARNING: movie desync at frame %llu\n",
+                    (unsigned long long)MOVIE.frame);
+        }
+        movie_apply(ev->key, ev->pressed);
+    }
+}
+
+bool movie_done(void)
+{
+    return MOVIE.mode == MOVIE_PLAY && MOVIE.next == MOVIE.count;
+}
+
+uint64_t movie_get_frame(void)
+{
+    return MOVIE.frame;
+}
+
+void movie_close(void)
+{
+    if (MOVIE.file)
+        fclose(MOVIE.file);
+    free(MOVIE.events);
+    memset(&MOVIE, 0, sizeof(MOVIE));
+}
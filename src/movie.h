@@ -0,0 +1,30 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "keys.h"
+
+/* Input movies: joypad changes keyed by emulated frame, one per line:
+ * <frame> <cycles> <key> press|release
+ * The cycle count is checked on playback to detect desyncs. */
+
+/* Record key changes to path. */
+int movie_record(const char *path);
+
+/* Replay key changes from path, live input is ignored meanwhile. */
+int movie_play(const char *path);
+
+/* Press or release a key from live input, recording it if enabled. */
+void movie_key(key_e key, bool pressed);
+
+/* Called once per emulated frame: inject the keys of this frame. */
+void movie_frame(void);
+
+/* Check if playback has no more events. */
+bool movie_done(void);
+
+uint64_t movie_get_frame(void);
+void movie_close(void);
+
+#endif /* MOVIE_H */
@@ -0,0 +1,23 @@
+#ifndef OBJDUMP_INSTR_H
+#define OBJDUMP_INSTR_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef struct {
+    const char *asm1;
+    const char *asm2;
+    uint8_t length;
+} instruction_t;
+
+typedef struct {
+    const char *asm1;
+} ext_instruction_t;
+
+/* Opcode mnemonics and lengths. asm1 is NULL for the 0xcb prefix (length 2)
+ * and undefined opcodes (length 1). */
+extern const instruction_t instr[256];
+/* Mnemonics of the 0xcb prefixed opcodes. */
+extern const ext_instruction_t cb_instr[256];
+
+#endif /* OBJDUMP_INSTR_H */
@@ -0,0 +1,69 @@
+/* Decode an execution trace dumped by gusgb into one line per instruction:
+ * cycles, bank:pc, disassembly and the registers before it executed. */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../trace.h"
+#include "instr.h"
+
+static void tracedump_instruction(char *str, size_t size,
+                                  const trace_entry_t *entry)
+{
+    const instruction_t *in = &instr[entry->opcode];
+    const char *asm2 = in->asm2 ? in->asm2 : "";
+    uint16_t operand =
+        (uint16_t)(entry->operand[0] | (entry->operand[1] << 8));
+    if (in->asm1 == NULL && in->length == 2) {
+        snprintf(str, size, "%s", cb_instr[entry->operand[0]].asm1);
+    } else if (in->asm1 == NULL) {
+        snprintf(str, size, ".db $%02x", entry->opcode);
+    } else if (in->length == 1) {
+        snprintf(str, size, "%s", in->asm1);
+    } else if (in->length == 2) {
+        snprintf(str, size, "%s%02x%s", in->asm1, entry->operand[0], asm2);
+    } else {
+        snprintf(str, size, "%s%04x%s", in->asm1, operand, asm2);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "ERROR: syntax: %s <trace file>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    FILE *file = fopen(argv[1], "rb");
+    if (file == NULL) {
+        perror(argv[1]);
+        exit(EXIT_FAILURE);
+    }
+    trace_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.entry_size != sizeof(trace_entry_t)) {
+        fprintf(stderr, "ERROR: not a gusgb trace: %s\n", argv[1]);
+        fclose(file);
+        exit(EXIT_FAILURE);
+    }
+    trace_entry_t entry;
+    uint32_t n = 0;
+    while (n < header.count && fread(&entry, sizeof(entry), 1, file) == 1) {
+        char str[32];
+        unsigned int bank =
+            entry.pc >= 0x4000 && entry.pc < 0x8000 ? entry.bank : 0;
+        tracedump_instruction(str, sizeof(str), &entry);
+        printf("%10u %02x:%04x  %-20s AF:%04x BC:%04x DE:%04x HL:%04x "
+               "SP:%04x\n",
+               entry.cycles, bank, entry.pc, str, entry.af, entry.bc,
+               entry.de, entry.hl, entry.sp);
+        n++;
+    }
+    fclose(file);
+    if (n != header.count) {
+        fprintf(stderr, "ERROR: truncated trace: %u of %u entries\n", n,
+                header.count);
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
@@ -0,0 +1,354 @@
+#include "profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include "cartridge/cart.h"
+#include "cpu.h"
+#include "cpu_ext_ops.h"
+
+#define PROF_TOP 32
+
+typedef struct {
+    uint64_t count;
+    uint64_t cycles;
+} prof_counter_t;
+
+/* Banked ROM address, key is (bank << 16 | pc) + 1 so 0 marks a free slot. */
+typedef struct {
+    uint32_t key;
+    prof_counter_t counter;
+} prof_pc_t;
+
+typedef struct {
+    prof_counter_t op[256];
+    prof_counter_t ext_op[256];
+    prof_counter_t addr[0x10000]; /* Addresses outside of banked ROM. */
+    prof_pc_t pc[PROF_PC_SLOTS];
+    uint64_t dropped; /* Instructions at addresses that found no free slot. */
+} prof_t;
+
+volatile sig_atomic_t prof_subsys = PROF_CPU;
+bool prof_opcodes;
+
+static prof_t PROF;
+
+static prof_pc_t *prof_find_pc(uint32_t key)
+{
+    /* Fibonacci hashing, linear probing. */
+    uint32_t i = (key * 2654435769u) >> 16;
+    for (unsigned int n = 0; n < PROF_PC_SLOTS; ++n) {
+        prof_pc_t *slot = &PROF.pc[(i + n) % PROF_PC_SLOTS];
+        if (slot->key == key)
+            return slot;
+        if (slot->key == 0) {
+            slot->key = key;
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+void prof_opcode(uint8_t opcode, uint8_t ext, uint16_t pc, unsigned int cycles)
+{
+    prof_counter_t *op = opcode == 0xcb ? &PROF.ext_op[ext] : &PROF.op[opcode];
+    op->count++;
+    op->cycles += cycles;
+    prof_counter_t *counter = &PROF.addr[pc];
+    if (pc >= 0x4000 && pc < 0x8000) {
+        uint32_t key = ((uint32_t)cart_get_rom_bank() << 16 | pc) + 1;
+        prof_pc_t *slot = prof_find_pc(key);
+        if (slot == NULL) {
+            PROF.dropped++;
+            return;
+        }
+        counter = &slot->counter;
+    }
+    counter->count++;
+    counter->cycles += cycles;
+}
+
+void prof_reset(void)
+{
+    memset(&PROF, 0, sizeof(PROF));
+}
+
+/* Order by cycles, most first. */
+static int prof_cmp(const prof_counter_t *a, const prof_counter_t *b)
+{
+    return a->cycles < b->cycles ? 1 : a->cycles > b->cycles ? -1 : 0;
+}
+
+static int prof_cmp_op(const void *a, const void *b)
+{
+    return prof_cmp(*(const prof_counter_t *const *)a,
+                    *(const prof_counter_t *const *)b);
+}
+
+static int prof_cmp_pc(const void *a, const void *b)
+{
+    return prof_cmp(&((const prof_pc_t *)a)->counter,
+                    &((const prof_pc_t *)b)->counter);
+}
+
+static void prof_print(FILE *f, const char *name, const prof_counter_t *c,
+                       uint64_t cycles)
+{
+    fprintf(f, "%-32s %12llu %12llu %6.2f%%\n", name,
+            (unsigned long long)c->count, (unsigned long long)c->cycles,
+            100.0 * (double)c->cycles / (double)cycles);
+}
+
+void prof_dump(FILE *f)
+{
+    const prof_counter_t *ops[512];
+    uint64_t count = 0, cycles = 0;
+    for (int i = 0; i < 256; ++i) {
+        ops[i] = &PROF.op[i];
+        ops[256 + i] = &PROF.ext_op[i];
+        count += PROF.op[i].count + PROF.ext_op[i].count;
+        cycles += PROF.op[i].cycles + PROF.ext_op[i].cycles;
+    }
+    if (count == 0)
+        return;
+    qsort(ops, 512, sizeof(ops[0]), prof_cmp_op);
+    fprintf(f, "Opcode profile: %llu instructions, %llu cycles\n",
+            (unsigned long long)count, (unsigned long long)cycles);
+    fprintf(f, "%-32s %12s %12s %7s\n", "opcode", "count", "cycles", "cycles%");
+    for (int i = 0; i < PROF_TOP && ops[i]->count; ++i) {
+        char name[64];
+        if (ops[i] >= PROF.ext_op)
+            print_ext_ops(name, (uint8_t)(ops[i] - PROF.ext_op));
+        else
+            cpu_print_instr(name, (uint8_t)(ops[i] - PROF.op));
+        prof_print(f, name, ops[i], cycles);
+    }
+    /* Gather both tables in a sorted copy, they stay usable for further
+     * profiling. */
+    size_t used = 0;
+    for (unsigned int i = 0; i < PROF_PC_SLOTS; ++i)
+        used += PROF.pc[i].key != 0;
+    for (uint32_t i = 0; i < 0x10000; ++i)
+        used += PROF.addr[i].count != 0;
+    prof_pc_t *pcs = malloc((used ? used : 1) * sizeof(prof_pc_t));
+    if (pcs == NULL) {
+        perror("malloc address profile");
+        return;
+    }
+    used = 0;
+    for (unsigned int i = 0; i < PROF_PC_SLOTS; ++i) {
+        if (PROF.pc[i].key)
+            pcs[used++] = PROF.pc[i];
+    }
+    for (uint32_t i = 0; i < 0x10000; ++i) {
+        if (PROF.addr[i].count) {
+            pcs[used].key = i + 1;
+            pcs[used++].counter = PROF.addr[i];
+        }
+    }
+    qsort(pcs, used, sizeof(prof_pc_t), prof_cmp_pc);
+    fprintf(f, "Address profile: %zu addresses, %llu dropped\n", used,
+            (unsigned long long)PROF.dropped);
+    fprintf(f, "%-32s %12s %12s %7s\n", "bank:pc", "count", "cycles",
+            "cycles%");
+    for (size_t i = 0; i < used && i < PROF_TOP; ++i) {
+        char name[16];
+        uint32_t key = pcs[i].key - 1;
+        snprintf(name, sizeof(name), "%02x:%04x", key >> 16, key & 0xffff);
+        prof_print(f, name, &pcs[i].counter, cycles);
+    }
+    free(pcs);
+}
+
+typedef struct {
+    uint32_t key; /* bank << 16 | address of the called routine. */
+    uint16_t sp;  /* Where the return address was pushed. */
+} prof_frame_t;
+
+typedef struct {
+    uint64_t count;
+    uint32_t hash;
+    unsigned int depth;
+    uint32_t keys[PROF_STACK_DEPTH];
+} prof_stack_t;
+
+typedef struct {
+    uint32_t key;
+    char *name;
+} prof_sym_t;
+
+typedef struct {
+    prof_frame_t frames[PROF_STACK_DEPTH];
+    unsigned int depth;
+    unsigned int period;
+    unsigned int clock;
+    uint64_t dropped; /* Samples of stacks that found no free slot. */
+    prof_stack_t stacks[PROF_STACK_SLOTS];
+    prof_sym_t *syms;
+    size_t nsyms;
+} prof_stacks_t;
+
+bool prof_stacks;
+
+static prof_stacks_t STACKS;
+
+static uint32_t prof_key(uint16_t addr)
+{
+    unsigned int bank = addr >= 0x4000 && addr < 0x8000 ? cart_get_rom_bank()
+                                                        : 0;
+    return (uint32_t)bank << 16 | addr;
+}
+
+void prof_call(uint16_t pc, uint16_t sp)
+{
+    /* Drop frames whose return address was discarded without a return, e.g.
+     * by resetting SP. The bottom frame is the entry point. */
+    while (STACKS.depth > 1 && STACKS.frames[STACKS.depth - 1].sp <= sp)
+        STACKS.depth--;
+    if (STACKS.depth == PROF_STACK_DEPTH)
+        return;
+    STACKS.frames[STACKS.depth].key = prof_key(pc);
+    STACKS.frames[STACKS.depth].sp = sp;
+    STACKS.depth++;
+}
+
+void prof_ret(uint16_t sp)
+{
+    /* Pop every frame whose return address is now above SP, so returns
+     * from routines that pushed extra words or adjusted SP stay balanced. */
+    while (STACKS.depth > 1 && STACKS.frames[STACKS.depth - 1].sp < sp)
+        STACKS.depth--;
+}
+
+static bool prof_stack_match(const prof_stack_t *stack, uint32_t hash)
+{
+    if (stack->hash != hash || stack->depth != STACKS.depth)
+        return false;
+    for (unsigned int i = 0; i < STACKS.depth; ++i) {
+        if (stack->keys[i] != STACKS.frames[i].key)
+            return false;
+    }
+    return true;
+}
+
+void prof_sample(unsigned int cycles)
+{
+    STACKS.clock += cycles;
+    if (STACKS.clock < STACKS.period)
+        return;
+    STACKS.clock -= STACKS.period;
+    /* FNV-1a over the frames. */
+    uint32_t hash = 2166136261u;
+    for (unsigned int i = 0; i < STACKS.depth; ++i)
+        hash = (hash ^ STACKS.frames[i].key) * 16777619u;
+    for (unsigned int n = 0; n < PROF_STACK_SLOTS; ++n) {
+        prof_stack_t *stack = &STACKS.stacks[(hash + n) % PROF_STACK_SLOTS];
+        if (stack->count == 0) {
+            stack->hash = hash;
+            stack->depth = STACKS.depth;
+            for (unsigned int i = 0; i < STACKS.depth; ++i)
+                stack->keys[i] = STACKS.frames[i].key;
+        } else if (!prof_stack_match(stack, hash)) {
+            continue;
+        }
+        stack->count++;
+        return;
+    }
+    STACKS.dropped++;
+}
+
+static int prof_cmp_sym(const void *a, const void *b)
+{
+    uint32_t ka = ((const prof_sym_t *)a)->key;
+    uint32_t kb = ((const prof_sym_t *)b)->key;
+    return ka < kb ? -1 : ka > kb;
+}
+
+/* Load "bank:address name" lines as written by RGBDS and other assemblers. */
+static int prof_load_syms(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    size_t size = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned int bank, addr;
+        char name[256];
+        if (line[0] == ';' ||
+            sscanf(line, "%x:%x %255s", &bank, &addr, name) != 3)
+            continue;
+        if (STACKS.nsyms == size) {
+            size = size ? size * 2 : 256;
+            STACKS.syms = realloc(STACKS.syms, size * sizeof(prof_sym_t));
+        }
+        STACKS.syms[STACKS.nsyms].key = bank << 16 | (addr & 0xffff);
+        STACKS.syms[STACKS.nsyms++].name = strdup(name);
+    }
+    fclose(f);
+    qsort(STACKS.syms, STACKS.nsyms, sizeof(prof_sym_t), prof_cmp_sym);
+    return 0;
+}
+
+/* Name a frame after the closest symbol at or before it in the same bank. */
+static void prof_print_frame(FILE *f, uint32_t key)
+{
+    size_t lo = 0, hi = STACKS.nsyms;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (STACKS.syms[mid].key <= key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    const prof_sym_t *sym = lo ? &STACKS.syms[lo - 1] : NULL;
+    if (sym == NULL || sym->key >> 16 != key >> 16) {
+        fprintf(f, "%02x:%04x", key >> 16, key & 0xffff);
+    } else if (sym->key == key) {
+        fprintf(f, "%s", sym->name);
+    } else {
+        fprintf(f, "%s+0x%x", sym->name, key - sym->key);
+    }
+}
+
+int prof_stacks_start(unsigned int period, const char *sym_path)
+{
+    for (size_t i = 0; i < STACKS.nsyms; ++i)
+        free(STACKS.syms[i].name);
+    free(STACKS.syms);
+    memset(&STACKS, 0, sizeof(STACKS));
+    if (sym_path && prof_load_syms(sym_path) < 0)
+        return -1;
+    STACKS.period = period ? period : PROF_SAMPLE_CYCLES;
+    /* Execution starts at the cartridge entry point. */
+    STACKS.frames[0].key = 0x0100;
+    STACKS.frames[0].sp = 0xffff;
+    STACKS.depth = 1;
+    prof_stacks = true;
+    return 0;
+}
+
+int prof_stacks_write(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    for (unsigned int i = 0; i < PROF_STACK_SLOTS; ++i) {
+        const prof_stack_t *stack = &STACKS.stacks[i];
+        if (stack->count == 0)
+            continue;
+        for (unsigned int j = 0; j < stack->depth; ++j) {
+            if (j)
+                fputc(';', f);
+            prof_print_frame(f, stack->keys[j]);
+        }
+        fprintf(f, " %llu\n", (unsigned long long)stack->count);
+    }
+    fclose(f);
+    if (STACKS.dropped)
+        fprintf(stderr, "WARNING: %llu stack samples dropped\n",
+                (unsigned long long)STACKS.dropped);
+    return 0;
+}
@@ -0,0 +1,83 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Emulator subsystems that time is attributed to. */
+typedef enum {
+    PROF_CPU = 0,
+    PROF_GPU,
+    PROF_TIMER,
+    PROF_SERIAL,
+    PROF_FRAME, /* Framebuffer presentation and the frame callback. */
+    PROF_MAX,
+} prof_subsys_e;
+
+/* Distinct (bank, PC) banked ROM addresses tracked by the opcode profiler. */
+#define PROF_PC_SLOTS (1 << 16)
+/* Shadow call stack frames kept, deeper calls are not recorded. */
+#define PROF_STACK_DEPTH 64
+/* Distinct call stacks sampled by the stack profiler. */
+#define PROF_STACK_SLOTS (1 << 13)
+/* Default emulated cycles between call stack samples. */
+#define PROF_SAMPLE_CYCLES 4096
+
+#ifdef PROFILE
+/* Subsystem currently running, read by a sampling signal handler. */
+extern volatile sig_atomic_t prof_subsys;
+/* Count executions and cycles per opcode and per guest address. */
+extern bool prof_opcodes;
+/* Track the guest call stack and sample it. */
+extern bool prof_stacks;
+
+/* Account an executed instruction. ext is the CB-prefixed opcode when
+ * opcode is 0xcb. */
+void prof_opcode(uint8_t opcode, uint8_t ext, uint16_t pc, unsigned int cycles);
+void prof_reset(void);
+void prof_dump(FILE *f);
+
+/* Shadow call stack: a call, rst or interrupt dispatch jumped to pc after
+ * pushing the return address at sp, or a return popped the stack to sp. */
+void prof_call(uint16_t pc, uint16_t sp);
+void prof_ret(uint16_t sp);
+/* Account emulated cycles, sample the call stack every period. */
+void prof_sample(unsigned int cycles);
+/* Start the stack profiler, symbolize frames from an optional .sym file. */
+int prof_stacks_start(unsigned int period, const char *sym_path);
+/* Write sampled stacks in folded format, one "frame;frame;... count" line
+ * per distinct stack, outermost frame first. */
+int prof_stacks_write(const char *path);
+
+#define PROF_ENTER(subsys) (prof_subsys = (subsys))
+#define PROF_OPCODE(opcode, ext, pc, cycles)      \
+    do {                                          \
+        if (prof_opcodes)                         \
+            prof_opcode(opcode, ext, pc, cycles); \
+    } while (0)
+#define PROF_CALL(pc, sp)      \
+    do {                       \
+        if (prof_stacks)       \
+            prof_call(pc, sp); \
+    } while (0)
+#define PROF_RET(sp)      \
+    do {                  \
+        if (prof_stacks)  \
+            prof_ret(sp); \
+    } while (0)
+#define PROF_SAMPLE(cycles)      \
+    do {                         \
+        if (prof_stacks)         \
+            prof_sample(cycles); \
+    } while (0)
+#else
+#define PROF_ENTER(subsys) ((void)0)
+#define PROF_OPCODE(opcode, ext, pc, cycles) ((void)0)
+#define PROF_CALL(pc, sp) ((void)0)
+#define PROF_RET(sp) ((void)0)
+#define PROF_SAMPLE(cycles) ((void)0)
+#endif
+
+#endif /* PROFILE_H */
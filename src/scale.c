@@ -0,0 +1,346 @@
+#include "scale.h"
+#include <stdbool.h>
+#include <string.h>
+#include "gpu.h"
+
+#define W GB_SCREEN_WIDTH
+#define H GB_SCREEN_HEIGHT
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCALE_X86
+#endif
+
+static const char *scale_names[SCALE_MAX] = {"nearest", "scale2x", "scale3x",
+                                             "xbr"};
+
+static scale_simd_e scale_simd = SCALE_SIMD_NONE;
+static bool scale_simd_set;
+
+typedef struct {
+    uint32_t a, b, c, d, e, f, g, h, i;
+} scale_kernel_t;
+
+/* 3x3 neighbourhood of (x, y), edge pixels repeated:
+ *   A B C
+ *   D E F
+ *   G H I */
+static scale_kernel_t scale_kernel(const uint32_t *src, unsigned int x,
+                                   unsigned int y)
+{
+    const uint32_t *up = &src[(y ? y - 1 : 0) * W];
+    const uint32_t *cur = &src[y * W];
+    const uint32_t *down = &src[(y + 1 < H ? y + 1 : y) * W];
+    unsigned int l = x ? x - 1 : 0;
+    unsigned int r = x + 1 < W ? x + 1 : x;
+    scale_kernel_t k = {up[l],  up[x],  up[r],   cur[l],  cur[x],
+                        cur[r], down[l], down[x], down[r]};
+    return k;
+}
+
+static void scale2x_px(const uint32_t *src, uint32_t *dst, unsigned int x,
+                       unsigned int y)
+{
+    scale_kernel_t k = scale_kernel(src, x, y);
+    uint32_t *d0 = &dst[(y * 2 * W + x) * 2];
+    uint32_t *d1 = d0 + 2 * W;
+    bool bad = k.b == k.h || k.d == k.f;
+    d0[0] = !bad && k.d == k.b ? k.d : k.e;
+    d0[1] = !bad && k.b == k.f ? k.f : k.e;
+    d1[0] = !bad && k.d == k.h ? k.d : k.e;
+    d1[1] = !bad && k.h == k.f ? k.f : k.e;
+}
+
+static void scale3x_px(const uint32_t *src, uint32_t *dst, unsigned int x,
+                       unsigned int y)
+{
+    scale_kernel_t k = scale_kernel(src, x, y);
+    uint32_t *d0 = &dst[(y * 3 * W + x) * 3];
+    uint32_t *d1 = d0 + 3 * W;
+    uint32_t *d2 = d1 + 3 * W;
+    bool c_db = k.d == k.b && k.b != k.f && k.d != k.h;
+    bool c_bf = k.b == k.f && k.b != k.d && k.f != k.h;
+    bool c_dh = k.d == k.h && k.d != k.b && k.h != k.f;
+    bool c_hf = k.h == k.f && k.d != k.h && k.b != k.f;
+    d0[0] = c_db ? k.d : k.e;
+    d0[1] = (c_db && k.e != k.c) || (c_bf && k.e != k.a) ? k.b : k.e;
+    d0[2] = c_bf ? k.f : k.e;
+    d1[0] = (c_db && k.e != k.g) || (c_dh && k.e != k.a) ? k.d : k.e;
+    d1[1] = k.e;
+    d1[2] = (c_bf && k.e != k.i) || (c_hf && k.e != k.c) ? k.f : k.e;
+    d2[0] = c_dh ? k.d : k.e;
+    d2[1] = (c_dh && k.e != k.i) || (c_hf && k.e != k.g) ? k.h : k.e;
+    d2[2] = c_hf ? k.f : k.e;
+}
+
+/* Sum of the absolute byte differences. */
+static uint32_t xbr_dist(uint32_t a, uint32_t b)
+{
+    uint32_t d = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        int ca = (a >> shift) & 0xff, cb = (b >> shift) & 0xff;
+        d += (uint32_t)(ca > cb ? ca - cb : cb - ca);
+    }
+    return d;
+}
+
+/* Per byte average, rounded up. */
+static uint32_t xbr_avg(uint32_t a, uint32_t b)
+{
+    return (a | b) - (((a ^ b) >> 1) & 0x7f7f7f7f);
+}
+
+/* Blend the corner of E towards x with its neighbours p and q when the edge
+ * p-q is stronger than the one across E-x, as xBR does with its 5x5 weights
+ * cut down to the 3x3 neighbourhood. s1, s2 are the other pixels diagonal
+ * to E next to p and q, p_opp and q_opp the neighbours opposite p and q. */
+static uint32_t xbr_corner(uint32_t e, uint32_t x, uint32_t p, uint32_t q,
+                           uint32_t s1, uint32_t s2, uint32_t p_opp,
+                           uint32_t q_opp)
+{
+    uint32_t wd1 = xbr_dist(e, s1) + xbr_dist(e, s2) + 4 * xbr_dist(p, q);
+    uint32_t wd2 =
+        xbr_dist(p, q_opp) + xbr_dist(q, p_opp) + 4 * xbr_dist(e, x);
+    if (wd1 >= wd2)
+        return e;
+    return xbr_avg(e, xbr_dist(e, p) <= xbr_dist(e, q) ? p : q);
+}
+
+static void xbr_px(const uint32_t *src, uint32_t *dst, unsigned int x,
+                   unsigned int y)
+{
+    scale_kernel_t k = scale_kernel(src, x, y);
+    uint32_t *d0 = &dst[(y * 2 * W + x) * 2];
+    uint32_t *d1 = d0 + 2 * W;
+    d0[0] = xbr_corner(k.e, k.a, k.d, k.b, k.g, k.c, k.f, k.h);
+    d0[1] = xbr_corner(k.e, k.c, k.f, k.b, k.i, k.a, k.d, k.h);
+    d1[0] = xbr_corner(k.e, k.g, k.d, k.h, k.a, k.i, k.f, k.b);
+    d1[1] = xbr_corner(k.e, k.i, k.f, k.h, k.c, k.g, k.d, k.b);
+}
+
+#ifdef SCALE_X86
+static void zip_sse2(__m128i a, __m128i b, __m128i *lo, __m128i *hi)
+{
+    *lo = _mm_unpacklo_epi32(a, b);
+    *hi = _mm_unpackhi_epi32(a, b);
+}
+
+/* Store a0 b0 c0 a1 b1 c1 a2 b2 c2 a3 b3 c3. */
+static void store3_sse2(uint32_t *dst, __m128i a, __m128i b, __m128i c)
+{
+    __m128i a1 = _mm_srli_si128(a, 4);
+    __m128i ab_lo = _mm_unpacklo_epi32(a, b);   /* a0 b0 a1 b1 */
+    __m128i ab_hi = _mm_unpackhi_epi32(a, b);   /* a2 b2 a3 b3 */
+    __m128i ca_lo = _mm_unpacklo_epi32(c, a1);  /* c0 a1 c1 a2 */
+    __m128i ca_hi = _mm_unpackhi_epi32(c, a1);  /* c2 a3 c3 0 */
+    __m128i bc_lo = _mm_unpacklo_epi32(_mm_srli_si128(b, 4),
+                                       _mm_srli_si128(c, 4)); /* b1 c1 */
+    __m128i bc_hi = _mm_unpackhi_epi32(b, c);   /* b2 c2 b3 c3 */
+    __m128 v0 = _mm_shuffle_ps(_mm_castsi128_ps(ab_lo), _mm_castsi128_ps(ca_lo),
+                               _MM_SHUFFLE(1, 0, 1, 0));
+    __m128 v1 = _mm_shuffle_ps(_mm_castsi128_ps(bc_lo), _mm_castsi128_ps(ab_hi),
+                               _MM_SHUFFLE(1, 0, 1, 0));
+    __m128 v2 = _mm_shuffle_ps(_mm_castsi128_ps(ca_hi), _mm_castsi128_ps(bc_hi),
+                               _MM_SHUFFLE(3, 2, 1, 0));
+    _mm_storeu_si128((__m128i *)dst, _mm_castps_si128(v0));
+    _mm_storeu_si128((__m128i *)(dst + 4), _mm_castps_si128(v1));
+    _mm_storeu_si128((__m128i *)(dst + 8), _mm_castps_si128(v2));
+}
+
+#define VEC __m128i
+#define VN 4
+#define SIMD(name) name##_sse2
+#define V_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define V_STORE(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#define V_SET1(x) _mm_set1_epi32(x)
+#define V_EQ(a, b) _mm_cmpeq_epi32(a, b)
+#define V_GT(a, b) _mm_cmpgt_epi32(a, b)
+#define V_AND(a, b) _mm_and_si128(a, b)
+#define V_ANDNOT(a, b) _mm_andnot_si128(a, b)
+#define V_OR(a, b) _mm_or_si128(a, b)
+#define V_ADD(a, b) _mm_add_epi32(a, b)
+#define V_SRL(a, n) _mm_srli_epi32(a, n)
+#define V_SLL(a, n) _mm_slli_epi32(a, n)
+#define V_SUBS8(a, b) _mm_subs_epu8(a, b)
+#define V_AVG8(a, b) _mm_avg_epu8(a, b)
+#include "scale_simd.h"
+#undef VEC
+#undef VN
+#undef SIMD
+#undef V_LOAD
+#undef V_STORE
+#undef V_SET1
+#undef V_EQ
+#undef V_GT
+#undef V_AND
+#undef V_ANDNOT
+#undef V_OR
+#undef V_ADD
+#undef V_SRL
+#undef V_SLL
+#undef V_SUBS8
+#undef V_AVG8
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+static void zip_avx2(__m256i a, __m256i b, __m256i *lo, __m256i *hi)
+{
+    /* Unpack works within 128 bit lanes, put the lanes back in order. */
+    __m256i l = _mm256_unpacklo_epi32(a, b);
+    __m256i h = _mm256_unpackhi_epi32(a, b);
+    *lo = _mm256_permute2x128_si256(l, h, 0x20);
+    *hi = _mm256_permute2x128_si256(l, h, 0x31);
+}
+
+static void store3_avx2(uint32_t *dst, __m256i a, __m256i b, __m256i c)
+{
+    store3_sse2(dst, _mm256_castsi256_si128(a), _mm256_castsi256_si128(b),
+                _mm256_castsi256_si128(c));
+    store3_sse2(dst + 12, _mm256_extracti128_si256(a, 1),
+                _mm256_extracti128_si256(b, 1),
+                _mm256_extracti128_si256(c, 1));
+}
+
+#define VEC __m256i
+#define VN 8
+#define SIMD(name) name##_avx2
+#define V_LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define V_STORE(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+#define V_SET1(x) _mm256_set1_epi32(x)
+#define V_EQ(a, b) _mm256_cmpeq_epi32(a, b)
+#define V_GT(a, b) _mm256_cmpgt_epi32(a, b)
+#define V_AND(a, b) _mm256_and_si256(a, b)
+#define V_ANDNOT(a, b) _mm256_andnot_si256(a, b)
+#define V_OR(a, b) _mm256_or_si256(a, b)
+#define V_ADD(a, b) _mm256_add_epi32(a, b)
+#define V_SRL(a, n) _mm256_srli_epi32(a, n)
+#define V_SLL(a, n) _mm256_slli_epi32(a, n)
+#define V_SUBS8(a, b) _mm256_subs_epu8(a, b)
+#define V_AVG8(a, b) _mm256_avg_epu8(a, b)
+#include "scale_simd.h"
+#pragma GCC pop_options
+#endif /* SCALE_X86 */
+
+int scale_parse(const char *name, scale_filter_e *filter)
+{
+    for (int i = 0; i < SCALE_MAX; ++i) {
+        if (strcmp(name, scale_names[i]) == 0) {
+            *filter = (scale_filter_e)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *scale_name(scale_filter_e filter)
+{
+    return scale_names[filter];
+}
+
+unsigned int scale_factor(scale_filter_e filter, unsigned int nearest)
+{
+    switch (filter) {
+        case SCALE_SCALE2X:
+        case SCALE_XBR:
+            return 2;
+        case SCALE_SCALE3X:
+            return 3;
+        default:
+            return nearest ? nearest : 1;
+    }
+}
+
+scale_simd_e scale_simd_max(void)
+{
+#ifdef SCALE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SCALE_SIMD_AVX2;
+#ifdef __SSE2__
+    return SCALE_SIMD_SSE2;
+#endif
+#endif
+    return SCALE_SIMD_NONE;
+}
+
+void scale_set_simd(scale_simd_e simd)
+{
+    scale_simd_e max = scale_simd_max();
+    scale_simd = simd < max ? simd : max;
+    scale_simd_set = true;
+}
+
+static void scale_nearest(const uint32_t *src, uint32_t *dst,
+                          unsigned int factor)
+{
+    unsigned int pitch = W * factor;
+    for (unsigned int y = 0; y < H; ++y) {
+        const uint32_t *in = &src[y * W];
+        uint32_t *out = &dst[y * factor * pitch];
+#ifdef SCALE_X86
+        if (factor >= 2 && factor <= 4 && scale_simd == SCALE_SIMD_AVX2) {
+            nearest_row_avx2(in, out, factor);
+        } else if (factor >= 2 && factor <= 4 && scale_simd) {
+            nearest_row_sse2(in, out, factor);
+        } else
+#endif
+        {
+            for (unsigned int x = 0; x < W; ++x) {
+                for (unsigned int i = 0; i < factor; ++i)
+                    out[x * factor + i] = in[x];
+            }
+        }
+        for (unsigned int i = 1; i < factor; ++i)
+            memcpy(&out[i * pitch], out, pitch * sizeof(uint32_t));
+    }
+}
+
+typedef unsigned int (*scale_row_t)(const uint32_t *src, uint32_t *dst,
+                                    unsigned int y);
+typedef void (*scale_px_t)(const uint32_t *src, uint32_t *dst, unsigned int x,
+                           unsigned int y);
+
+/* Run the SIMD row kernel, then the plain C filter on the edges. */
+static void scale_rows(const uint32_t *src, uint32_t *dst, scale_row_t row,
+                       scale_px_t px)
+{
+    for (unsigned int y = 0; y < H; ++y) {
+        unsigned int x = row ? row(src, dst, y) : 1;
+        px(src, dst, 0, y);
+        for (; x < W; ++x)
+            px(src, dst, x, y);
+    }
+}
+
+void scale_frame(scale_filter_e filter, unsigned int factor,
+                 const uint32_t *in, uint32_t *out)
+{
+    if (!scale_simd_set)
+        scale_set_simd(SCALE_SIMD_AVX2);
+    scale_row_t row[SCALE_MAX] = {NULL};
+#ifdef SCALE_X86
+    if (scale_simd == SCALE_SIMD_AVX2) {
+        row[SCALE_SCALE2X] = scale2x_row_avx2;
+        row[SCALE_SCALE3X] = scale3x_row_avx2;
+        row[SCALE_XBR] = xbr_row_avx2;
+    } else if (scale_simd == SCALE_SIMD_SSE2) {
+        row[SCALE_SCALE2X] = scale2x_row_sse2;
+        row[SCALE_SCALE3X] = scale3x_row_sse2;
+        row[SCALE_XBR] = xbr_row_sse2;
+    }
+#endif
+    switch (filter) {
+        case SCALE_SCALE2X:
+            scale_rows(in, out, row[filter], scale2x_px);
+            break;
+        case SCALE_SCALE3X:
+            scale_rows(in, out, row[filter], scale3x_px);
+            break;
+        case SCALE_XBR:
+            scale_rows(in, out, row[filter], xbr_px);
+            break;
+        default:
+            scale_nearest(in, out, factor);
+            break;
+    }
+}
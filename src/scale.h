@@ -0,0 +1,38 @@
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <stdint.h>
+
+/* Integer upscalers of a GB_SCREEN_WIDTH x GB_SCREEN_HEIGHT frame of 32 bit
+ * pixels, for the window and for captures. The output is factor times wider
+ * and higher. */
+
+typedef enum {
+    SCALE_NEAREST = 0, /* Pixel replication, any factor. */
+    SCALE_SCALE2X = 1, /* Scale2x (AdvMAME2x), factor 2. */
+    SCALE_SCALE3X = 2, /* Scale3x (AdvMAME3x), factor 3. */
+    SCALE_XBR = 3,     /* xBR on a 3x3 neighbourhood, factor 2. */
+    SCALE_MAX,
+} scale_filter_e;
+
+typedef enum {
+    SCALE_SIMD_NONE = 0,
+    SCALE_SIMD_SSE2 = 1,
+    SCALE_SIMD_AVX2 = 2,
+} scale_simd_e;
+
+/* Filter by name: nearest, scale2x, scale3x or xbr. Returns -1 if unknown. */
+int scale_parse(const char *name, scale_filter_e *filter);
+const char *scale_name(scale_filter_e filter);
+/* Output factor of a filter, nearest scales by the factor asked for. */
+unsigned int scale_factor(scale_filter_e filter, unsigned int nearest);
+/* Best instruction set of this build and CPU, the default. */
+scale_simd_e scale_simd_max(void);
+/* Restrict the instruction set, e.g. to compare against plain C. */
+void scale_set_simd(scale_simd_e simd);
+/* Scale src into dst, of GB_SCREEN_WIDTH * GB_SCREEN_HEIGHT * factor^2
+ * pixels, factor as given by scale_factor(). */
+void scale_frame(scale_filter_e filter, unsigned int factor,
+                 const uint32_t *src, uint32_t *dst);
+
+#endif /* SCALE_H */
@@ -0,0 +1,166 @@
+/* Row kernels of the upscalers, written once for every instruction set.
+ * scale.c includes this file after defining VEC, VN (pixels per vector),
+ * the V_ operations, the zip and store3 helpers, and SIMD(name) to give the
+ * functions a per instruction set name. Each row kernel handles the pixels
+ * from x = 1 for as long as whole vectors fit with their right neighbour,
+ * and returns the first x left to the plain C code. The results match the
+ * plain C filters bit for bit. */
+
+typedef struct {
+    VEC a, b, c, d, e, f, g, h, i;
+} SIMD(kernel_t);
+
+static VEC SIMD(sel)(VEC mask, VEC a, VEC b)
+{
+    return V_OR(V_AND(mask, a), V_ANDNOT(mask, b));
+}
+
+/* 3x3 neighbourhood of VN pixels from (x, y), rows repeated at the edges. */
+static SIMD(kernel_t) SIMD(kernel)(const uint32_t *src, unsigned int x,
+                                   unsigned int y)
+{
+    const uint32_t *up = &src[(y ? y - 1 : 0) * W];
+    const uint32_t *cur = &src[y * W];
+    const uint32_t *down = &src[(y + 1 < H ? y + 1 : y) * W];
+    SIMD(kernel_t) k;
+    k.a = V_LOAD(up + x - 1);
+    k.b = V_LOAD(up + x);
+    k.c = V_LOAD(up + x + 1);
+    k.d = V_LOAD(cur + x - 1);
+    k.e = V_LOAD(cur + x);
+    k.f = V_LOAD(cur + x + 1);
+    k.g = V_LOAD(down + x - 1);
+    k.h = V_LOAD(down + x);
+    k.i = V_LOAD(down + x + 1);
+    return k;
+}
+
+/* Replicate a row 2, 3 or 4 times horizontally. */
+static void SIMD(nearest_row)(const uint32_t *src, uint32_t *dst,
+                              unsigned int factor)
+{
+    for (unsigned int x = 0; x < W; x += VN) {
+        VEC v = V_LOAD(src + x);
+        uint32_t *out = dst + x * factor;
+        VEC lo, hi, a, b;
+        if (factor == 3) {
+            SIMD(store3)(out, v, v, v);
+            continue;
+        }
+        SIMD(zip)(v, v, &lo, &hi);
+        if (factor == 2) {
+            V_STORE(out, lo);
+            V_STORE(out + VN, hi);
+            continue;
+        }
+        SIMD(zip)(lo, lo, &a, &b);
+        V_STORE(out, a);
+        V_STORE(out + VN, b);
+        SIMD(zip)(hi, hi, &a, &b);
+        V_STORE(out + 2 * VN, a);
+        V_STORE(out + 3 * VN, b);
+    }
+}
+
+static unsigned int SIMD(scale2x_row)(const uint32_t *src, uint32_t *dst,
+                                      unsigned int y)
+{
+    uint32_t *d0 = &dst[y * 4 * W];
+    uint32_t *d1 = d0 + 2 * W;
+    unsigned int x = 1;
+    for (; x + VN < W; x += VN) {
+        SIMD(kernel_t) k = SIMD(kernel)(src, x, y);
+        VEC bad = V_OR(V_EQ(k.b, k.h), V_EQ(k.d, k.f));
+        VEC e0 = SIMD(sel)(V_ANDNOT(bad, V_EQ(k.d, k.b)), k.d, k.e);
+        VEC e1 = SIMD(sel)(V_ANDNOT(bad, V_EQ(k.b, k.f)), k.f, k.e);
+        VEC e2 = SIMD(sel)(V_ANDNOT(bad, V_EQ(k.d, k.h)), k.d, k.e);
+        VEC e3 = SIMD(sel)(V_ANDNOT(bad, V_EQ(k.h, k.f)), k.f, k.e);
+        VEC lo, hi;
+        SIMD(zip)(e0, e1, &lo, &hi);
+        V_STORE(d0 + 2 * x, lo);
+        V_STORE(d0 + 2 * x + VN, hi);
+        SIMD(zip)(e2, e3, &lo, &hi);
+        V_STORE(d1 + 2 * x, lo);
+        V_STORE(d1 + 2 * x + VN, hi);
+    }
+    return x;
+}
+
+static unsigned int SIMD(scale3x_row)(const uint32_t *src, uint32_t *dst,
+                                      unsigned int y)
+{
+    uint32_t *d0 = &dst[y * 9 * W];
+    uint32_t *d1 = d0 + 3 * W;
+    uint32_t *d2 = d1 + 3 * W;
+    unsigned int x = 1;
+    for (; x + VN < W; x += VN) {
+        SIMD(kernel_t) k = SIMD(kernel)(src, x, y);
+        VEC db = V_EQ(k.d, k.b), bf = V_EQ(k.b, k.f);
+        VEC dh = V_EQ(k.d, k.h), hf = V_EQ(k.h, k.f);
+        VEC ea = V_EQ(k.e, k.a), ec = V_EQ(k.e, k.c);
+        VEC eg = V_EQ(k.e, k.g), ei = V_EQ(k.e, k.i);
+        VEC c_db = V_ANDNOT(V_OR(bf, dh), db);
+        VEC c_bf = V_ANDNOT(V_OR(db, hf), bf);
+        VEC c_dh = V_ANDNOT(V_OR(db, hf), dh);
+        VEC c_hf = V_ANDNOT(V_OR(dh, bf), hf);
+        VEC e0 = SIMD(sel)(c_db, k.d, k.e);
+        VEC e1 = SIMD(sel)(V_OR(V_ANDNOT(ec, c_db), V_ANDNOT(ea, c_bf)), k.b,
+                           k.e);
+        VEC e2 = SIMD(sel)(c_bf, k.f, k.e);
+        VEC e3 = SIMD(sel)(V_OR(V_ANDNOT(eg, c_db), V_ANDNOT(ea, c_dh)), k.d,
+                           k.e);
+        VEC e5 = SIMD(sel)(V_OR(V_ANDNOT(ei, c_bf), V_ANDNOT(ec, c_hf)), k.f,
+                           k.e);
+        VEC e6 = SIMD(sel)(c_dh, k.d, k.e);
+        VEC e7 = SIMD(sel)(V_OR(V_ANDNOT(ei, c_dh), V_ANDNOT(eg, c_hf)), k.h,
+                           k.e);
+        VEC e8 = SIMD(sel)(c_hf, k.f, k.e);
+        SIMD(store3)(d0 + 3 * x, e0, e1, e2);
+        SIMD(store3)(d1 + 3 * x, e3, k.e, e5);
+        SIMD(store3)(d2 + 3 * x, e6, e7, e8);
+    }
+    return x;
+}
+
+/* Sum of the absolute byte differences of each pixel. */
+static VEC SIMD(dist)(VEC a, VEC b)
+{
+    VEC ad = V_OR(V_SUBS8(a, b), V_SUBS8(b, a));
+    VEC m8 = V_SET1(0x00ff00ff);
+    VEC s = V_ADD(V_AND(ad, m8), V_AND(V_SRL(ad, 8), m8));
+    return V_ADD(V_AND(s, V_SET1(0xffff)), V_SRL(s, 16));
+}
+
+static VEC SIMD(xbr_corner)(VEC e, VEC x, VEC p, VEC q, VEC s1, VEC s2,
+                            VEC p_opp, VEC q_opp)
+{
+    VEC wd1 = V_ADD(V_ADD(SIMD(dist)(e, s1), SIMD(dist)(e, s2)),
+                    V_SLL(SIMD(dist)(p, q), 2));
+    VEC wd2 = V_ADD(V_ADD(SIMD(dist)(p, q_opp), SIMD(dist)(q, p_opp)),
+                    V_SLL(SIMD(dist)(e, x), 2));
+    VEC near = SIMD(sel)(V_GT(SIMD(dist)(e, p), SIMD(dist)(e, q)), q, p);
+    return SIMD(sel)(V_GT(wd2, wd1), V_AVG8(e, near), e);
+}
+
+static unsigned int SIMD(xbr_row)(const uint32_t *src, uint32_t *dst,
+                                  unsigned int y)
+{
+    uint32_t *d0 = &dst[y * 4 * W];
+    uint32_t *d1 = d0 + 2 * W;
+    unsigned int x = 1;
+    for (; x + VN < W; x += VN) {
+        SIMD(kernel_t) k = SIMD(kernel)(src, x, y);
+        VEC e0 = SIMD(xbr_corner)(k.e, k.a, k.d, k.b, k.g, k.c, k.f, k.h);
+        VEC e1 = SIMD(xbr_corner)(k.e, k.c, k.f, k.b, k.i, k.a, k.d, k.h);
+        VEC e2 = SIMD(xbr_corner)(k.e, k.g, k.d, k.h, k.a, k.i, k.f, k.b);
+        VEC e3 = SIMD(xbr_corner)(k.e, k.i, k.f, k.h, k.c, k.g, k.d, k.b);
+        VEC lo, hi;
+        SIMD(zip)(e0, e1, &lo, &hi);
+        V_STORE(d0 + 2 * x, lo);
+        V_STORE(d0 + 2 * x + VN, hi);
+        SIMD(zip)(e2, e3, &lo, &hi);
+        V_STORE(d1 + 2 * x, lo);
+        V_STORE(d1 + 2 * x + VN, hi);
+    }
+    return x;
+}
@@ -0,0 +1,114 @@
+#include "serial.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include "cartridge/cart.h"
+#include "interrupt.h"
+
+#define SC_START (1 << 7)
+#define SC_FAST (1 << 1) /* CGB only */
+#define SC_INTERNAL (1 << 0)
+
+/* Clocks per transferred byte: the serial clock is a CPU clock divider, so
+ * this holds in double speed too. */
+#define SERIAL_CLOCKS 4096
+#define SERIAL_CLOCKS_FAST 128
+
+/* Clocks between checks for a transfer clocked by the peer. */
+#define SERIAL_POLL_CLOCKS 512
+
+typedef struct {
+    uint8_t sb;          /* [$ff01] Serial transfer data (R/W) */
+    uint8_t sc;          /* [$ff02] Serial Transfer Control (R/W) */
+    uint32_t clock;      /* Clocks left for the current transfer. */
+    uint32_t poll_clock; /* Clocks since the last peer check. */
+    serial_link_t *link; /* Link cable, NULL if unplugged. */
+} serial_t;
+
+static serial_t SERIAL;
+
+void serial_reset(void)
+{
+    SERIAL.sb = 0;
+    SERIAL.sc = 0;
+    SERIAL.clock = 0;
+    SERIAL.poll_clock = 0;
+}
+
+static void serial_complete(int in)
+{
+    SERIAL.sb = in < 0 ? 0xff : (uint8_t)in;
+    SERIAL.sc &= (uint8_t)~SC_START;
+    interrupt_raise(INTERRUPTS_SERIAL);
+}
+
+/* Answer a transfer clocked by the peer. Only a started transfer takes the
+ * byte, otherwise the peer reads a disconnected line. */
+static void serial_poll(void)
+{
+    bool ready = (SERIAL.sc & (SC_START | SC_INTERNAL)) == SC_START;
+    int in = SERIAL.link->poll(SERIAL.link, ready ? SERIAL.sb : 0xff);
+    if (in >= 0 && ready)
+        serial_complete(in);
+}
+
+void serial_step(uint32_t clock_step)
+{
+    if (SERIAL.clock) {
+        if (clock_step < SERIAL.clock) {
+            SERIAL.clock -= clock_step;
+        } else {
+            SERIAL.clock = 0;
+            int in = -1;
+            if (SERIAL.link)
+                in = SERIAL.link->transfer(SERIAL.link, SERIAL.sb);
+            serial_complete(in);
+        }
+    } else if (SERIAL.link) {
+        SERIAL.poll_clock += clock_step;
+        if (SERIAL.poll_clock >= SERIAL_POLL_CLOCKS) {
+            SERIAL.poll_clock = 0;
+            serial_poll();
+        }
+    }
+}
+
+uint8_t serial_read_sb(void)
+{
+    return SERIAL.sb;
+}
+
+uint8_t serial_read_sc(void)
+{
+    return SERIAL.sc | (cart_is_cgb() ? 0x7c : 0x7e);
+}
+
+void serial_write_sb(uint8_t val)
+{
+    SERIAL.sb = val;
+}
+
+void serial_write_sc(uint8_t val)
+{
+    SERIAL.sc = val & (SC_START | SC_FAST | SC_INTERNAL);
+    if ((val & (SC_START | SC_INTERNAL)) == (SC_START | SC_INTERNAL)) {
+        /* Internal clock: this side drives the transfer. */
+        bool fast = cart_is_cgb() && (val & SC_FAST);
+        SERIAL.clock = fast ? SERIAL_CLOCKS_FAST : SERIAL_CLOCKS;
+    } else {
+        SERIAL.clock = 0;
+    }
+}
+
+void serial_set_link(serial_link_t *link)
+{
+    SERIAL.link = link;
+    SERIAL.poll_clock = 0;
+}
+
+void serial_dump(void)
+{
+    printf("Serial dump:\n");
+    printf("[$ff01] sb=0x%.2hhx\n", SERIAL.sb);
+    printf("[$ff02] sc=0x%.2hhx\n", SERIAL.sc);
+    printf("clock=%u link=%s\n", SERIAL.clock, SERIAL.link ? "yes" : "no");
+}
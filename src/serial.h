@@ -0,0 +1,33 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+
+/* How long the clocking side waits for the peer's answer, in host time: the
+ * emulation stops meanwhile. */
+#define SERIAL_LINK_TIMEOUT_MS 100
+
+/* Link cable. A side that clocks a transfer calls transfer() with its SB, the
+ * other side answers in poll(). Both return the byte received from the peer,
+ * or -1 if there is none. */
+typedef struct serial_link serial_link_t;
+struct serial_link {
+    int (*transfer)(serial_link_t *link, uint8_t out);
+    int (*poll)(serial_link_t *link, uint8_t out);
+    void (*close)(serial_link_t *link);
+};
+
+void serial_reset(void);
+void serial_step(uint32_t clock_step);
+
+uint8_t serial_read_sb(void);
+uint8_t serial_read_sc(void);
+
+void serial_write_sb(uint8_t val);
+void serial_write_sc(uint8_t val);
+
+/* Plug a link cable, NULL to unplug. */
+void serial_set_link(serial_link_t *link);
+void serial_dump(void);
+
+#endif /* SERIAL_H */
@@ -0,0 +1,83 @@
+#include "trace.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+trace_t TRACE;
+
+static const char *crash_path;
+
+void trace_enable(bool enable)
+{
+    TRACE.enabled = enable;
+}
+
+void trace_reset(void)
+{
+    TRACE.count = 0;
+}
+
+/* Write the ring oldest entry first. Only uses async-signal-safe calls. */
+static int trace_write(int fd)
+{
+    uint64_t count = TRACE.count;
+    uint32_t n = count < TRACE_ENTRIES ? (uint32_t)count : TRACE_ENTRIES;
+    trace_header_t header = {.entry_size = sizeof(trace_entry_t), .count = n};
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    size_t first = (size_t)((count - n) & (TRACE_ENTRIES - 1));
+    size_t tail = TRACE_ENTRIES - first < n ? TRACE_ENTRIES - first : n;
+    if (write(fd, &header, sizeof(header)) != sizeof(header) ||
+        write(fd, &TRACE.ring[first], tail * sizeof(trace_entry_t)) < 0 ||
+        write(fd, TRACE.ring, (n - tail) * sizeof(trace_entry_t)) < 0)
+        return -1;
+    return 0;
+}
+
+int trace_dump(const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    int ret = trace_write(fd);
+    if (ret < 0)
+        perror(path);
+    close(fd);
+    return ret;
+}
+
+static void trace_puts(const char *str)
+{
+    ssize_t rv = write(STDERR_FILENO, str, strlen(str));
+    (void)rv;
+}
+
+static void trace_crash(int sig)
+{
+    int fd = open(crash_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        if (trace_write(fd) == 0) {
+            trace_puts("Execution trace written to: ");
+            trace_puts(crash_path);
+            trace_puts("\n");
+        }
+        close(fd);
+    }
+    /* The handler was reset, die with the original signal. */
+    raise(sig);
+}
+
+void trace_catch_crash(const char *path)
+{
+    static const int signals[] = {SIGABRT, SIGSEGV, SIGBUS, SIGILL, SIGFPE};
+    crash_path = path;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = trace_crash;
+    sa.sa_flags = (int)SA_RESETHAND;
+    for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); ++i)
+        sigaction(signals[i], &sa, NULL);
+}
@@ -0,0 +1,58 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Instructions kept in the execution trace ring, a power of two. */
+#define TRACE_ENTRIES (1 << 16)
+#define TRACE_MAGIC "GBTRACE1"
+/* Default trace file of crash and on demand dumps. */
+#define TRACE_PATH "gusgb.trace"
+
+/* CPU state before an instruction executes. */
+typedef struct {
+    uint32_t cycles; /* Low 32 bits of the emulated cycle count. */
+    uint16_t pc;
+    uint16_t sp;
+    uint16_t af;
+    uint16_t bc;
+    uint16_t de;
+    uint16_t hl;
+    uint8_t opcode;
+    uint8_t operand[2];
+    uint8_t bank; /* Low 8 bits of the ROM bank, if pc is in 0x4000-0x7fff. */
+} trace_entry_t;
+
+/* Trace file: header followed by count entries, oldest first. */
+typedef struct {
+    char magic[8];
+    uint32_t entry_size;
+    uint32_t count;
+} trace_header_t;
+
+typedef struct {
+    bool enabled;
+    uint64_t count; /* Instructions traced since reset. */
+    trace_entry_t ring[TRACE_ENTRIES];
+} trace_t;
+
+extern trace_t TRACE;
+
+/* Slot for the next instruction, NULL when tracing is disabled. */
+static inline trace_entry_t *trace_next(void)
+{
+    if (!TRACE.enabled)
+        return NULL;
+    return &TRACE.ring[TRACE.count++ & (TRACE_ENTRIES - 1)];
+}
+
+void trace_enable(bool enable);
+void trace_reset(void);
+/* Write the ring to path, returns 0 on success, -1 on error. */
+int trace_dump(const char *path);
+/* Dump the ring to path when the emulator crashes or aborts. */
+void trace_catch_crash(const char *path);
+
+#endif /* TRACE_H */
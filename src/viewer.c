@@ -0,0 +1,397 @@
+#include "viewer.h"
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cartridge/cart.h"
+#include "gpu.h"
+
+/* Sheet layout, in pixels. */
+#define TILES_BANK_X 136 /* Bank 1 tile set. */
+#define PAL_X 272
+#define PAL_OBJ_X 312
+#define OAM_X 272
+#define OAM_Y 72
+#define OAM_CELL_W 10
+#define OAM_CELL_H 18
+#define MAPS_Y 200
+#define MAP_1_X 264 /* Map 0x9c00. */
+
+#define COLOR_BACK 0xff202020
+#define COLOR_CELL 0xff404040
+#define COLOR_SCREEN 0xffff0000
+#define COLOR_WINDOW 0xff00c0ff
+
+/* GPU state the sheet is drawn from. */
+typedef struct {
+    uint8_t vram[2][0x2000];
+    uint8_t oam[0xa0];
+    color_t bg_palette[8 * 4];
+    color_t sprite_palette[8 * 4];
+    uint8_t lcdc;
+    uint8_t scx;
+    uint8_t scy;
+    uint8_t wx;
+    uint8_t wy;
+    bool cgb;
+} viewer_state_t;
+
+typedef struct {
+    SDL_Window *win;
+    SDL_Renderer *ren;
+    SDL_Texture *tex;
+    uint32_t *sheet;
+    /* The last two snapshots, the window is redrawn when they differ. */
+    viewer_state_t state[2];
+    unsigned int cur;
+    bool drawn; /* The window shows state[cur ^ 1]. */
+} viewer_t;
+
+static viewer_t VIEWER;
+
+static const uint32_t tile_greys[4] = {0xffffffff, 0xffaaaaaa, 0xff555555,
+                                       0xff000000};
+
+static void viewer_snapshot(viewer_state_t *s)
+{
+    memcpy(s->vram, GPU.vram, sizeof(s->vram));
+    memcpy(s->oam, GPU.oam, sizeof(s->oam));
+    memcpy(s->bg_palette, GPU.bg_palette, sizeof(s->bg_palette));
+    memcpy(s->sprite_palette, GPU.sprite_palette, sizeof(s->sprite_palette));
+    s->lcdc = GPU.lcd_control;
+    s->scx = GPU.scroll_x;
+    s->scy = GPU.scroll_y;
+    s->wx = GPU.window_x;
+    s->wy = GPU.window_y;
+    s->cgb = cart_is_cgb();
+}
+
+static uint32_t viewer_color(color_t color)
+{
+    uint32_t argb;
+    memcpy(&argb, &color, sizeof(argb));
+    return argb | 0xff000000;
+}
+
+static void viewer_palette(uint32_t *pal, const color_t *colors)
+{
+    for (int i = 0; i < 4; ++i)
+        pal[i] = viewer_color(colors[i]);
+}
+
+static void viewer_fill(uint32_t *sheet, int x, int y, int w, int h,
+                        uint32_t color)
+{
+    for (int j = 0; j < h; ++j)
+        for (int i = 0; i < w; ++i)
+            sheet[(y + j) * VIEWER_WIDTH + x + i] = color;
+}
+
+/* Draw the 8x8 tile at data, color 0 left out if transparent. */
+static void viewer_tile(uint32_t *sheet, int x, int y, const uint8_t *data,
+                        const uint32_t *pal, uint8_t attr, bool transparent)
+{
+    bool xflip = attr & 0x20, yflip = attr & 0x40;
+    for (int row = 0; row < 8; ++row) {
+        const uint8_t *line = &data[(yflip ? 7 - row : row) * 2];
+        uint32_t *out = &sheet[(y + row) * VIEWER_WIDTH + x];
+        for (int col = 0; col < 8; ++col) {
+            int bit = xflip ? col : 7 - col;
+            int num = ((line[1] >> bit) & 1) << 1 | ((line[0] >> bit) & 1);
+            if (num || !transparent)
+                out[col] = pal[num];
+        }
+    }
+}
+
+static void viewer_tiles(uint32_t *sheet, const viewer_state_t *s)
+{
+    for (int bank = 0; bank < 2; ++bank) {
+        for (int tile = 0; tile < 384; ++tile)
+            viewer_tile(sheet, bank * TILES_BANK_X + (tile % 16) * 8,
+                        (tile / 16) * 8, &s->vram[bank][tile * 16],
+                        tile_greys, 0, false);
+    }
+}
+
+/* Plot on a map at (x, y), wrapping around it as the screen does. */
+static void viewer_map_plot(uint32_t *sheet, int map_x, int x, int y,
+                            uint32_t color)
+{
+    sheet[(MAPS_Y + (y & 0xff)) * VIEWER_WIDTH + map_x + (x & 0xff)] = color;
+}
+
+static void viewer_map_rect(uint32_t *sheet, int map_x, int x, int y, int w,
+                            int h, uint32_t color)
+{
+    for (int i = 0; i < w; ++i) {
+        viewer_map_plot(sheet, map_x, x + i, y, color);
+        viewer_map_plot(sheet, map_x, x + i, y + h - 1, color);
+    }
+    for (int j = 0; j < h; ++j) {
+        viewer_map_plot(sheet, map_x, x, y + j, color);
+        viewer_map_plot(sheet, map_x, x + w - 1, y + j, color);
+    }
+}
+
+static void viewer_maps(uint32_t *sheet, const viewer_state_t *s)
+{
+    uint32_t pal[4];
+    for (int map = 0; map < 2; ++map) {
+        for (int offs = 0; offs < 32 * 32; ++offs) {
+            unsigned int addr = 0x1800u + (unsigned int)(map * 0x400 + offs);
+            unsigned int tile = s->vram[0][addr];
+            /* Signed tile numbers from 0x9000 with LCDC bit 4 clear. */
+            if (!(s->lcdc & 0x10))
+                tile = (unsigned int)(256 + (int8_t)tile);
+            /* CGB: attributes at the same offset in bank 1. */
+            uint8_t attr = s->cgb ? s->vram[1][addr] : 0;
+            viewer_palette(pal, &s->bg_palette[(attr & 7) * 4]);
+            viewer_tile(sheet, map * MAP_1_X + (offs % 32) * 8,
+                        MAPS_Y + (offs / 32) * 8,
+                        &s->vram[(attr >> 3) & 1][tile * 16], pal, attr,
+                        false);
+        }
+    }
+    /* The screen on the background map, the window on its own. */
+    viewer_map_rect(sheet, s->lcdc & 0x08 ? MAP_1_X : 0, s->scx, s->scy,
+                    GB_SCREEN_WIDTH, GB_SCREEN_HEIGHT, COLOR_SCREEN);
+    if ((s->lcdc & 0x20) && s->wx < GB_SCREEN_WIDTH + 7 &&
+        s->wy < GB_SCREEN_HEIGHT) {
+        /* WX below 7 shifts the window left. */
+        int left = s->wx < 7 ? 7 - s->wx : 0;
+        int width = s->wx < 7 ? GB_SCREEN_WIDTH : GB_SCREEN_WIDTH + 7 - s->wx;
+        viewer_map_rect(sheet, s->lcdc & 0x40 ? MAP_1_X : 0, left, 0, width,
+                        GB_SCREEN_HEIGHT - s->wy, COLOR_WINDOW);
+    }
+}
+
+static void viewer_sprites(uint32_t *sheet, const viewer_state_t *s)
+{
+    bool tall = s->lcdc & 0x04;
+    uint32_t pal[4];
+    for (int i = 0; i < 40; ++i) {
+        const uint8_t *sprite = &s->oam[i * 4];
+        int x = OAM_X + (i % 8) * OAM_CELL_W;
+        int y = OAM_Y + (i / 8) * OAM_CELL_H;
+        uint8_t attr = sprite[3];
+        unsigned int tile = tall ? sprite[2] & 0xfe : sprite[2];
+        unsigned int bank = s->cgb ? (attr >> 3) & 1 : 0;
+        unsigned int p = s->cgb ? attr & 7 : (attr >> 4) & 1;
+        viewer_palette(pal, &s->sprite_palette[p * 4]);
+        viewer_fill(sheet, x, y, 8, 16, COLOR_CELL);
+        /* Flipped 8x16 sprites also swap their tiles. */
+        for (int half = 0; half < (tall ? 2 : 1); ++half) {
+            unsigned int t = tile + (unsigned int)((attr & 0x40) && tall
+                                                       ? 1 - half
+                                                       : half);
+            viewer_tile(sheet, x, y + half * 8, &s->vram[bank][t * 16], pal,
+                        attr, true);
+        }
+    }
+}
+
+static void viewer_palettes(uint32_t *sheet, const viewer_state_t *s)
+{
+    for (int p = 0; p < 8; ++p) {
+        for (int c = 0; c < 4; ++c) {
+            viewer_fill(sheet, PAL_X + c * 8, p * 8, 8, 8,
+                        viewer_color(s->bg_palette[p * 4 + c]));
+            viewer_fill(sheet, PAL_OBJ_X + c * 8, p * 8, 8, 8,
+                        viewer_color(s->sprite_palette[p * 4 + c]));
+        }
+    }
+}
+
+static void viewer_draw_state(uint32_t *sheet, const viewer_state_t *s)
+{
+    viewer_fill(sheet, 0, 0, VIEWER_WIDTH, VIEWER_HEIGHT, COLOR_BACK);
+    viewer_tiles(sheet, s);
+    viewer_palettes(sheet, s);
+    viewer_sprites(sheet, s);
+    viewer_maps(sheet, s);
+}
+
+void viewer_draw(uint32_t *sheet)
+{
+    viewer_state_t *s = malloc(sizeof(*s));
+    if (s == NULL)
+        return;
+    viewer_snapshot(s);
+    viewer_draw_state(sheet, s);
+    free(s);
+}
+
+int viewer_open(void)
+{
+    VIEWER.sheet = malloc(sizeof(uint32_t) * VIEWER_WIDTH * VIEWER_HEIGHT);
+    VIEWER.win = SDL_CreateWindow("gusgb VRAM", SDL_WINDOWPOS_UNDEFINED,
+                                  SDL_WINDOWPOS_UNDEFINED, VIEWER_WIDTH * 2,
+                                  VIEWER_HEIGHT * 2,
+                                  SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+    /* No vsync: the emulation window already waits for it. */
+    if (VIEWER.sheet && VIEWER.win)
+        VIEWER.ren = SDL_CreateRenderer(VIEWER.win, -1,
+                                        SDL_RENDERER_ACCELERATED);
+    if (VIEWER.ren)
+        VIEWER.tex = SDL_CreateTexture(VIEWER.ren, SDL_PIXELFORMAT_ARGB8888,
+                                       SDL_TEXTUREACCESS_STREAMING,
+                                       VIEWER_WIDTH, VIEWER_HEIGHT);
+    if (VIEWER.tex == NULL) {
+        fprintf(stderr, "ERROR: VRAM viewer: %s\n", SDL_GetError());
+        viewer_close();
+        return -1;
+    }
+    /* Zeroed padding, the snapshots are compared whole. */
+    memset(VIEWER.state, 0, sizeof(VIEWER.state));
+    VIEWER.cur = 0;
+    VIEWER.drawn = false;
+    return 0;
+}
+
+void viewer_close(void)
+{
+    if (VIEWER.tex)
+        SDL_DestroyTexture(VIEWER.tex);
+    if (VIEWER.ren)
+        SDL_DestroyRenderer(VIEWER.ren);
+    if (VIEWER.win)
+        SDL_DestroyWindow(VIEWER.win);
+    free(VIEWER.sheet);
+    VIEWER.tex = NULL;
+    VIEWER.ren = NULL;
+    VIEWER.win = NULL;
+    VIEWER.sheet = NULL;
+}
+
+uint32_t viewer_window_id(void)
+{
+    return VIEWER.win ? SDL_GetWindowID(VIEWER.win) : 0;
+}
+
+void viewer_frame(void)
+{
+    if (VIEWER.win == NULL)
+        return;
+    viewer_state_t *s = &VIEWER.state[VIEWER.cur];
+    viewer_snapshot(s);
+    if (VIEWER.drawn &&
+        memcmp(s, &VIEWER.state[VIEWER.cur ^ 1], sizeof(*s)) == 0)
+        return;
+    VIEWER.cur ^= 1;
+    VIEWER.drawn = true;
+    viewer_draw_state(VIEWER.sheet, s);
+    SDL_UpdateTexture(VIEWER.tex, NULL, VIEWER.sheet, VIEWER_WIDTH * 4);
+    SDL_RenderClear(VIEWER.ren);
+    SDL_RenderCopy(VIEWER.ren, VIEWER.tex, NULL, NULL);
+    SDL_RenderPresent(VIEWER.ren);
+}
+
+static uint32_t png_crc(uint32_t crc, const uint8_t *data, size_t len)
+{
+    static uint32_t table[256];
+    if (table[1] == 0) {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void png_put32(uint8_t *out, uint32_t val)
+{
+    out[0] = (uint8_t)(val >> 24);
+    out[1] = (uint8_t)(val >> 16);
+    out[2] = (uint8_t)(val >> 8);
+    out[3] = (uint8_t)val;
+}
+
+/* Write a chunk whose data follows its 8 byte length and type header. */
+static bool png_chunk(FILE *f, uint8_t *chunk, const char *type, size_t len)
+{
+    png_put32(chunk, (uint32_t)len);
+    memcpy(&chunk[4], type, 4);
+    uint8_t crc[4];
+    png_put32(crc, png_crc(0, &chunk[4], len + 4));
+    return fwrite(chunk, 1, len + 8, f) == len + 8 &&
+           fwrite(crc, 1, 4, f) == 4;
+}
+
+/* RGB rows, filter 0, in stored (uncompressed) deflate blocks. */
+static size_t png_idat(uint8_t *out, const uint32_t *sheet)
+{
+    const size_t row = 1 + VIEWER_WIDTH * 3;
+    const size_t raw = row * VIEWER_HEIGHT;
+    size_t pos = 0, done = 0;
+    uint32_t a = 1, b = 0; /* Adler-32. */
+    out[pos++] = 0x78; /* Deflate, 32k window, no compression. */
+    out[pos++] = 0x01;
+    while (done < raw) {
+        size_t len = raw - done > 0xffff ? 0xffff : raw - done;
+        out[pos++] = (uint8_t)(done + len == raw); /* Last block. */
+        out[pos++] = (uint8_t)len;
+        out[pos++] = (uint8_t)(len >> 8);
+        out[pos++] = (uint8_t)~len;
+        out[pos++] = (uint8_t)(~len >> 8);
+        for (size_t i = done; i < done + len; ++i) {
+            size_t x = i % row;
+            uint8_t byte = 0;
+            if (x) {
+                uint32_t pixel = sheet[(i / row) * VIEWER_WIDTH + (x - 1) / 3];
+                byte = (uint8_t)(pixel >> (16 - 8 * ((x - 1) % 3)));
+            }
+            out[pos++] = byte;
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        done += len;
+    }
+    png_put32(&out[pos], b << 16 | a);
+    return pos + 4;
+}
+
+int viewer_dump(const char *path)
+{
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G',
+                                         '\r', '\n', 0x1a, '\n'};
+    const size_t raw = (1 + VIEWER_WIDTH * 3) * VIEWER_HEIGHT;
+    uint32_t *sheet = malloc(sizeof(uint32_t) * VIEWER_WIDTH * VIEWER_HEIGHT);
+    /* Room for the headers and 5 bytes per 64k stored block. */
+    uint8_t *chunk = malloc(8 + 2 + raw + (raw / 0xffff + 1) * 5 + 4);
+    if (sheet == NULL || chunk == NULL) {
+        perror("malloc");
+        free(sheet);
+        free(chunk);
+        return -1;
+    }
+    viewer_draw(sheet);
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        perror("fopen");
+        free(sheet);
+        free(chunk);
+        return -1;
+    }
+    uint8_t *ihdr = &chunk[8];
+    png_put32(&ihdr[0], VIEWER_WIDTH);
+    png_put32(&ihdr[4], VIEWER_HEIGHT);
+    /* 8 bit RGB, deflate, no filter per se, no interlace. */
+    memcpy(&ihdr[8], "\x08\x02\x00\x00\x00", 5);
+    bool ok = fwrite(signature, 1, sizeof(signature), f) == sizeof(signature);
+    ok = ok && png_chunk(f, chunk, "IHDR", 13);
+    ok = ok && png_chunk(f, chunk, "IDAT", png_idat(&chunk[8], sheet));
+    ok = ok && png_chunk(f, chunk, "IEND", 0);
+    if (fclose(f) != 0 || !ok) {
+        fprintf(stderr, "ERROR: could not write %s\n", path);
+        ok = false;
+    }
+    free(sheet);
+    free(chunk);
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,33 @@
+#ifndef VIEWER_H
+#define VIEWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* VRAM viewer: the tile sets of both VRAM banks, both tile maps with the
+ * screen and window overlaid, the OAM sprites and the palettes, drawn side
+ * by side in one sheet from a snapshot of the GPU state.
+ *
+ * Sheet layout: tiles of bank 0 then bank 1 (16 x 24 tiles each) at the
+ * top left, BG and OBJ palettes (a row of 4 colors each) and the 40 sprites
+ * (8 per row) to their right, maps 0x9800 and 0x9c00 below. */
+
+#define VIEWER_WIDTH 520
+#define VIEWER_HEIGHT 456
+#define VIEWER_PATH "gusgb_vram.png"
+
+/* Open the viewer window. */
+int viewer_open(void);
+void viewer_close(void);
+/* SDL ID of the viewer window, 0 when closed. */
+uint32_t viewer_window_id(void);
+/* Once per frame: snapshot the GPU state, redraw the window when it
+ * changed. */
+void viewer_frame(void);
+/* Draw the sheet of the current GPU state, VIEWER_WIDTH x VIEWER_HEIGHT
+ * ARGB pixels. */
+void viewer_draw(uint32_t *sheet);
+/* Write the sheet of the current GPU state to a PNG file. */
+int viewer_dump(const char *path);
+
+#endif /* VIEWER_H */
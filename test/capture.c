@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "capture.h"
+#include "game_boy.h"
+#include "gpu.h"
+#include "movie.h"
+#include "rom.h"
+#include "ut.h"
+
+#define W GB_SCREEN_WIDTH
+#define H GB_SCREEN_HEIGHT
+
+static uint32_t frame[W * H];
+
+static void fill_frame(void)
+{
+    uint32_t seed = 777;
+    for (unsigned int i = 0; i < W * H; ++i) {
+        seed = seed * 1103515245 + 12345;
+        frame[i] = 0xff000000 | (seed >> 8);
+    }
+}
+
+static int capture_yuv(void)
+{
+    static uint8_t planes[W * H * 3 / 2];
+    uint8_t *y = planes, *u = planes + W * H, *v = u + W * H / 4;
+    /* Limited range white and black, no chroma. */
+    for (unsigned int i = 0; i < W * H; ++i)
+        frame[i] = i < W * 2 ? 0xffffffff : 0xff000000;
+    capture_yuv420(frame, W, H, y, u, v);
+    ASSERT(y[0] == 235 && u[0] == 128 && v[0] == 128);
+    ASSERT(y[W * H - 1] == 16 && u[W * H / 4 - 1] == 128);
+    /* Whole rows, vectorized, match the blocks converted one by one. */
+    fill_frame();
+    capture_yuv420(frame, W, 2, y, u, v);
+    for (unsigned int x = 0; x < W; x += 2) {
+        uint32_t block[4] = {frame[x], frame[x + 1], frame[W + x],
+                             frame[W + x + 1]};
+        uint8_t by[4], bu, bv;
+        capture_yuv420(block, 2, 2, by, &bu, &bv);
+        ASSERT(by[0] == y[x] && by[1] == y[x + 1]);
+        ASSERT(by[2] == y[W + x] && by[3] == y[W + x + 1]);
+        ASSERT(bu == u[x / 2] && bv == v[x / 2]);
+    }
+    return 0;
+}
+
+static int capture_stream(void)
+{
+    char path[] = "/tmp/gusgb_capture_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    close(fd);
+    fill_frame();
+    ASSERT(capture_open(path, CAPTURE_Y4M, SCALE_NEAREST, 1) == 0);
+    for (int i = 0; i < 3; ++i)
+        capture_frame(frame);
+    capture_close();
+    ASSERT(capture_written() == 3 && capture_dropped() == 0);
+    struct stat st;
+    ASSERT(stat(path, &st) == 0);
+    const char *header = "YUV4MPEG2 W160 H144 F4194304:70224 Ip A1:1 "
+                         "C420jpeg\n";
+    ASSERT((size_t)st.st_size ==
+           strlen(header) + 3 * (strlen("FRAME\n") + W * H * 3 / 2));
+    /* Raw RGB, 2x. */
+    ASSERT(capture_open(path, CAPTURE_RAW, SCALE_SCALE2X, 1) == 0);
+    capture_frame(frame);
+    capture_close();
+    ASSERT(stat(path, &st) == 0);
+    ASSERT(st.st_size == W * H * 4 * 3);
+    unlink(path);
+    /* Frames that cannot be written are counted as dropped. */
+    if (access("/dev/full", W_OK) == 0) {
+        ASSERT(capture_open("/dev/full", CAPTURE_RAW, SCALE_NEAREST, 1) == 0);
+        for (int i = 0; i < 3; ++i)
+            capture_frame(frame);
+        capture_close();
+        ASSERT(capture_written() == 0 && capture_dropped() == 3);
+    }
+    return 0;
+}
+
+/* Frames are captured at the emulated VBlank only, never while paused. */
+static int capture_pause(void)
+{
+    char path[] = "/tmp/gusgb_capture_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    close(fd);
+    const char *rom = rom_create(0);
+    ASSERT(rom != NULL);
+    gb_config_t config = {.scale = 1, .headless = true, .no_trace = true};
+    config.capture_path = path;
+    ASSERT(gb_init(&config, rom) == 0);
+    while (movie_get_frame() < 2)
+        gb_step();
+    gb_pause(true);
+    for (int i = 0; i < 1000; ++i)
+        gb_step();
+    gb_pause(false);
+    while (movie_get_frame() < 4)
+        gb_step();
+    gb_finish();
+    ASSERT(capture_written() == 4 && capture_dropped() == 0);
+    struct stat st;
+    ASSERT(stat(path, &st) == 0 && st.st_size == W * H * 3 * 4);
+    rom_remove();
+    unlink(path);
+    return 0;
+}
+
+void capture_test(void);
+
+void capture_test(void)
+{
+    ut_run(capture_yuv);
+    ut_run(capture_stream);
+    ut_run(capture_pause);
+}
@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cartridge/cart.h"
+#include "cartridge/huc1.h"
+#include "ut.h"
+
+extern cart_t CART;
+
+#define ROM_BANKS 64
+#define RAM_BANKS 4
+
+static void huc1_setup(void)
+{
+    memset(&CART, 0, sizeof(CART));
+    CART.type = CART_HUC1_RAM_BATTERY;
+    CART.rom.size = ROM_BANKS * 0x4000;
+    CART.rom.max_bank = ROM_BANKS;
+    CART.rom.bytes = malloc(CART.rom.size);
+    for (unsigned int i = 0; i < ROM_BANKS; ++i) {
+        CART.rom.bytes[i * 0x4000] = (uint8_t)i;
+    }
+    CART.ram.size = RAM_BANKS * 0x2000;
+    CART.ram.max_bank = RAM_BANKS;
+    CART.ram.bytes = calloc(1, CART.ram.size);
+    huc1_init();
+}
+
+static void huc1_teardown(void)
+{
+    free(CART.rom.bytes);
+    free(CART.ram.bytes);
+    memset(&CART, 0, sizeof(CART));
+}
+
+static int huc1_rom_bank(void)
+{
+    huc1_setup();
+    ASSERT(cart_read_rom1(0x4000) == 1);
+    huc1_write(0x2000, 0x3f);
+    ASSERT(cart_read_rom1(0x4000) == 0x3f);
+    huc1_write(0x3fff, 0x42);
+    ASSERT(cart_read_rom1(0x4000) == 0x02);
+    huc1_write(0x2000, 0);
+    ASSERT(cart_read_rom1(0x4000) == 1);
+    huc1_teardown();
+    return 0;
+}
+
+static int huc1_ram_bank(void)
+{
+    huc1_setup();
+    for (unsigned int i = 0; i < RAM_BANKS; ++i) {
+        huc1_write(0x4000, (uint8_t)i);
+        huc1_ram_write(0xa000, (uint8_t)(0x10 + i));
+    }
+    for (unsigned int i = 0; i < RAM_BANKS; ++i) {
+        ASSERT(CART.ram.bytes[i * 0x2000] == 0x10 + i);
+        huc1_write(0x5fff, (uint8_t)i);
+        ASSERT(huc1_ram_read(0xa000) == 0x10 + i);
+    }
+    huc1_teardown();
+    return 0;
+}
+
+static int huc1_ir(void)
+{
+    huc1_setup();
+    huc1_ram_write(0xa000, 0x33);
+    /* IR mode maps the IR port over RAM. */
+    huc1_write(0x0000, 0x0e);
+    ASSERT(huc1_ram_read(0xa000) == 0xc0);
+    huc1_ram_write(0xa000, 0x01);
+    ASSERT(CART.ram.bytes[0] == 0x33);
+    huc1_write(0x0000, 0x0a);
+    ASSERT(huc1_ram_read(0xa000) == 0x33);
+    huc1_teardown();
+    return 0;
+}
+
+void huc1_test(void);
+
+void huc1_test(void)
+{
+    ut_run(huc1_rom_bank);
+    ut_run(huc1_ram_bank);
+    ut_run(huc1_ir);
+}
@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cartridge/cart.h"
+#include "cartridge/mbc2.h"
+#include "ut.h"
+
+extern cart_t CART;
+
+#define ROM_BANKS 16
+
+static void mbc2_setup(void)
+{
+    memset(&CART, 0, sizeof(CART));
+    CART.type = CART_MBC2_BATTERY;
+    CART.rom.size = ROM_BANKS * 0x4000;
+    CART.rom.max_bank = ROM_BANKS;
+    CART.rom.bytes = malloc(CART.rom.size);
+    for (unsigned int i = 0; i < ROM_BANKS; ++i) {
+        CART.rom.bytes[i * 0x4000] = (uint8_t)i;
+    }
+    CART.ram.size = MBC2_RAM_SIZE;
+    CART.ram.max_bank = 1;
+    CART.ram.bytes = calloc(1, CART.ram.size);
+    mbc2_init();
+}
+
+static void mbc2_teardown(void)
+{
+    free(CART.rom.bytes);
+    free(CART.ram.bytes);
+    memset(&CART, 0, sizeof(CART));
+}
+
+static int mbc2_rom_bank(void)
+{
+    mbc2_setup();
+    ASSERT(cart_read_rom1(0x4000) == 1);
+    /* Address bit 8 set selects the ROM bank register. */
+    mbc2_write(0x2100, 5);
+    ASSERT(cart_read_rom1(0x4000) == 5);
+    mbc2_write(0x0100, 0x1f);
+    ASSERT(cart_read_rom1(0x4000) == 15);
+    mbc2_write(0x3fff, 0);
+    ASSERT(cart_read_rom1(0x4000) == 1);
+    /* Address bit 8 clear is the RAM enable register. */
+    mbc2_write(0x2000, 3);
+    ASSERT(cart_read_rom1(0x4000) == 1);
+    /* No registers above 0x3fff. */
+    mbc2_write(0x4100, 3);
+    ASSERT(cart_read_rom1(0x4000) == 1);
+    mbc2_teardown();
+    return 0;
+}
+
+static int mbc2_ram(void)
+{
+    mbc2_setup();
+    mbc2_ram_write(0xa000, 0x05);
+    ASSERT(mbc2_ram_read(0xa000) == 0xff);
+    ASSERT(CART.ram.bytes[0] == 0);
+    mbc2_write(0x0000, 0x0a);
+    ASSERT(CART.ram.enabled);
+    /* Only the lower nibble is stored, upper one reads as 1s. */
+    mbc2_ram_write(0xa000, 0x35);
+    ASSERT(CART.ram.bytes[0] == 0x05);
+    ASSERT(mbc2_ram_read(0xa000) == 0xf5);
+    /* RAM is mirrored every 512 bytes. */
+    mbc2_ram_write(0xa3ff, 0xca);
+    ASSERT(CART.ram.bytes[0x1ff] == 0x0a);
+    ASSERT(mbc2_ram_read(0xa1ff) == 0xfa);
+    ASSERT(mbc2_ram_read(0xbe00) == 0xf5);
+    /* Upper nibble of a save file written by other emulators is ignored. */
+    CART.ram.bytes[2] = 0xf7;
+    ASSERT(mbc2_ram_read(0xa002) == 0xf7);
+    mbc2_write(0x0000, 0x00);
+    ASSERT(mbc2_ram_read(0xa000) == 0xff);
+    mbc2_teardown();
+    return 0;
+}
+
+void mbc2_test(void);
+
+void mbc2_test(void)
+{
+    ut_run(mbc2_rom_bank);
+    ut_run(mbc2_ram);
+}
@@ -1,7 +1,18 @@
+#include <stdlib.h>
 #include <string.h>
+#include "cartridge/cart.h"
 #include "cartridge/mbc3.h"
 #include "ut.h"
 
+extern cart_t CART;
+
+static uint64_t fake_ticks;
+
+static uint64_t fake_clock(void)
+{
+    return fake_ticks;
+}
+
 static int check_rtc_update(rtc_time_t *time, time_t diff,
                             rtc_time_t *rtc_expected)
 {
@@ -62,9 +73,65 @@ static int rtc_update(void)
     return 0;
 }
 
+static void rtc_latch(void)
+{
+    mbc3_write(0x6000, 0);
+    mbc3_write(0x6000, 1);
+}
+
+static uint8_t rtc_read(uint8_t reg)
+{
+    mbc3_write(0x4000, reg);
+    return mbc3_ram_read(0xa000);
+}
+
+static int rtc_emulated(void)
+{
+    memset(&CART, 0, sizeof(CART));
+    CART.ram.size = 0x2000;
+    CART.ram.bytes = calloc(1, CART.ram.size);
+    CART.ram.enabled = true;
+    fake_ticks = 1000;
+    mbc3_rtc_set_clock(fake_clock);
+    mbc3_init();
+    mbc3_rtc_load(NULL);
+    /* Partial seconds carry over to the next latch. */
+    fake_ticks += 90 * RTC_HZ + RTC_HZ / 2;
+    rtc_latch();
+    ASSERT(rtc_read(0x08) == 30);
+    ASSERT(rtc_read(0x09) == 1);
+    fake_ticks += RTC_HZ / 2;
+    rtc_latch();
+    ASSERT(rtc_read(0x08) == 31);
+    /* Latched registers do not move until the next latch. */
+    fake_ticks += 5 * RTC_HZ;
+    ASSERT(rtc_read(0x08) == 31);
+    rtc_latch();
+    ASSERT(rtc_read(0x08) == 36);
+    /* Time stands still while halted. */
+    mbc3_write(0x4000, 0x0c);
+    mbc3_ram_write(0xa000, 0x40);
+    fake_ticks += 10 * RTC_HZ;
+    rtc_latch();
+    ASSERT(rtc_read(0x08) == 36);
+    mbc3_write(0x4000, 0x08);
+    mbc3_ram_write(0xa000, 10);
+    mbc3_write(0x4000, 0x0c);
+    mbc3_ram_write(0xa000, 0x00);
+    fake_ticks += 2 * RTC_HZ;
+    rtc_latch();
+    ASSERT(rtc_read(0x08) == 12);
+    ASSERT(rtc_read(0x09) == 1);
+    mbc3_rtc_set_clock(NULL);
+    free(CART.ram.bytes);
+    memset(&CART, 0, sizeof(CART));
+    return 0;
+}
+
 void mbc3_test(void);
 
 void mbc3_test(void)
 {
     ut_run(rtc_update);
+    ut_run(rtc_emulated);
 }
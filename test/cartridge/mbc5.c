@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cartridge/cart.h"
+#include "cartridge/mbc5.h"
+#include "ut.h"
+
+extern cart_t CART;
+
+#define ROM_BANKS 512
+#define RAM_BANKS 16
+
+/* Tag every ROM bank with its number, and every RAM bank with its number in
+ * its first byte. */
+static void mbc5_setup(cart_type_e type, unsigned int rom_banks)
+{
+    memset(&CART, 0, sizeof(CART));
+    CART.type = type;
+    CART.rom.size = rom_banks * 0x4000;
+    CART.rom.max_bank = rom_banks;
+    CART.rom.bytes = malloc(CART.rom.size);
+    for (unsigned int i = 0; i < rom_banks; ++i) {
+        CART.rom.bytes[i * 0x4000] = (uint8_t)i;
+        CART.rom.bytes[i * 0x4000 + 1] = (uint8_t)(i >> 8);
+    }
+    CART.ram.size = RAM_BANKS * 0x2000;
+    CART.ram.max_bank = RAM_BANKS;
+    CART.ram.bytes = calloc(1, CART.ram.size);
+    mbc5_init();
+}
+
+static void mbc5_teardown(void)
+{
+    free(CART.rom.bytes);
+    free(CART.ram.bytes);
+    memset(&CART, 0, sizeof(CART));
+}
+
+static unsigned int rom1_bank(void)
+{
+    return cart_read_rom1(0x4000) | (cart_read_rom1(0x4001) << 8);
+}
+
+static int mbc5_rom_bank(void)
+{
+    mbc5_setup(CART_MBC5, ROM_BANKS);
+    ASSERT(rom1_bank() == 1);
+    /* Bank 0 is not translated to 1. */
+    mbc5_write(0x2000, 0);
+    ASSERT(rom1_bank() == 0);
+    mbc5_write(0x2fff, 0xff);
+    ASSERT(rom1_bank() == 0xff);
+    /* 9th bit. */
+    mbc5_write(0x3000, 1);
+    ASSERT(rom1_bank() == 0x1ff);
+    mbc5_write(0x2000, 0x23);
+    ASSERT(rom1_bank() == 0x123);
+    mbc5_write(0x3fff, 0xfe);
+    ASSERT(rom1_bank() == 0x23);
+    mbc5_teardown();
+    /* Banks past the ROM size wrap around. */
+    mbc5_setup(CART_MBC5, 8);
+    mbc5_write(0x2000, 9);
+    ASSERT(rom1_bank() == 1);
+    mbc5_write(0x3000, 1);
+    ASSERT(rom1_bank() == 1);
+    mbc5_teardown();
+    return 0;
+}
+
+static int mbc5_ram_bank(void)
+{
+    mbc5_setup(CART_MBC5_RAM_BATTERY, 2);
+    /* RAM disabled. */
+    mbc5_ram_write(0xa000, 0x12);
+    ASSERT(mbc5_ram_read(0xa000) == 0xff);
+    ASSERT(CART.ram.bytes[0] == 0);
+    mbc5_write(0x0000, 0x0a);
+    for (unsigned int i = 0; i < RAM_BANKS; ++i) {
+        mbc5_write(0x4000, (uint8_t)i);
+        mbc5_ram_write(0xa000, (uint8_t)(0x80 | i));
+        mbc5_ram_write(0xbfff, (uint8_t)i);
+    }
+    for (unsigned int i = 0; i < RAM_BANKS; ++i) {
+        ASSERT(CART.ram.bytes[i * 0x2000] == (0x80 | i));
+        ASSERT(CART.ram.bytes[i * 0x2000 + 0x1fff] == i);
+        mbc5_write(0x5fff, (uint8_t)i);
+        ASSERT(mbc5_ram_read(0xa000) == (0x80 | i));
+        /* Enabled bank is mapped as plain memory. */
+        ASSERT(CART.ram.bank == &CART.ram.bytes[i * 0x2000]);
+    }
+    mbc5_write(0x0000, 0x00);
+    ASSERT(mbc5_ram_read(0xa000) == 0xff);
+    ASSERT(CART.ram.bank == NULL);
+    mbc5_teardown();
+    return 0;
+}
+
+static int mbc5_rumble(void)
+{
+    mbc5_setup(CART_MBC5_RUMBLE_RAM, 2);
+    mbc5_write(0x0000, 0x0a);
+    mbc5_write(0x4000, 1);
+    mbc5_ram_write(0xa000, 0x42);
+    /* Bit 3 drives the motor and does not select a bank. */
+    mbc5_write(0x4000, 0x09);
+    ASSERT(mbc5_ram_read(0xa000) == 0x42);
+    ASSERT(CART.ram.bytes[0x2000] == 0x42);
+    mbc5_teardown();
+    return 0;
+}
+
+void mbc5_test(void);
+
+void mbc5_test(void)
+{
+    ut_run(mbc5_rom_bank);
+    ut_run(mbc5_ram_bank);
+    ut_run(mbc5_rumble);
+}
@@ -0,0 +1,67 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cartridge/cart.h"
+#include "cartridge/mbc1.h"
+#include "cartridge/ram_sync.h"
+#include "ut.h"
+
+extern cart_t CART;
+
+static int check_file(const char *path, size_t pos, uint8_t val)
+{
+    FILE *f = fopen(path, "rb");
+    ASSERT(f != NULL);
+    fseek(f, (long)pos, SEEK_SET);
+    int c = fgetc(f);
+    fclose(f);
+    ASSERT(c == val);
+    return 0;
+}
+
+static int ram_sync_dirty_pages(void)
+{
+    char path[] = "/tmp/gusgb_ram_sync_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    memset(&CART.ram, 0, sizeof(CART.ram));
+    CART.ram.path = path;
+    CART.ram.size = 32 * 1024;
+    CART.ram.max_bank = 4;
+    ASSERT(ram_sync_open(&CART.ram) == 0);
+    /* New save file is extended to the RAM size. */
+    ASSERT(CART.ram.bytes[CART.ram.size - 1] == 0);
+    mbc1_init();
+    CART.ram.enabled = true;
+    /* Select RAM mode and bank 3. */
+    mbc1_write(0x6000, 1);
+    mbc1_write(0x4000, 3);
+    mbc1_ram_write(0xa010, 0x5a);
+    size_t pos = 3 * 0x2000 + 0x10;
+    ASSERT(CART.ram.bytes[pos] == 0x5a);
+    ASSERT(CART.ram.dirty[pos >> CART.ram.page_shift] == 1);
+    ASSERT(CART.ram.dirty[0] == 0);
+    ram_sync_flush(&CART.ram);
+    ASSERT(CART.ram.dirty[pos >> CART.ram.page_shift] == 0);
+    ASSERT(check_file(path, pos, 0x5a) == 0);
+    /* Disabled RAM is not written nor marked. */
+    CART.ram.enabled = false;
+    mbc1_ram_write(0xa011, 0xa5);
+    ASSERT(CART.ram.dirty[pos >> CART.ram.page_shift] == 0);
+    CART.ram.enabled = true;
+    mbc1_ram_write(0xa011, 0xa5);
+    ram_sync_close(&CART.ram);
+    ASSERT(CART.ram.bytes == NULL);
+    ASSERT(check_file(path, pos + 1, 0xa5) == 0);
+    close(fd);
+    unlink(path);
+    memset(&CART.ram, 0, sizeof(CART.ram));
+    return 0;
+}
+
+void ram_sync_test(void);
+
+void ram_sync_test(void)
+{
+    ut_run(ram_sync_dirty_pages);
+}
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cpu.h"
+#include "debugger.h"
+#include "mmu.h"
+#include "rom.h"
+#include "ut.h"
+
+extern cpu_t CPU;
+
+static void on_frame(void)
+{
+}
+
+static int debugger_setup(void)
+{
+    const char *rom = rom_create(ROM_PROGRAM);
+    ASSERT(rom != NULL);
+    ASSERT(cpu_init(rom) == 0);
+    ASSERT(gpu_init(NULL, on_frame) == 0);
+    return 0;
+}
+
+static void debugger_teardown(void)
+{
+    debugger_clear();
+    if (debugger_stopped())
+        debugger_continue(0);
+    cpu_finish();
+    rom_remove();
+}
+
+/* Run until the debugger stops, at most max instructions. */
+static void run(unsigned int max)
+{
+    for (unsigned int i = 0; i < max && !debugger_stopped(); ++i)
+        cpu_debug_cycle();
+}
+
+static int debugger_breakpoints(void)
+{
+    ASSERT(debugger_setup() == 0);
+    ASSERT(debugger_command("b 108") == 0);
+    ASSERT(debugger_has_breakpoint(0x108));
+    run(100);
+    ASSERT(debugger_stopped() && CPU.reg.pc == 0x108);
+    ASSERT(CPU.reg.sp == 0xfffe);
+    /* The loop comes back to the breakpoint. */
+    debugger_continue(0);
+    run(100);
+    ASSERT(debugger_stopped() && CPU.reg.pc == 0x108);
+    ASSERT(debugger_command("db 108") == 0);
+    ASSERT(!debugger_has_breakpoint(0x108));
+    ASSERT(debugger_command("q") < 0);
+    /* Stopped, still armed for the emulation loop. */
+    ASSERT(debugger_armed);
+    debugger_continue(0);
+    ASSERT(!debugger_armed);
+    debugger_teardown();
+    return 0;
+}
+
+static int debugger_stepping(void)
+{
+    ASSERT(debugger_setup() == 0);
+    debugger_stop();
+    run(1);
+    ASSERT(debugger_stopped() && CPU.reg.pc == 0x100);
+    ASSERT(debugger_command("s 2") == 0);
+    run(100);
+    ASSERT(debugger_stopped() && CPU.reg.pc == 0x105);
+    /* Over the call and its three instructions. */
+    debugger_next();
+    run(100);
+    ASSERT(debugger_stopped() && CPU.reg.pc == 0x108);
+    debugger_continue(0);
+    ASSERT(!debugger_armed);
+    debugger_teardown();
+    return 0;
+}
+
+static int debugger_watchpoints(void)
+{
+    ASSERT(debugger_setup() == 0);
+    ASSERT(debugger_command("w c000") == 0);
+    run(100);
+    /* Stops after the writing instruction, which completed. */
+    ASSERT(debugger_stopped() && CPU.reg.pc == 0x105);
+    ASSERT(mmu_read_byte_dma(0xc000) == 0x42);
+    debugger_continue(0);
+    /* Reads of the page go through the slow path and still work. */
+    debugger_set_watchpoint(0xc001, DEBUGGER_WATCH_READ);
+    ASSERT(mmu_read_byte_dma(0xc000) == 0x42);
+    mmu_write_byte_debug(0xc001, 0x17);
+    ASSERT(mmu_read_byte(0xc001) == 0x17);
+    run(1);
+    ASSERT(debugger_stopped());
+    debugger_teardown();
+    return 0;
+}
+
+/* Commands arriving in one read all run, without waiting for more input. */
+static int debugger_console_input(void)
+{
+    ASSERT(debugger_setup() == 0);
+    int fds[2];
+    ASSERT(pipe(fds) == 0);
+    int saved = dup(STDIN_FILENO);
+    ASSERT(saved >= 0 && dup2(fds[0], STDIN_FILENO) == STDIN_FILENO);
+    const char cmds[] = "b 110\nb 120\n";
+    ASSERT(write(fds[1], cmds, sizeof(cmds) - 1) == sizeof(cmds) - 1);
+    ASSERT(debugger_console(0) == 0);
+    ASSERT(debugger_has_breakpoint(0x110));
+    ASSERT(debugger_console(0) == 0);
+    ASSERT(debugger_has_breakpoint(0x120));
+    /* The writer stays: nothing more to run. */
+    ASSERT(debugger_console(0) == 0);
+    /* An unterminated last line still runs before the end of input. */
+    ASSERT(write(fds[1], "db 110", 6) == 6);
+    close(fds[1]);
+    /* Read, then run at the end of input. */
+    ASSERT(debugger_console(0) == 0);
+    ASSERT(debugger_has_breakpoint(0x110));
+    ASSERT(debugger_console(0) == 0);
+    ASSERT(!debugger_has_breakpoint(0x110));
+    ASSERT(debugger_console(0) < 0);
+    ASSERT(dup2(saved, STDIN_FILENO) == STDIN_FILENO);
+    close(saved);
+    close(fds[0]);
+    debugger_teardown();
+    return 0;
+}
+
+void debugger_test(void);
+
+void debugger_test(void)
+{
+    ut_run(debugger_breakpoints);
+    ut_run(debugger_stepping);
+    ut_run(debugger_watchpoints);
+    ut_run(debugger_console_input);
+}
@@ -0,0 +1,167 @@
+/* Compare our CPU against a Gameboy Doctor reference log. The ROM runs
+ * headless in lockstep with the log, one line per instruction, and stops at
+ * the first line that differs. Lines are streamed, so logs of hundreds of
+ * millions of lines are fine; "-" reads the log from stdin, e.g. from zcat. */
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "clock.h"
+#include "cpu.h"
+#include "doctor.h"
+#include "gpu.h"
+
+#define DEFAULT_CONTEXT 8
+#define DEFAULT_BUDGET (4194304ULL * 3600) /* 1 emulated hour. */
+
+typedef struct {
+    FILE *ref;
+    char *ref_line;
+    size_t ref_size;
+    uint64_t lines; /* Lines that matched. */
+    /* Last matching lines, a ring of context entries. */
+    char (*context)[DOCTOR_LINE_LEN + 1];
+    unsigned int context_len;
+    char line[DOCTOR_LINE_LEN + 1];
+    bool done;
+    bool diverged;
+} compare_t;
+
+static compare_t CMP;
+
+static void compare_frame(void)
+{
+}
+
+static void compare_line(void)
+{
+    ssize_t len = getline(&CMP.ref_line, &CMP.ref_size, CMP.ref);
+    if (len < 0) {
+        CMP.done = true;
+        return;
+    }
+    while (len > 0 && (CMP.ref_line[len - 1] == '\n' ||
+                       CMP.ref_line[len - 1] == '\r' ||
+                       CMP.ref_line[len - 1] == ' '))
+        CMP.ref_line[--len] = '\0';
+    doctor_format(CMP.line);
+    if (strcmp(CMP.line, CMP.ref_line) != 0) {
+        CMP.diverged = true;
+        CMP.done = true;
+        return;
+    }
+    if (CMP.context_len)
+        memcpy(CMP.context[CMP.lines % CMP.context_len], CMP.line,
+               sizeof(CMP.line));
+    CMP.lines++;
+}
+
+/* Print the registers of the first differing line that disagree. */
+static void print_fields(void)
+{
+    char ours[DOCTOR_LINE_LEN + 1];
+    char *ref = CMP.ref_line;
+    memcpy(ours, CMP.line, sizeof(ours));
+    char *save_ours, *save_ref;
+    char *tok_ours = strtok_r(ours, " ", &save_ours);
+    char *tok_ref = strtok_r(ref, " ", &save_ref);
+    printf("Differs in:");
+    while (tok_ours || tok_ref) {
+        if (tok_ours == NULL || tok_ref == NULL) {
+            printf(" <length>");
+            break;
+        }
+        if (strcmp(tok_ours, tok_ref) != 0) {
+            const char *colon = strchr(tok_ours, ':');
+            printf(" %.*s", colon ? (int)(colon - tok_ours) : 0, tok_ours);
+        }
+        tok_ours = strtok_r(NULL, " ", &save_ours);
+        tok_ref = strtok_r(NULL, " ", &save_ref);
+    }
+    printf("\n");
+}
+
+static void print_divergence(void)
+{
+    uint64_t first = CMP.lines > CMP.context_len ? CMP.lines - CMP.context_len
+                                                 : 0;
+    for (uint64_t i = first; i < CMP.lines; ++i)
+        printf("  %10llu: %s\n", (unsigned long long)i + 1,
+               CMP.context[i % CMP.context_len]);
+    printf("- %10llu: %s\n", (unsigned long long)CMP.lines + 1,
+           CMP.ref_line);
+    printf("+ %10llu: %s\n", (unsigned long long)CMP.lines + 1, CMP.line);
+    print_fields();
+}
+
+static void print_help(char **argv)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <ROM> <reference log|->\n"
+            "Options:\n"
+            "  -b <cycles>\tCycle budget (default: 1 emulated hour)\n"
+            "  -c <lines>\tMatching lines shown before a divergence "
+            "(default: %d)\n"
+            "  -h\t\tPrint help and exit\n",
+            argv[0], DEFAULT_CONTEXT);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t budget = DEFAULT_BUDGET;
+    CMP.context_len = DEFAULT_CONTEXT;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:c:h")) != -1) {
+        switch (opt) {
+            case 'b':
+                budget = strtoull(optarg, NULL, 10);
+                break;
+            case 'c':
+                CMP.context_len = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                print_help(argv);
+                return EXIT_FAILURE;
+        }
+    }
+    if (argc - optind != 2) {
+        print_help(argv);
+        return EXIT_FAILURE;
+    }
+    const char *ref_path = argv[optind + 1];
+    CMP.ref = strcmp(ref_path, "-") == 0 ? stdin : fopen(ref_path, "r");
+    if (CMP.ref == NULL) {
+        perror(ref_path);
+        return EXIT_FAILURE;
+    }
+    if (CMP.context_len)
+        CMP.context = calloc(CMP.context_len, sizeof(*CMP.context));
+    if (cpu_init(argv[optind]) < 0) {
+        fprintf(stderr, "ERROR: could not load ROM: %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    gpu_init(NULL, compare_frame);
+    gpu_stub_ly(true);
+    cpu_set_instr_cb(compare_line);
+    while (!CMP.done && clock_get_cycles() < budget)
+        cpu_emulate_cycle();
+    int ret = EXIT_SUCCESS;
+    if (CMP.diverged) {
+        print_divergence();
+        printf("Diverged at line %llu\n", (unsigned long long)CMP.lines + 1);
+        ret = EXIT_FAILURE;
+    } else if (CMP.done) {
+        printf("All %llu lines match\n", (unsigned long long)CMP.lines);
+    } else {
+        printf("Cycle budget exhausted after %llu matching lines\n",
+               (unsigned long long)CMP.lines);
+        ret = EXIT_FAILURE;
+    }
+    free(CMP.context);
+    free(CMP.ref_line);
+    if (CMP.ref != stdin)
+        fclose(CMP.ref);
+    return ret;
+}
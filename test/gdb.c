@@ -0,0 +1,157 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "cpu.h"
+#include "debugger.h"
+#include "game_boy.h"
+#include "gdb.h"
+#include "gpu.h"
+#include "rom.h"
+#include "ut.h"
+
+#define SOCKET_PATH "/tmp/gusgb_gdb_test.sock"
+
+static atomic_bool done;
+static pthread_t emulation;
+static int client = -1;
+
+static void on_frame(void)
+{
+}
+
+static void *emulate(void *arg)
+{
+    (void)arg;
+    while (!atomic_load(&done))
+        gb_step();
+    return NULL;
+}
+
+static int gdb_setup(void)
+{
+    const char *rom = rom_create(ROM_PROGRAM);
+    ASSERT(rom != NULL);
+    ASSERT(cpu_init(rom) == 0);
+    ASSERT(gpu_init(NULL, on_frame) == 0);
+    ASSERT(gdb_open(SOCKET_PATH) == 0);
+    atomic_store(&done, false);
+    ASSERT(pthread_create(&emulation, NULL, emulate, NULL) == 0);
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strcpy(addr.sun_path, SOCKET_PATH);
+    client = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT(connect(client, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    return 0;
+}
+
+static void gdb_teardown(void)
+{
+    close(client);
+    atomic_store(&done, true);
+    pthread_join(emulation, NULL);
+    gdb_close();
+    debugger_clear();
+    if (debugger_stopped())
+        debugger_continue(0);
+    cpu_finish();
+    rom_remove();
+}
+
+static int send_packet(const char *data)
+{
+    uint8_t sum = 0;
+    for (const char *c = data; *c; ++c)
+        sum = (uint8_t)(sum + *c);
+    char packet[256];
+    int len = snprintf(packet, sizeof(packet), "$%s#%02x", data, sum);
+    char ack;
+    if (send(client, packet, (size_t)len, 0) != len ||
+        recv(client, &ack, 1, 0) != 1 || ack != '+')
+        return -1;
+    return 0;
+}
+
+/* Return the payload of the next packet from the stub. */
+static const char *recv_reply(void)
+{
+    static char reply[256];
+    size_t n = 0;
+    int check = -1; /* Checksum characters left. */
+    while (check != 0 && n < sizeof(reply) - 1 &&
+           recv(client, &reply[n], 1, 0) == 1) {
+        if (check > 0)
+            check--;
+        else if (reply[n] == '#')
+            check = 2;
+        n++;
+    }
+    if (check != 0 || reply[0] != '$')
+        return "";
+    reply[n - 3] = '\0';
+    return &reply[1];
+}
+
+static const char *request(const char *data)
+{
+    if (send_packet(data) < 0)
+        return "";
+    return recv_reply();
+}
+
+static int gdb_registers_memory(void)
+{
+    ASSERT(gdb_setup() == 0);
+    ASSERT(strcmp(request("?"), "S05") == 0);
+    /* AF BC DE HL SP PC, little endian. */
+    const char *regs = request("g");
+    ASSERT(strlen(regs) == 24);
+    ASSERT(strcmp(&regs[16], "feff0001") == 0);
+    /* The low nibble of F stays 0. */
+    ASSERT(strcmp(request("P0=f101"), "OK") == 0);
+    ASSERT(strcmp(request("p0"), "f001") == 0);
+    ASSERT(strcmp(request("p7"), "xxxx") == 0);
+    ASSERT(strcmp(request("m100,5"), "3e42ea00c0") == 0);
+    ASSERT(strcmp(request("Mc000,2:1234"), "OK") == 0);
+    ASSERT(strcmp(request("mc000,2"), "1234") == 0);
+    ASSERT(strcmp(request("D"), "OK") == 0);
+    gdb_teardown();
+    return 0;
+}
+
+static int gdb_breakpoints(void)
+{
+    ASSERT(gdb_setup() == 0);
+    ASSERT(strcmp(request("?"), "S05") == 0);
+    /* Set by the emulation thread before the reply. */
+    ASSERT(strcmp(request("Z0,108,1"), "OK") == 0);
+    ASSERT(debugger_has_breakpoint(0x108));
+    ASSERT(strcmp(request("c"), "S05") == 0);
+    ASSERT(strcmp(request("p5"), "0801") == 0);
+    ASSERT(strcmp(request("s"), "S05") == 0);
+    ASSERT(strcmp(request("p5"), "0901") == 0);
+    /* Around the loop, back to the breakpoint. */
+    ASSERT(strcmp(request("c"), "S05") == 0);
+    ASSERT(strcmp(request("p5"), "0801") == 0);
+    ASSERT(strcmp(request("z0,108,1"), "OK") == 0);
+    ASSERT(!debugger_has_breakpoint(0x108));
+    /* Run freely until interrupted. */
+    ASSERT(send_packet("c") == 0);
+    usleep(10000);
+    ASSERT(send(client, "\x03", 1, 0) == 1);
+    ASSERT(strcmp(recv_reply(), "S02") == 0);
+    ASSERT(strcmp(request("D"), "OK") == 0);
+    gdb_teardown();
+    return 0;
+}
+
+void gdb_test(void);
+
+void gdb_test(void)
+{
+    ut_run(gdb_registers_memory);
+    ut_run(gdb_breakpoints);
+}
@@ -0,0 +1,366 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gpu.h"
+#include "mmu.h"
+#include "rom.h"
+#include "ut.h"
+
+/* Load a blank ROM, flagged for CGB if cgb. */
+static int gpu_setup_rom(bool cgb)
+{
+    const char *rom = rom_create(cgb ? ROM_CGB : 0);
+    ASSERT(rom != NULL);
+    ASSERT(mmu_init(rom) == 0);
+    return 0;
+}
+
+static int gpu_setup(void)
+{
+    return gpu_setup_rom(false);
+}
+
+static void gpu_teardown(void)
+{
+    mmu_finish();
+    rom_remove();
+}
+
+/* Fill WRAM at 0xc000 with a pattern. */
+static void fill_wram(unsigned int len)
+{
+    for (unsigned int i = 0; i < len; ++i)
+        mmu_write_byte((uint16_t)(0xc000 + i), (uint8_t)(i ^ 0x5a));
+}
+
+static void hdma_start(uint16_t src, uint16_t dst, uint8_t hdma5)
+{
+    mmu_write_byte(0xff51, (uint8_t)(src >> 8));
+    mmu_write_byte(0xff52, (uint8_t)src);
+    mmu_write_byte(0xff53, (uint8_t)(dst >> 8));
+    mmu_write_byte(0xff54, (uint8_t)dst);
+    mmu_write_byte(0xff55, hdma5);
+}
+
+/* Step the GPU until the next H-Blank. */
+static void step_to_hblank(void)
+{
+    while (gpu_read_stat() % 4 == GPU_MODE_HBLANK)
+        gpu_step(4);
+    while (gpu_read_stat() % 4 != GPU_MODE_HBLANK)
+        gpu_step(4);
+}
+
+static int gdma(void)
+{
+    ASSERT(gpu_setup() == 0);
+    fill_wram(0x100);
+    mmu_write_byte(0xff4f, 1);
+    hdma_start(0xc000, 0x8800, 0x0f);
+    ASSERT(mmu_read_byte(0xff55) == 0xff);
+    /* 16 blocks of 32 clocks each. */
+    ASSERT(gpu_take_dma_stall() == 16 * 32);
+    for (unsigned int i = 0; i < 0x100; ++i)
+        ASSERT(mmu_read_byte((uint16_t)(0x8800 + i)) == (uint8_t)(i ^ 0x5a));
+    mmu_write_byte(0xff4f, 0);
+    ASSERT(mmu_read_byte(0x8800) == 0);
+    gpu_teardown();
+    return 0;
+}
+
+static int hdma_hblank(void)
+{
+    ASSERT(gpu_setup() == 0);
+    fill_wram(0x30);
+    hdma_start(0xc000, 0x9000, 0x82);
+    ASSERT(mmu_read_byte(0xff55) == 0x02);
+    step_to_hblank();
+    ASSERT(gpu_read_hdma5() == 0x01);
+    ASSERT(gpu_take_dma_stall() == 32);
+    step_to_hblank();
+    ASSERT(gpu_read_hdma5() == 0x00);
+    step_to_hblank();
+    ASSERT(gpu_read_hdma5() == 0xff);
+    for (unsigned int i = 0; i < 0x30; ++i)
+        ASSERT(mmu_read_byte((uint16_t)(0x9000 + i)) == (uint8_t)(i ^ 0x5a));
+    gpu_teardown();
+    return 0;
+}
+
+static int hdma_cancel(void)
+{
+    ASSERT(gpu_setup() == 0);
+    fill_wram(0x40);
+    hdma_start(0xc000, 0x9000, 0x83);
+    step_to_hblank();
+    mmu_write_byte(0xff55, 0x00);
+    ASSERT(gpu_read_hdma5() == 0x82);
+    step_to_hblank();
+    ASSERT(mmu_read_byte(0x900f) == (0x0f ^ 0x5a));
+    ASSERT(mmu_read_byte(0x9010) == 0);
+    gpu_teardown();
+    return 0;
+}
+
+/* The destination does not wrap, the DMA ends at the end of VRAM. */
+static int hdma_vram_end(void)
+{
+    ASSERT(gpu_setup() == 0);
+    fill_wram(0x40);
+    hdma_start(0xc000, 0x9fe0, 0x03);
+    ASSERT(mmu_read_byte(0xff55) == 0xff);
+    ASSERT(gpu_take_dma_stall() == 2 * 32);
+    ASSERT(mmu_read_byte(0x9fff) == (0x1f ^ 0x5a));
+    ASSERT(mmu_read_byte(0x8000) == 0);
+    hdma_start(0xc000, 0x9ff0, 0x82);
+    step_to_hblank();
+    ASSERT(gpu_read_hdma5() == 0xff);
+    ASSERT(gpu_take_dma_stall() == 32);
+    step_to_hblank();
+    ASSERT(gpu_take_dma_stall() == 0);
+    ASSERT(mmu_read_byte(0x8000) == 0);
+    gpu_teardown();
+    return 0;
+}
+
+static int oam_dma(void)
+{
+    ASSERT(gpu_setup() == 0);
+    fill_wram(0xa0);
+    mmu_write_byte(0xff80, 0x42);
+    mmu_write_byte(0xff46, 0xc0);
+    /* Only HRAM and I/O are accessible during the transfer. */
+    ASSERT(mmu_read_byte(0xff80) == 0x42);
+    ASSERT(mmu_read_byte(0xfe00) == 0xff);
+    ASSERT(gpu_read_oam(0xfe00) == 0);
+    gpu_step(40);
+    ASSERT(mmu_read_byte(0x0150) == (10 ^ 0x5a));
+    mmu_write_byte(0xc000, 0);
+    ASSERT(mmu_read_byte(0x8000) == 0);
+    gpu_step(596);
+    ASSERT(gpu_read_oam(0xfe00) == 0);
+    gpu_step(4);
+    for (unsigned int i = 0; i < 0xa0; ++i)
+        ASSERT(mmu_read_byte((uint16_t)(0xfe00 + i)) == (uint8_t)(i ^ 0x5a));
+    gpu_teardown();
+    return 0;
+}
+
+static unsigned int frames;
+
+static void count_frame(void)
+{
+    frames++;
+}
+
+/* Step the GPU to the end of the current frame, return the clocks it took. */
+static unsigned int step_frame(void)
+{
+    unsigned int start = frames, clocks = 0;
+    while (frames == start) {
+        gpu_step(4);
+        clocks += 4;
+    }
+    return clocks;
+}
+
+static int frame_skip(void)
+{
+    ASSERT(gpu_setup() == 0);
+    ASSERT(gpu_init(NULL, count_frame) == 0);
+    /* The LCD starts in V-Blank, the first frame is short. */
+    step_frame();
+    unsigned int full = step_frame();
+    gpu_set_frame_skip(1);
+    /* Blank tiles show BGP color 0: black, then white. */
+    gpu_write_bgp(0xff);
+    ASSERT(step_frame() == full);
+    ASSERT(gpu_get_framebuffer()[0].r == 0x00);
+    /* Skipped: the framebuffer keeps the last rendered frame. */
+    gpu_write_bgp(0xfc);
+    ASSERT(step_frame() == full);
+    ASSERT(gpu_get_framebuffer()[0].r == 0x00);
+    ASSERT(step_frame() == full);
+    ASSERT(gpu_get_framebuffer()[0].r != 0x00);
+    gpu_set_frame_skip(0);
+    gpu_teardown();
+    return 0;
+}
+
+static int frame_tracking(void)
+{
+    ASSERT(gpu_setup() == 0);
+    ASSERT(gpu_init(NULL, count_frame) == 0);
+    gpu_track_frames(true);
+    step_frame();
+    step_frame();
+    uint64_t hash = gpu_frame_hash();
+    ASSERT(step_frame() && !gpu_frame_changed());
+    ASSERT(gpu_frame_hash() == hash);
+    /* The first line of tile 0, all over the map: every 8th line changes. */
+    gpu_write_vram(0x8000, 0xff);
+    step_frame();
+    ASSERT(gpu_frame_changed() && gpu_frame_hash() != hash);
+    for (unsigned int line = 0; line < GB_SCREEN_HEIGHT; ++line)
+        ASSERT(gpu_line_dirty(line) == (line % 8 == 0));
+    /* Same as hashing the framebuffer on demand. */
+    hash = gpu_frame_hash();
+    gpu_track_frames(false);
+    ASSERT(gpu_frame_hash() == hash);
+    gpu_teardown();
+    return 0;
+}
+
+/* Step to the next mode 3, return its length in dots. */
+static unsigned int mode3_dots(void)
+{
+    while (gpu_read_stat() % 4 == GPU_MODE_VRAM)
+        gpu_step(1);
+    while (gpu_read_stat() % 4 != GPU_MODE_VRAM)
+        gpu_step(1);
+    unsigned int dots = 0;
+    while (gpu_read_stat() % 4 == GPU_MODE_VRAM) {
+        gpu_step(1);
+        dots++;
+    }
+    return dots;
+}
+
+static int fifo_timing(void)
+{
+    ASSERT(gpu_setup() == 0);
+    ASSERT(gpu_init(NULL, count_frame) == 0);
+    gpu_set_renderer(GPU_RENDERER_FIFO);
+    step_frame();
+    /* Mode 3 length changes, the line length does not. */
+    unsigned int frame = step_frame();
+    ASSERT(mode3_dots() == 172);
+    gpu_write_scx(3);
+    ASSERT(mode3_dots() == 175);
+    gpu_write_scx(0);
+    /* A sprite on lines 0-7 at the left edge: 6 dots plus 5 of background
+     * fetch. */
+    step_frame();
+    gpu_write_oam(0xfe00, 16);
+    gpu_write_oam(0xfe01, 8);
+    gpu_write_lcdc(0x93);
+    ASSERT(mode3_dots() == 172 + 11);
+    step_frame();
+    ASSERT(step_frame() == frame);
+    gpu_set_renderer(GPU_RENDERER_SCANLINE);
+    gpu_teardown();
+    return 0;
+}
+
+/* Render a frame with tiles, the window at wx and a sprite, return its
+ * hash. */
+static uint64_t render_frame_wx(gpu_renderer_e renderer, uint8_t wx)
+{
+    gpu_set_renderer(renderer);
+    step_frame();
+    for (unsigned int i = 0; i < 16; ++i) {
+        gpu_write_vram((uint16_t)(0x8000 + i), (uint8_t)(i * 37 + 11));
+        gpu_write_vram((uint16_t)(0x8010 + i), (uint8_t)(0xa5 >> (i & 3)));
+    }
+    gpu_write_oam(0xfe00, 40);
+    gpu_write_oam(0xfe01, 27);
+    gpu_write_oam(0xfe02, 1);
+    gpu_write_scx(5);
+    gpu_write_wx(wx);
+    gpu_write_wy(20);
+    gpu_write_lcdc(0xb3);
+    /* The window skips lines 40 to 59, then resumes from its line 20. */
+    while (gpu_read_ly() != 40)
+        gpu_step(4);
+    gpu_write_lcdc(0x93);
+    while (gpu_read_ly() != 60)
+        gpu_step(4);
+    gpu_write_lcdc(0xb3);
+    step_frame();
+    return gpu_frame_hash();
+}
+
+static uint64_t render_frame(gpu_renderer_e renderer)
+{
+    return render_frame_wx(renderer, 87);
+}
+
+static int fifo_render(void)
+{
+    ASSERT(gpu_setup() == 0);
+    ASSERT(gpu_init(NULL, count_frame) == 0);
+    uint64_t scanline = render_frame(GPU_RENDERER_SCANLINE);
+    ASSERT(render_frame(GPU_RENDERER_FIFO) == scanline);
+    /* Below 7, WX hides the first 7 - WX window pixels. */
+    scanline = render_frame_wx(GPU_RENDERER_SCANLINE, 3);
+    ASSERT(render_frame_wx(GPU_RENDERER_FIFO, 3) == scanline);
+    gpu_set_renderer(GPU_RENDERER_SCANLINE);
+    gpu_teardown();
+    return 0;
+}
+
+/* CGB tile attributes: banks, flips, palettes and priority over a sprite. */
+static int fifo_render_cgb(void)
+{
+    ASSERT(gpu_setup_rom(true) == 0);
+    ASSERT(gpu_init(NULL, count_frame) == 0);
+    mmu_write_byte(0xff4f, 1);
+    for (uint16_t addr = 0x8000; addr < 0x8020; ++addr)
+        mmu_write_byte(addr, (uint8_t)(addr * 91 + 3));
+    for (uint16_t addr = 0x9800; addr < 0x9c00; ++addr)
+        mmu_write_byte(addr, (uint8_t)(addr * 29));
+    /* The tile under the sprite has priority. */
+    mmu_write_byte(0x9863, 0x80);
+    mmu_write_byte(0xff4f, 0);
+    mmu_write_byte(0xff68, 0x80);
+    mmu_write_byte(0xff6a, 0x80);
+    for (unsigned int i = 0; i < 64; ++i) {
+        mmu_write_byte(0xff69, (uint8_t)(i * 37));
+        mmu_write_byte(0xff6b, (uint8_t)(i * 53));
+    }
+    uint64_t scanline = render_frame(GPU_RENDERER_SCANLINE);
+    ASSERT(render_frame(GPU_RENDERER_FIFO) == scanline);
+    gpu_set_renderer(GPU_RENDERER_SCANLINE);
+    gpu_teardown();
+    return 0;
+}
+
+/* A color is decoded from both of its bytes, whichever was written. */
+static int cgb_palette(void)
+{
+    ASSERT(gpu_setup_rom(true) == 0);
+    ASSERT(gpu_init(NULL, count_frame) == 0);
+    /* Background palette 0 color 0, 0x7c00: blue. */
+    mmu_write_byte(0xff68, 0x80);
+    mmu_write_byte(0xff69, 0x00);
+    mmu_write_byte(0xff69, 0x7c);
+    step_frame();
+    step_frame();
+    const color_t *c = gpu_get_framebuffer();
+    ASSERT(c->r == 0 && c->g == 0 && c->b == 255);
+    /* Only the high byte again, 0x0300: green. */
+    mmu_write_byte(0xff68, 0x01);
+    mmu_write_byte(0xff69, 0x03);
+    step_frame();
+    c = gpu_get_framebuffer();
+    ASSERT(c->r == 0 && c->g == 24 * 255 / 31 && c->b == 0);
+    gpu_teardown();
+    return 0;
+}
+
+void gpu_test(void);
+
+void gpu_test(void)
+{
+    ut_run(gdma);
+    ut_run(hdma_hblank);
+    ut_run(hdma_cancel);
+    ut_run(hdma_vram_end);
+    ut_run(oam_dma);
+    ut_run(frame_skip);
+    ut_run(frame_tracking);
+    ut_run(fifo_timing);
+    ut_run(fifo_render);
+    ut_run(fifo_render_cgb);
+    ut_run(cgb_palette);
+}
@@ -2,11 +2,37 @@
 
 struct ut unit_test;
 
+extern void huc1_test(void);
+extern void mbc2_test(void);
 extern void mbc3_test(void);
+extern void mbc5_test(void);
+extern void ram_sync_test(void);
+extern void capture_test(void);
+extern void debugger_test(void);
+extern void gdb_test(void);
+extern void gpu_test(void);
+extern void movie_test(void);
+extern void scale_test(void);
+extern void serial_test(void);
+extern void trace_test(void);
+extern void viewer_test(void);
 
 int main(void)
 {
+    huc1_test();
+    mbc2_test();
     mbc3_test();
+    mbc5_test();
+    ram_sync_test();
+    capture_test();
+    debugger_test();
+    gdb_test();
+    gpu_test();
+    movie_test();
+    scale_test();
+    serial_test();
+    trace_test();
+    viewer_test();
     ut_result();
     return 0;
 }
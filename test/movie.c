@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "clock.h"
+#include "game_boy.h"
+#include "keys.h"
+#include "movie.h"
+#include "rom.h"
+#include "ut.h"
+
+static int movie_roundtrip(void)
+{
+    char path[] = "/tmp/gusgb_movie_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    close(fd);
+    /* Record: A pressed on frame 2, released on frame 4. */
+    clock_reset();
+    keys_reset();
+    ASSERT(movie_record(path) == 0);
+    for (int frame = 1; frame <= 5; ++frame) {
+        clock_step(70224);
+        movie_frame();
+        if (frame == 2)
+            movie_key(KEY_A, true);
+        if (frame == 4)
+            movie_key(KEY_A, false);
+    }
+    movie_close();
+    /* Replay ignores live input and injects keys on the same frames. */
+    clock_reset();
+    keys_reset();
+    ASSERT(movie_play(path) == 0);
+    movie_key(KEY_B, true);
+    ASSERT(!key_check_pressed(KEY_B));
+    for (int frame = 1; frame <= 5; ++frame) {
+        clock_step(70224);
+        movie_frame();
+        ASSERT(key_check_pressed(KEY_A) == (frame >= 2 && frame < 4));
+    }
+    ASSERT(movie_done());
+    movie_close();
+    unlink(path);
+    return 0;
+}
+
+/* Run the emulation loop until the movie reaches frame. */
+static void run_to(uint64_t frame)
+{
+    while (movie_get_frame() < frame)
+        gb_step();
+}
+
+/* A pause while recording takes no frame: the key released during the
+ * pause is replayed on the frame it was released on. */
+static int movie_pause(void)
+{
+    char path[] = "/tmp/gusgb_movie_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    close(fd);
+    const char *rom = rom_create(0);
+    ASSERT(rom != NULL);
+    gb_config_t config = {.scale = 1, .headless = true, .no_trace = true};
+    config.movie_record = path;
+    ASSERT(gb_init(&config, rom) == 0);
+    run_to(2);
+    movie_key(KEY_A, true);
+    run_to(3);
+    gb_pause(true);
+    for (int i = 0; i < 1000; ++i)
+        gb_step();
+    ASSERT(movie_get_frame() == 3);
+    movie_key(KEY_A, false);
+    gb_pause(false);
+    run_to(5);
+    uint64_t cycles = clock_get_cycles();
+    gb_finish();
+    config.movie_record = NULL;
+    config.movie_play = path;
+    ASSERT(gb_init(&config, rom) == 0);
+    for (uint64_t frame = 1; frame <= 5; ++frame) {
+        run_to(frame);
+        ASSERT(key_check_pressed(KEY_A) == (frame == 2));
+    }
+    ASSERT(movie_done() && clock_get_cycles() == cycles);
+    gb_finish();
+    rom_remove();
+    unlink(path);
+    return 0;
+}
+
+void movie_test(void);
+
+void movie_test(void)
+{
+    ut_run(movie_roundtrip);
+    ut_run(movie_pause);
+}
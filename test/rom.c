@@ -0,0 +1,45 @@
+#include "rom.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ROM_PATH "/tmp/gusgb_rom_XXXXXX"
+#define ROM_SIZE 0x8000
+
+static const uint8_t program[] = {0x3e, 0x42, 0xea, 0x00, 0xc0,
+                                  0xcd, 0x00, 0x02, 0x00, 0x18, 0xfd};
+static const uint8_t function[] = {0x00, 0x00, 0xc9};
+
+static char rom_path[sizeof(ROM_PATH)];
+
+const char *rom_create(unsigned int flags)
+{
+    uint8_t rom[ROM_SIZE] = {0};
+    if (flags & ROM_CGB)
+        rom[0x143] = 0x80;
+    if (flags & ROM_PROGRAM) {
+        memcpy(&rom[0x100], program, sizeof(program));
+        memcpy(&rom[0x200], function, sizeof(function));
+    }
+    strcpy(rom_path, ROM_PATH);
+    int fd = mkstemp(rom_path);
+    if (fd < 0) {
+        perror(rom_path);
+        return NULL;
+    }
+    ssize_t len = write(fd, rom, sizeof(rom));
+    close(fd);
+    if (len != (ssize_t)sizeof(rom)) {
+        perror(rom_path);
+        unlink(rom_path);
+        return NULL;
+    }
+    return rom_path;
+}
+
+void rom_remove(void)
+{
+    unlink(rom_path);
+}
@@ -0,0 +1,21 @@
+#ifndef TEST_ROM_H
+#define TEST_ROM_H
+
+#include <stdbool.h>
+
+/* Test ROMs: 32kB, blank or with a small program, written to a temporary
+ * file for the cartridge loader. */
+
+#define ROM_CGB (1 << 0)     /* Flagged for CGB. */
+#define ROM_PROGRAM (1 << 1) /* With the program below. */
+
+/* The program loops from 0x108, calling a function at 0x200:
+ * 0x100: LD A,0x42; LD (0xc000),A; CALL 0x200; NOP; JR 0x108
+ * 0x200: NOP; NOP; RET */
+
+/* Write a ROM with the ROM_ flags, returns its path or NULL. */
+const char *rom_create(unsigned int flags);
+/* Remove the last ROM written. */
+void rom_remove(void);
+
+#endif /* TEST_ROM_H */
@@ -0,0 +1,341 @@
+/* Headless test ROM runner. Runs every ROM under a directory in a child
+ * process, several at a time, and decides pass/fail from:
+ * - Serial output (Blargg): "Passed" or "Failed".
+ * - Registers (Mooneye): B/C/D/E/H/L = 3/5/8/13/21/34 on pass, all 0x42 on
+ *   fail.
+ * - A reference framebuffer hash given in the manifest.
+ * A ROM that decides nothing within its cycle budget times out. */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "clock.h"
+#include "cpu.h"
+#include "gpu.h"
+#include "serial.h"
+
+#define DEFAULT_BUDGET (4194304ULL * 120) /* 2 emulated minutes. */
+#define SERIAL_MAX 4096
+#define RESULT_MAX 256
+
+typedef enum {
+    ROM_RUNNING = 0,
+    ROM_PASS,
+    ROM_FAIL,
+    ROM_TIMEOUT,
+    ROM_ERROR,
+} rom_status_e;
+
+static const char *status_names[] = {"RUNNING", "PASS", "FAIL", "TIMEOUT",
+                                     "ERROR"};
+
+typedef struct {
+    char *path;
+    uint64_t budget;
+    uint64_t hash; /* Reference framebuffer hash. */
+    bool has_hash;
+    pid_t pid;
+    int fd; /* Read end of the child result pipe. */
+    double start;
+    double elapsed;
+    char result[RESULT_MAX];
+} rom_t;
+
+typedef struct {
+    rom_t *roms;
+    size_t count;
+    size_t size;
+} rom_list_t;
+
+/* State of the ROM running in a child process. */
+typedef struct {
+    serial_link_t link;
+    char serial[SERIAL_MAX];
+    size_t serial_len;
+    rom_t *rom;
+    rom_status_e status;
+    uint64_t hash; /* Hash of the last frame. */
+} runner_t;
+
+extern cpu_t CPU;
+
+static runner_t RUNNER;
+static rom_list_t ROMS;
+static const char *manifest_path;
+static uint64_t default_budget = DEFAULT_BUDGET;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* Capture serial output; no peer answers. */
+static int runner_transfer(serial_link_t *link, uint8_t out)
+{
+    (void)link;
+    if (RUNNER.serial_len < SERIAL_MAX - 1)
+        RUNNER.serial[RUNNER.serial_len++] = (char)out;
+    return -1;
+}
+
+static int runner_poll(serial_link_t *link, uint8_t out)
+{
+    (void)link;
+    (void)out;
+    return -1;
+}
+
+static void runner_check(void)
+{
+    if (strstr(RUNNER.serial, "Passed")) {
+        RUNNER.status = ROM_PASS;
+    } else if (strstr(RUNNER.serial, "Failed")) {
+        RUNNER.status = ROM_FAIL;
+    } else if (CPU.reg.b == 3 && CPU.reg.c == 5 && CPU.reg.d == 8 &&
+               CPU.reg.e == 13 && CPU.reg.h == 21 && CPU.reg.l == 34) {
+        RUNNER.status = ROM_PASS;
+    } else if (CPU.reg.b == 0x42 && CPU.reg.c == 0x42 && CPU.reg.d == 0x42 &&
+               CPU.reg.e == 0x42 && CPU.reg.h == 0x42 && CPU.reg.l == 0x42) {
+        RUNNER.status = ROM_FAIL;
+    } else if (RUNNER.rom->has_hash && RUNNER.hash == RUNNER.rom->hash) {
+        RUNNER.status = ROM_PASS;
+    }
+}
+
+static void runner_frame(void)
+{
+    /* Hashing is tracked at VBlank, only changed frames need a new look. */
+    if (gpu_frame_changed())
+        RUNNER.hash = gpu_frame_hash();
+    runner_check();
+}
+
+/* Run a ROM in the child process, return its result line. */
+static void run_rom(rom_t *rom, char *result)
+{
+    memset(&RUNNER, 0, sizeof(RUNNER));
+    RUNNER.link.transfer = runner_transfer;
+    RUNNER.link.poll = runner_poll;
+    RUNNER.rom = rom;
+    if (cpu_init(rom->path) < 0) {
+        snprintf(result, RESULT_MAX, "%s\t0\t0\tcould not load ROM",
+                 status_names[ROM_ERROR]);
+        return;
+    }
+    gpu_init(NULL, runner_frame);
+    gpu_track_frames(true);
+    serial_set_link(&RUNNER.link);
+    while (RUNNER.status == ROM_RUNNING && clock_get_cycles() < rom->budget)
+        cpu_emulate_cycle();
+    if (RUNNER.status == ROM_RUNNING)
+        RUNNER.status = ROM_TIMEOUT;
+    /* Keep serial text on one line. */
+    for (size_t i = 0; i < RUNNER.serial_len; ++i) {
+        char c = RUNNER.serial[i];
+        if (c < 0x20 || c > 0x7e)
+            RUNNER.serial[i] = ' ';
+    }
+    snprintf(result, RESULT_MAX, "%s\t%llu\t%016llx\t%.128s",
+             status_names[RUNNER.status],
+             (unsigned long long)clock_get_cycles(),
+             (unsigned long long)RUNNER.hash, RUNNER.serial);
+}
+
+static void rom_start(rom_t *rom)
+{
+    int fds[2];
+    if (pipe(fds) < 0) {
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+    /* Don't let the child inherit pending output. */
+    fflush(stdout);
+    rom->start = now();
+    rom->pid = fork();
+    if (rom->pid < 0) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (rom->pid == 0) {
+        /* Silence the emulator logs. */
+        if (freopen("/dev/null", "w", stdout) == NULL)
+            _exit(EXIT_FAILURE);
+        close(fds[0]);
+        char result[RESULT_MAX];
+        run_rom(rom, result);
+        if (write(fds[1], result, strlen(result)) < 0)
+            _exit(EXIT_FAILURE);
+        /* Skip cartridge saves. */
+        _exit(EXIT_SUCCESS);
+    }
+    close(fds[1]);
+    rom->fd = fds[0];
+}
+
+static void rom_finish(rom_t *rom, int wstatus)
+{
+    rom->elapsed = now() - rom->start;
+    ssize_t len = read(rom->fd, rom->result, RESULT_MAX - 1);
+    close(rom->fd);
+    if (len <= 0 || !WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+        snprintf(rom->result, RESULT_MAX, "%s\t0\t0\temulator crashed",
+                 status_names[ROM_ERROR]);
+    } else {
+        rom->result[len] = '\0';
+    }
+}
+
+static int add_rom(const char *path, const struct stat *st, int type,
+                   struct FTW *ftw)
+{
+    (void)st;
+    (void)ftw;
+    const char *ext = strrchr(path, '.');
+    if (type != FTW_F || ext == NULL ||
+        (strcmp(ext, ".gb") != 0 && strcmp(ext, ".gbc") != 0))
+        return 0;
+    if (ROMS.count == ROMS.size) {
+        ROMS.size = ROMS.size ? ROMS.size * 2 : 64;
+        ROMS.roms = realloc(ROMS.roms, ROMS.size * sizeof(rom_t));
+    }
+    rom_t *rom = &ROMS.roms[ROMS.count++];
+    memset(rom, 0, sizeof(*rom));
+    rom->path = strdup(path);
+    rom->budget = default_budget;
+    return 0;
+}
+
+static int rom_cmp(const void *a, const void *b)
+{
+    return strcmp(((const rom_t *)a)->path, ((const rom_t *)b)->path);
+}
+
+/* Manifest lines: <ROM file name> <cycle budget> [framebuffer hash]. */
+static int load_manifest(void)
+{
+    FILE *f = fopen(manifest_path, "r");
+    if (f == NULL) {
+        perror(manifest_path);
+        return -1;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        char name[256];
+        unsigned long long budget;
+        unsigned long long hash;
+        int n = sscanf(line, "%255s %llu %llx", name, &budget, &hash);
+        if (n < 2 || name[0] == '#')
+            continue;
+        for (size_t i = 0; i < ROMS.count; ++i) {
+            const char *base = strrchr(ROMS.roms[i].path, '/');
+            base = base ? base + 1 : ROMS.roms[i].path;
+            if (strcmp(base, name) != 0)
+                continue;
+            ROMS.roms[i].budget = budget;
+            ROMS.roms[i].hash = hash;
+            ROMS.roms[i].has_hash = n == 3;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static void print_help(char **argv)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <test ROM directory>\n"
+            "Options:\n"
+            "  -b <cycles>\tDefault cycle budget per ROM\n"
+            "  -h\t\tPrint help and exit\n"
+            "  -j <jobs>\tROMs run in parallel (default: all cores)\n"
+            "  -m <file>\tManifest: <ROM name> <cycles> [frame hash]\n"
+            "  -o <file>\tResults file (default: results.tsv)\n",
+            argv[0]);
+}
+
+int main(int argc, char **argv)
+{
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *out_path = "results.tsv";
+    int opt;
+    while ((opt = getopt(argc, argv, "b:j:m:o:h")) != -1) {
+        switch (opt) {
+            case 'b':
+                default_budget = strtoull(optarg, NULL, 10);
+                break;
+            case 'j':
+                jobs = strtol(optarg, NULL, 10);
+                break;
+            case 'm':
+                manifest_path = optarg;
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            default:
+                print_help(argv);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc || jobs < 1) {
+        print_help(argv);
+        return EXIT_FAILURE;
+    }
+    if (nftw(argv[optind], add_rom, 16, FTW_PHYS) < 0) {
+        perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+    qsort(ROMS.roms, ROMS.count, sizeof(rom_t), rom_cmp);
+    if (manifest_path && load_manifest() < 0)
+        return EXIT_FAILURE;
+    /* Keep up to jobs children running. */
+    size_t next = 0, done = 0, running = 0;
+    while (done < ROMS.count) {
+        while (running < (size_t)jobs && next < ROMS.count) {
+            rom_start(&ROMS.roms[next++]);
+            running++;
+        }
+        int wstatus;
+        pid_t pid = wait(&wstatus);
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("wait");
+            return EXIT_FAILURE;
+        }
+        for (size_t i = 0; i < next; ++i) {
+            if (ROMS.roms[i].pid != pid)
+                continue;
+            rom_finish(&ROMS.roms[i], wstatus);
+            printf("%-60s %s\n", ROMS.roms[i].path, ROMS.roms[i].result);
+            running--;
+            done++;
+        }
+    }
+    FILE *out = fopen(out_path, "w");
+    if (out == NULL) {
+        perror(out_path);
+        return EXIT_FAILURE;
+    }
+    fprintf(out, "rom\tstatus\tcycles\tframe_hash\tserial\tseconds\n");
+    unsigned int passed = 0;
+    for (size_t i = 0; i < ROMS.count; ++i) {
+        rom_t *rom = &ROMS.roms[i];
+        fprintf(out, "%s\t%s\t%.3f\n", rom->path, rom->result, rom->elapsed);
+        passed += strncmp(rom->result, "PASS", 4) == 0;
+        free(rom->path);
+    }
+    fclose(out);
+    free(ROMS.roms);
+    printf("%u/%zu passed, results in %s\n", passed, ROMS.count, out_path);
+    return passed == ROMS.count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,75 @@
+#include <stdlib.h>
+#include <string.h>
+#include "gpu.h"
+#include "scale.h"
+#include "ut.h"
+
+#define W GB_SCREEN_WIDTH
+#define H GB_SCREEN_HEIGHT
+
+static uint32_t frame[W * H];
+
+/* Few colors, so runs of equal pixels and edges for the filters to act on. */
+static void fill_frame(void)
+{
+    static const uint32_t colors[4] = {0xffe0f8d0, 0xff88c070, 0xff346856,
+                                       0xff000000};
+    uint32_t seed = 12345;
+    for (unsigned int i = 0; i < W * H; ++i) {
+        seed = seed * 1103515245 + 12345;
+        frame[i] = colors[(seed >> 16) & 3];
+    }
+}
+
+/* Every instruction set gives the plain C output. */
+static int scale_simd_match(void)
+{
+    fill_frame();
+    for (int filter = 0; filter < SCALE_MAX; ++filter) {
+        unsigned int factor = scale_factor((scale_filter_e)filter, 4);
+        size_t size = sizeof(uint32_t) * W * H * factor * factor;
+        uint32_t *ref = malloc(size);
+        uint32_t *out = malloc(size);
+        scale_set_simd(SCALE_SIMD_NONE);
+        scale_frame((scale_filter_e)filter, factor, frame, ref);
+        for (int simd = SCALE_SIMD_SSE2; simd <= SCALE_SIMD_AVX2; ++simd) {
+            memset(out, 0, size);
+            scale_set_simd((scale_simd_e)simd);
+            scale_frame((scale_filter_e)filter, factor, frame, out);
+            ASSERT(memcmp(ref, out, size) == 0);
+        }
+        free(ref);
+        free(out);
+    }
+    scale_set_simd(scale_simd_max());
+    return 0;
+}
+
+static int scale_filters(void)
+{
+    static uint32_t out[W * H * 9];
+    fill_frame();
+    scale_frame(SCALE_NEAREST, 3, frame, out);
+    ASSERT(out[(5 * 3 + 2) * W * 3 + 7 * 3 + 1] == frame[5 * W + 7]);
+    /* Scale2x rounds the corner of a diagonal edge, keeps flat areas. */
+    for (unsigned int i = 0; i < W * H; ++i)
+        frame[i] = (i % W) + (i / W) < 100 ? 0xff000000 : 0xffffffff;
+    scale_frame(SCALE_SCALE2X, 2, frame, out);
+    /* (50, 50) is white with black above and to its left. */
+    ASSERT(out[100 * W * 2 + 100] == 0xff000000);
+    ASSERT(out[100 * W * 2 + 101] == 0xffffffff);
+    ASSERT(out[0] == 0xff000000);
+    ASSERT(out[W * H * 4 - 1] == 0xffffffff);
+    scale_frame(SCALE_XBR, 2, frame, out);
+    ASSERT(out[0] == 0xff000000);
+    ASSERT(out[W * H * 4 - 1] == 0xffffffff);
+    return 0;
+}
+
+void scale_test(void);
+
+void scale_test(void)
+{
+    ut_run(scale_simd_match);
+    ut_run(scale_filters);
+}
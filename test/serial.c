@@ -0,0 +1,96 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "interrupt.h"
+#include "link/pipe.h"
+#include "link/socket.h"
+#include "serial.h"
+#include "ut.h"
+
+static int serial_no_link(void)
+{
+    serial_reset();
+    interrupt_reset();
+    serial_set_link(NULL);
+    serial_write_sb(0x12);
+    serial_write_sc(0x81);
+    serial_step(4092);
+    ASSERT(serial_read_sc() & 0x80);
+    ASSERT(!(interrupt_get_flag() & INTERRUPTS_SERIAL));
+    serial_step(4);
+    ASSERT(!(serial_read_sc() & 0x80));
+    ASSERT(serial_read_sb() == 0xff);
+    ASSERT(interrupt_get_flag() & INTERRUPTS_SERIAL);
+    return 0;
+}
+
+static int serial_pipe(void)
+{
+    link_pipe_t pipe;
+    link_pipe_init(&pipe);
+    serial_reset();
+    interrupt_reset();
+    serial_set_link(&pipe.end[0].link);
+    /* Clock a byte out, the peer answer is already queued. */
+    ASSERT(link_pipe_send(&pipe.end[1], 0x42));
+    serial_write_sb(0x81);
+    serial_write_sc(0x81);
+    serial_step(4096);
+    ASSERT(serial_read_sb() == 0x42);
+    ASSERT(link_pipe_recv(&pipe.end[1]) == 0x81);
+    ASSERT(interrupt_get_flag() & INTERRUPTS_SERIAL);
+    /* Wait for a byte clocked by the peer. */
+    interrupt_reset();
+    serial_write_sb(0x55);
+    serial_write_sc(0x80);
+    ASSERT(link_pipe_send(&pipe.end[1], 0x37));
+    serial_step(512);
+    ASSERT(serial_read_sb() == 0x37);
+    ASSERT(!(serial_read_sc() & 0x80));
+    ASSERT(link_pipe_recv(&pipe.end[1]) == 0x55);
+    ASSERT(interrupt_get_flag() & INTERRUPTS_SERIAL);
+    serial_set_link(NULL);
+    return 0;
+}
+
+static void *socket_peer(void *arg)
+{
+    serial_link_t *link = arg;
+    for (int i = 0; i < 1000; ++i) {
+        if (link->poll(link, 0x99) >= 0)
+            break;
+        usleep(1000);
+    }
+    return NULL;
+}
+
+static int serial_socket(void)
+{
+    char path[] = "/tmp/gusgb_link_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    close(fd);
+    unlink(path);
+    serial_link_t *server = link_socket_open(path);
+    ASSERT(server != NULL);
+    serial_link_t *client = link_socket_open(path);
+    ASSERT(client != NULL);
+    pthread_t thread;
+    pthread_create(&thread, NULL, socket_peer, server);
+    ASSERT(client->transfer(client, 0x66) == 0x99);
+    pthread_join(thread, NULL);
+    client->close(client);
+    server->close(server);
+    ASSERT(access(path, F_OK) != 0);
+    return 0;
+}
+
+void serial_test(void);
+
+void serial_test(void)
+{
+    ut_run(serial_no_link);
+    ut_run(serial_pipe);
+    ut_run(serial_socket);
+}
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "trace.h"
+#include "ut.h"
+
+/* The ring keeps the last TRACE_ENTRIES instructions, dumped oldest first. */
+static int trace_wrap(void)
+{
+    char path[] = "/tmp/gusgb_trace_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT(fd >= 0);
+    close(fd);
+    trace_reset();
+    ASSERT(trace_next() == NULL);
+    trace_enable(true);
+    for (uint32_t i = 0; i < TRACE_ENTRIES + 10; ++i)
+        trace_next()->cycles = i;
+    trace_enable(false);
+    ASSERT(trace_dump(path) == 0);
+    FILE *f = fopen(path, "rb");
+    ASSERT(f != NULL);
+    trace_header_t header;
+    ASSERT(fread(&header, sizeof(header), 1, f) == 1);
+    ASSERT(memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) == 0);
+    ASSERT(header.entry_size == sizeof(trace_entry_t));
+    ASSERT(header.count == TRACE_ENTRIES);
+    trace_entry_t entry;
+    for (uint32_t i = 0; i < TRACE_ENTRIES; ++i) {
+        ASSERT(fread(&entry, sizeof(entry), 1, f) == 1);
+        ASSERT(entry.cycles == i + 10);
+    }
+    ASSERT(fread(&entry, sizeof(entry), 1, f) == 0);
+    fclose(f);
+    unlink(path);
+    trace_reset();
+    return 0;
+}
+
+void trace_test(void);
+
+void trace_test(void)
+{
+    ut_run(trace_wrap);
+}
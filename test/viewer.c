@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gpu.h"
+#include "mmu.h"
+#include "rom.h"
+#include "ut.h"
+#include "viewer.h"
+
+#define PNG_PATH "/tmp/gusgb_viewer_test.png"
+
+/* Where things are on the sheet. */
+#define MAPS_Y 200
+#define OAM_X 272
+#define OAM_Y 72
+
+static uint32_t sheet[VIEWER_WIDTH * VIEWER_HEIGHT];
+
+static void on_frame(void)
+{
+}
+
+static int viewer_setup(bool cgb)
+{
+    const char *rom = rom_create(cgb ? ROM_CGB : 0);
+    ASSERT(rom != NULL);
+    ASSERT(mmu_init(rom) == 0);
+    ASSERT(gpu_init(NULL, on_frame) == 0);
+    /* The first line of tile 1 in color 1, everywhere else color 0. */
+    gpu_write_vram(0x8010, 0xff);
+    return 0;
+}
+
+static void viewer_teardown(void)
+{
+    mmu_finish();
+    rom_remove();
+}
+
+static uint32_t pixel(int x, int y)
+{
+    return sheet[y * VIEWER_WIDTH + x];
+}
+
+static int viewer_sheet(void)
+{
+    ASSERT(viewer_setup(false) == 0);
+    gpu_write_vram(0x9800, 1);
+    gpu_write_oam(0xfe02, 1);
+    gpu_write_scx(200);
+    gpu_write_scy(16);
+    viewer_draw(sheet);
+    /* Tile set in greys. */
+    ASSERT(pixel(8, 0) == 0xffaaaaaa && pixel(8, 1) == 0xffffffff);
+    /* BGP 0xfc: color 0 lightest, color 1 black. */
+    ASSERT(pixel(0, MAPS_Y) == 0xff000000);
+    ASSERT(pixel(8, MAPS_Y) == 0xffe0f8d0);
+    /* The screen wraps around the map. */
+    ASSERT(pixel(200, MAPS_Y + 16) == 0xffff0000);
+    ASSERT(pixel((200 + 159) & 0xff, MAPS_Y + 16) == 0xffff0000);
+    ASSERT(pixel((200 + 159) & 0xff, MAPS_Y + 159) == 0xffff0000);
+    ASSERT(pixel(199, MAPS_Y + 16) != 0xffff0000);
+    /* Sprite 0 with OBP0 0xff, color 0 transparent. */
+    ASSERT(pixel(OAM_X, OAM_Y) == 0xff000000);
+    ASSERT(pixel(OAM_X, OAM_Y + 1) == 0xff404040);
+    viewer_teardown();
+    return 0;
+}
+
+static int viewer_cgb_banks(void)
+{
+    ASSERT(viewer_setup(true) == 0);
+    /* Tile 1 of bank 1, used by the map through its attributes with
+     * palette 2, flipped vertically. */
+    gpu_write_vbk(1);
+    gpu_write_vram(0x801e, 0xff);
+    gpu_write_vram(0x9800, 0x4a);
+    gpu_write_vbk(0);
+    gpu_write_vram(0x9800, 1);
+    gpu_write_bgpi(0x80 | (2 * 8 + 2));
+    gpu_write_bgpd(0x1f);
+    gpu_write_bgpd(0x00);
+    gpu_write_scx(32);
+    gpu_write_scy(32);
+    viewer_draw(sheet);
+    /* Bank 1 tile set on the right of bank 0. */
+    ASSERT(pixel(136 + 8, 7) == 0xffaaaaaa && pixel(136 + 8, 0) != 0xffaaaaaa);
+    ASSERT(pixel(0, MAPS_Y) == 0xffff0000);
+    ASSERT(pixel(0, MAPS_Y + 7) == 0xff000000);
+    viewer_teardown();
+    return 0;
+}
+
+static int viewer_png(void)
+{
+    ASSERT(viewer_setup(false) == 0);
+    ASSERT(viewer_dump(PNG_PATH) == 0);
+    FILE *f = fopen(PNG_PATH, "rb");
+    ASSERT(f != NULL);
+    uint8_t header[24];
+    ASSERT(fread(header, 1, sizeof(header), f) == sizeof(header));
+    ASSERT(memcmp(header, "\x89PNG\r\n\x1a\n\0\0\0\x0dIHDR", 16) == 0);
+    ASSERT(header[18] * 256 + header[19] == VIEWER_WIDTH);
+    ASSERT(header[22] * 256 + header[23] == VIEWER_HEIGHT);
+    /* Uncompressed: the rows and 5 bytes per stored block. */
+    size_t raw = (1 + VIEWER_WIDTH * 3) * VIEWER_HEIGHT;
+    ASSERT(fseek(f, 0, SEEK_END) == 0);
+    ASSERT((size_t)ftell(f) == 8 + 25 + 12 + 2 + raw +
+                                   (raw + 0xfffe) / 0xffff * 5 + 4 + 12);
+    /* IEND and its fixed CRC. */
+    uint8_t end[12];
+    ASSERT(fseek(f, -12, SEEK_END) == 0);
+    ASSERT(fread(end, 1, sizeof(end), f) == sizeof(end));
+    ASSERT(memcmp(end, "\0\0\0\0IEND\xae\x42\x60\x82", 12) == 0);
+    fclose(f);
+    unlink(PNG_PATH);
+    viewer_teardown();
+    return 0;
+}
+
+void viewer_test(void);
+
+void viewer_test(void)
+{
+    ut_run(viewer_sheet);
+    ut_run(viewer_cgb_banks);
+    ut_run(viewer_png);
+}